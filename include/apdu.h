@@ -7,7 +7,62 @@
  * @brief Parse the raw CLA byte.
  * @param[in] cla_raw The class byte of an APDU message, expected to be in the
  * proprietary classes defined in ETSI TS 102 221 V16.4.0 clause.10.1.1
- * table.10.3.
+ * table.10.3 or in the interindustry classes of ISO/IEC 7816-4:2020
+ * clause.5.4.1.
  * @return Parsed CLA.
  */
 swicc_apdu_cla_st sim_apdu_cmd_cla_parse(uint8_t const cla_raw);
+
+/**
+ * Size of the response staging buffer, capped for encoders that take a 16-bit
+ * length (the buffer holds 65536 bytes with extended APDUs).
+ */
+#define SIM_APDU_RSP_SIZE_U16                                                  \
+    (SWICC_DATA_MAX > UINT16_MAX ? UINT16_MAX : SWICC_DATA_MAX)
+
+/**
+ * Response data waiting for GET RESPONSE. Handlers encode their response
+ * straight into the buffer and GET RESPONSE returns slices of it, so the data
+ * is written once and only copied once more, to the wire.
+ */
+typedef struct sim_apdu_rsp_s
+{
+    uint8_t b[SWICC_DATA_MAX];
+    uint32_t len;    /* Length of the staged data. */
+    uint32_t offset; /* How much of it was already returned. */
+} sim_apdu_rsp_st;
+
+/**
+ * @brief Drop any staged response. Per ETSI TS 102 221 V16.4.0 clause.7.3.1.1.4
+ * the response is only available to a GET RESPONSE that immediately follows.
+ * @param[out] rsp
+ */
+void sim_apdu_rsp_reset(sim_apdu_rsp_st *const rsp);
+
+/**
+ * @brief Stage a response which was encoded into the buffer of the staging
+ * area.
+ * @param[in, out] rsp
+ * @param[in] len Length of the response (at most SWICC_DATA_MAX).
+ */
+void sim_apdu_rsp_stage(sim_apdu_rsp_st *const rsp, uint32_t const len);
+
+/**
+ * @brief Take the next part of the staged response.
+ * @param[in, out] rsp
+ * @param[in] len Length of the part.
+ * @return Start of the part, or NULL (and nothing is taken) if fewer bytes are
+ * left.
+ */
+uint8_t const *sim_apdu_rsp_take(sim_apdu_rsp_st *const rsp,
+                                 uint32_t const len);
+
+/**
+ * @brief Get SW2 of a 61XX or 6CXX status for what is left of the staged
+ * response. Per ISO/IEC 7816-4:2020 clause.5.6 a value of 00 means 256 bytes
+ * or more, in that case the terminal keeps sending GET RESPONSE until it gets
+ * 9000, so responses longer than a short APDU still need no other commands.
+ * @param[in] rsp
+ * @return SW2.
+ */
+uint8_t sim_apdu_rsp_sw2(sim_apdu_rsp_st const *const rsp);
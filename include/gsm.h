@@ -2,6 +2,17 @@
 
 #include "common.h"
 
+/* Number of instances interleaved by gsm_algo_batch. */
+#define GSM_ALGO_LANES 4U
+
+/* Variants of the GSM A3/A8 algorithm a card can run. */
+typedef enum gsm_algo_e
+{
+    GSM_ALGO_COMP128_1 = 1,
+    GSM_ALGO_COMP128_2 = 2,
+    GSM_ALGO_COMP128_3 = 3,
+} gsm_algo_et;
+
 /**
  * @brief Create a response to SELECT for a given file.
  * @param[in] fs The swICC file system containing the file.
@@ -29,3 +40,28 @@ int32_t gsm_select_res(swicc_fs_st const *const fs,
  */
 void gsm_algo(uint8_t const ki[const 16], uint8_t const rand[const 16],
               uint8_t res[const 12]);
+
+/**
+ * @brief Run the GSM algorithm for many (Ki, RAND) pairs. The pairs are
+ * processed a few at a time with their computations interleaved.
+ * @param[in] ki Key of each pair.
+ * @param[in] rand Challenge of each pair.
+ * @param[out] res Response of each pair.
+ * @param[in] n Number of pairs.
+ */
+void gsm_algo_batch(uint8_t const ki[const][16], uint8_t const rand[const][16],
+                    uint8_t res[const][12], uint32_t const n);
+
+/**
+ * @brief Run one variant of the GSM algorithm.
+ * @param[in] algo Variant to run.
+ * @param[in] ki Individual subscriber authentication key.
+ * @param[in] rand Challenge from base station.
+ * @param[out] res Response of the GSM algorithm (SRES || Kc).
+ * @return 0 on success, -1 if the variant is not available.
+ * @note Only COMP128-1 is available. The S-boxes of COMP128-2 and COMP128-3
+ * are not part of swSIM so these variants are rejected instead of producing
+ * responses which no network would accept.
+ */
+int32_t gsm_algo_run(gsm_algo_et const algo, uint8_t const ki[const 16],
+                     uint8_t const rand[const 16], uint8_t res[const 12]);
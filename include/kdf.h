@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Length of the HMAC-SHA-256 output and of every KDF output. */
+#define KDF_OUT_LEN 32U
+/**
+ * Longest serving network name that is accepted. Per 3GPP TS 24.501 V17.7.1
+ * clause.9.12.1 it is '5G:' followed by the network identifier, e.g.
+ * '5G:mnc001.mcc001.3gppnetwork.org'.
+ */
+#define KDF_SNN_LEN_MAX 64U
+
+/**
+ * HMAC-SHA-256 key per RFC 2104 with the inner and outer padded keys already
+ * hashed. Derivations from the same key (e.g. CK || IK) share this so each of
+ * them saves 2 compressions.
+ */
+typedef struct kdf_key_s
+{
+    uint32_t inner[8];
+    uint32_t outer[8];
+} kdf_key_st;
+
+/* Input parameter Pi of the generic KDF. */
+typedef struct kdf_param_s
+{
+    uint8_t const *buf;
+    uint16_t len;
+} kdf_param_st;
+
+/* Keys that the ME derives for 5G AKA from the USIM outputs. */
+typedef struct kdf_5g_s
+{
+    uint8_t res_star[16]; /* RES* (or XRES* on the network side). */
+    uint8_t kausf[32];
+    uint8_t ck_prime[16]; /* CK' and IK' are used by EAP-AKA'. */
+    uint8_t ik_prime[16];
+} kdf_5g_st;
+
+/**
+ * @brief Prepare an HMAC-SHA-256 key. Keys longer than the SHA-256 block are
+ * hashed first per RFC 2104 clause.2.
+ * @param[out] key Prepared key.
+ * @param[in] k Key bytes.
+ * @param[in] k_len Length of the key.
+ */
+void kdf_key_set(kdf_key_st *const key, uint8_t const *const k,
+                 uint32_t const k_len);
+
+/**
+ * @brief Compute HMAC-SHA-256 per RFC 2104 with SHA-256 per FIPS 180-4. The
+ * compression function uses the SHA extensions when the CPU supports them.
+ * @param[in] key Prepared key (see kdf_key_set).
+ * @param[in] msg Message to authenticate.
+ * @param[in] msg_len Length of the message.
+ * @param[out] mac
+ */
+void kdf_hmac_sha256(kdf_key_st const *const key, uint8_t const *const msg,
+                     uint32_t const msg_len, uint8_t mac[const KDF_OUT_LEN]);
+
+/**
+ * @brief The generic KDF of 3GPP TS 33.220 V17.3.0 annex.B.2: HMAC-SHA-256
+ * over S = FC || P0 || L0 || P1 || L1 || ... where Li is the 2 byte big-endian
+ * length of Pi.
+ * @param[in] key Prepared key (see kdf_key_set).
+ * @param[in] fc Function code.
+ * @param[in] param Parameters P0 to Pn.
+ * @param[in] param_count Number of parameters.
+ * @param[out] out Derived key.
+ */
+void kdf(kdf_key_st const *const key, uint8_t const fc,
+         kdf_param_st const param[const], uint32_t const param_count,
+         uint8_t out[const KDF_OUT_LEN]);
+
+/**
+ * @brief Derive the 5G AKA keys from the outputs of one authentication. All of
+ * them use the key CK || IK:
+ * - RES* per 3GPP TS 33.501 V17.7.0 annex.A.4 (FC 0x6B).
+ * - Kausf per 3GPP TS 33.501 V17.7.0 annex.A.2 (FC 0x6A).
+ * - CK' and IK' per 3GPP TS 33.501 V17.7.0 annex.A.3 (FC 0x20) with the
+ * serving network name as the access network identity.
+ * @param[in] ck Cipher key.
+ * @param[in] ik Integrity key.
+ * @param[in] res Response (or XRES).
+ * @param[in] res_len Length of the response (4 to 16 bytes).
+ * @param[in] rand Random challenge.
+ * @param[in] sqn_ak SQN ^ AK, i.e. the first 6 bytes of AUTN.
+ * @param[in] snn Serving network name (not NUL-terminated).
+ * @param[in] snn_len Length of the serving network name.
+ * @param[out] out Derived keys.
+ */
+void kdf_5g_aka(uint8_t const ck[const 16], uint8_t const ik[const 16],
+                uint8_t const *const res, uint8_t const res_len,
+                uint8_t const rand[const 16], uint8_t const sqn_ak[const 6],
+                uint8_t const *const snn, uint8_t const snn_len,
+                kdf_5g_st *const out);
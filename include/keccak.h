@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Number of 64-bit lanes in the 1600-bit Keccak state. */
+#define KECCAK_STATE_LANES 25U
+
+/**
+ * @brief The Keccak-f[1600] permutation per FIPS 202 clause.3.3 (24 rounds).
+ * Lane x + 5y of the state holds bits 64(x + 5y) to 64(x + 5y) + 63, i.e. the
+ * state is a byte string read as little-endian 64-bit words.
+ * @param[in, out] state State to permute.
+ */
+void keccak_f1600(uint64_t state[const KECCAK_STATE_LANES]);
+
+/**
+ * @brief Apply Keccak-f[1600] to many independent states in one call. Groups
+ * of 4 states are permuted together in 256-bit registers (AVX2) when the CPU
+ * supports it, the rest go through the scalar permutation.
+ * @param[in, out] state States to permute.
+ * @param[in] n Number of states.
+ */
+void keccak_f1600_xN(uint64_t state[const][KECCAK_STATE_LANES],
+                     uint32_t const n);
@@ -0,0 +1,182 @@
+#pragma once
+/**
+ * Level-gated asynchronous logger.
+ *
+ * Every swSIM instance owns a log which is a single-producer single-consumer
+ * ring of binary records. Writing a record only copies a format string pointer,
+ * a few integer arguments, and (optionally) a short hex payload into the ring,
+ * the formatting and the write to stderr happen on a background thread (see
+ * log_thread_start) which drains all registered logs.
+ *
+ * Levels are gated twice:
+ * - At compile time by LOG_LVL_MAX, records above it are removed entirely.
+ * - At run time by the level of each log.
+ *
+ * @note All conversion specifiers in a format string must consume a uint64_t
+ * (i.e. use PRIu64, PRIX64, etc.) since arguments are stored as such. The
+ * format string must outlive the record so it should be a string literal.
+ * @note Hex dumps of key material are redacted unless the log was explicitly
+ * configured to show them.
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOG_RING_LEN 128U /* Must be a power of 2. */
+#define LOG_ARG_MAX 6U
+#define LOG_HEX_MAX 64U
+
+typedef enum log_lvl_e
+{
+    LOG_LVL_NONE = 0,
+    LOG_LVL_ERR = 1,
+    LOG_LVL_WRN = 2,
+    LOG_LVL_INF = 3,
+    LOG_LVL_DBG = 4,
+} log_lvl_et;
+
+/* The highest level that gets compiled in. */
+#ifndef LOG_LVL_MAX
+#ifdef DEBUG
+#define LOG_LVL_MAX LOG_LVL_DBG
+#else
+#define LOG_LVL_MAX LOG_LVL_INF
+#endif
+#endif
+
+typedef struct log_rcrd_s
+{
+    char const *fmt;
+    uint64_t arg[LOG_ARG_MAX];
+    uint8_t hex[LOG_HEX_MAX];
+    uint8_t hex_len;
+    bool hex_redacted;
+} log_rcrd_st;
+
+typedef struct log_s
+{
+    log_rcrd_st rcrd[LOG_RING_LEN];
+    _Atomic uint32_t head; /* Only written by the producer. */
+    _Atomic uint32_t tail; /* Only written by the consumer. */
+    _Atomic uint32_t dropped;
+
+    log_lvl_et lvl;
+    bool secret; /* If hex dumps of key material are shown. */
+
+    struct log_s *next; /* Used by the background thread registry. */
+} log_st;
+
+/**
+ * @brief Check if a record of some level would be written to the log.
+ * @param[in] log Log to check. A NULL log has all levels disabled.
+ * @param[in] lvl Level of the record.
+ * @return True if enabled, false otherwise.
+ */
+static inline bool log_enabled(log_st const *const log, log_lvl_et const lvl)
+{
+    return log != NULL && lvl <= log->lvl;
+}
+
+/**
+ * @brief Write a record to a log.
+ * @param[in] log_ Log to write to (can be NULL).
+ * @param[in] lvl_ Level of the record.
+ * @param[in] fmt_ Format string, all arguments are converted to uint64_t.
+ */
+#define LOG(log_, lvl_, fmt_, ...)                                             \
+    do                                                                         \
+    {                                                                          \
+        if ((lvl_) <= LOG_LVL_MAX && log_enabled((log_), (lvl_)))              \
+        {                                                                      \
+            log_rcrd((log_), (fmt_),                                           \
+                     (uint64_t const[LOG_ARG_MAX]){__VA_ARGS__}, false, NULL,  \
+                     0U);                                                      \
+        }                                                                      \
+    } while (0)
+
+/**
+ * @brief Write a record followed by a hex dump of a buffer to a log.
+ * @param[in] log_ Log to write to (can be NULL).
+ * @param[in] lvl_ Level of the record.
+ * @param[in] secret_ If the buffer holds key material.
+ * @param[in] buf_ Buffer to dump, at most LOG_HEX_MAX bytes will be included.
+ * @param[in] len_ Length of the buffer.
+ * @param[in] fmt_ Format string, all arguments are converted to uint64_t.
+ */
+#define LOG_HEX(log_, lvl_, secret_, buf_, len_, fmt_, ...)                    \
+    do                                                                         \
+    {                                                                          \
+        if ((lvl_) <= LOG_LVL_MAX && log_enabled((log_), (lvl_)))              \
+        {                                                                      \
+            log_rcrd((log_), (fmt_),                                           \
+                     (uint64_t const[LOG_ARG_MAX]){__VA_ARGS__}, (secret_),    \
+                     (buf_), (len_));                                          \
+        }                                                                      \
+    } while (0)
+
+#define LOG_ERR(log_, ...) LOG((log_), LOG_LVL_ERR, __VA_ARGS__)
+#define LOG_WRN(log_, ...) LOG((log_), LOG_LVL_WRN, __VA_ARGS__)
+#define LOG_INF(log_, ...) LOG((log_), LOG_LVL_INF, __VA_ARGS__)
+#define LOG_DBG(log_, ...) LOG((log_), LOG_LVL_DBG, __VA_ARGS__)
+
+/**
+ * @brief Initialize a log.
+ * @param[out] log Log to initialize.
+ * @param[in] lvl Run-time level of the log.
+ * @param[in] secret If hex dumps of key material shall be shown.
+ */
+void log_init(log_st *const log, log_lvl_et const lvl, bool const secret);
+
+/**
+ * @brief Add a record to the ring of a log. When the ring is full, the record
+ * is dropped and counted. Use the LOG macros instead of calling this directly.
+ * @param[in, out] log Log to write to.
+ * @param[in] fmt Format string.
+ * @param[in] arg Arguments of the format string.
+ * @param[in] secret If the hex buffer holds key material.
+ * @param[in] hex Buffer to dump as hex (can be NULL).
+ * @param[in] hex_len Length of the hex buffer.
+ */
+void log_rcrd(log_st *const log, char const *const fmt,
+              uint64_t const arg[const LOG_ARG_MAX], bool const secret,
+              uint8_t const *const hex, uint32_t const hex_len);
+
+/**
+ * @brief Format all pending records of a log.
+ * @param[in, out] log Log to drain.
+ * @param[in] out Where to write the formatted records.
+ * @return Number of records written.
+ * @note Only one consumer may drain a log at a time so this must not be called
+ * on a log that is registered with the background thread.
+ */
+uint32_t log_drain(log_st *const log, FILE *const out);
+
+/**
+ * @brief Register a log with the background thread so its records get written
+ * to stderr.
+ * @param[in, out] log Log to register.
+ */
+void log_register(log_st *const log);
+
+/**
+ * @brief Unregister a log from the background thread and write out any records
+ * that are still pending.
+ * @param[in, out] log Log to unregister.
+ */
+void log_unregister(log_st *const log);
+
+/**
+ * @brief Start the background thread that drains the registered logs. It is
+ * shared by all instances of the process so starting it again does nothing.
+ * @return 0 on success, -1 on failure.
+ * @note This and log_thread_stop may be called from any thread.
+ */
+int32_t log_thread_start(void);
+
+/**
+ * @brief Stop the background thread after it has drained all registered logs.
+ */
+void log_thread_stop(void);
@@ -0,0 +1,73 @@
+#pragma once
+/**
+ * A manifest lists the subscribers of a multi-instance host, one per line in
+ * the key file format of auc-gen so the same file can drive both the cards and
+ * the AuC: '<IMSI> <K> [<OPc> [<SQN>]]' with K and OPc as 32 hex digits. Blank
+ * lines and lines starting with '#' are skipped. SQN is ignored since each card
+ * keeps its own SQN array.
+ *
+ * The columns can be followed by 'name=value' fields for TUAK, which auc-gen
+ * ignores: 'top=<64 hex digits>' sets the TOP that TOPc is derived from (zero
+ * by default) and 'topc=<64 hex digits>' provisions TOPc directly. K can also
+ * be 64 hex digits for a 256-bit TUAK key, Milenage then keeps its default K.
+ */
+
+#include "swsim.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* IMSIs are at most 15 digits per 3GPP TS 23.003 V17.5.0 clause.2.2. */
+#define MANIFEST_IMSI_LEN_MAX 15U
+/* Length of EF.IMSI per 3GPP TS 31.102 V17.5.0 clause.4.2.2. */
+#define MANIFEST_EF_IMSI_LEN 9U
+/* SID of EF.IMSI in ADF.USIM. */
+#define MANIFEST_EF_IMSI_SID 0x07
+
+/* What a manifest line overrides in the state of one instance. */
+typedef struct manifest_sub_s
+{
+    char imsi[MANIFEST_IMSI_LEN_MAX + 1U]; /* NUL-terminated digits. */
+    uint8_t k[TUAK_K_LEN_MAX];
+    uint8_t k_len; /* 16 or 32 bytes. */
+    uint8_t op_c[16];
+    bool op_c_present;
+    uint8_t top[32]; /* Zero unless given. */
+    uint8_t top_c[32];
+    bool top_c_present; /* Takes precedence over TOP. */
+} manifest_sub_st;
+
+/**
+ * @brief Read all subscribers of a manifest.
+ * @param[in] f Manifest to read.
+ * @param[out] sub_arr Receives an allocated array of subscribers which the
+ * caller has to free.
+ * @param[out] sub_count Receives the number of subscribers.
+ * @return 0 on success, -1 on failure.
+ */
+int32_t manifest_read(FILE *const f, manifest_sub_st **const sub_arr,
+                      uint32_t *const sub_count);
+
+/**
+ * @brief Encode an IMSI as the contents of EF.IMSI per 3GPP TS 31.102 V17.5.0
+ * clause.4.2.2, i.e. a length byte followed by the digits as BCD with the
+ * parity in the first nibble.
+ * @param[in] imsi NUL-terminated IMSI digits.
+ * @param[out] ef_imsi
+ * @return 0 on success, -1 if the IMSI is not 6 to 15 digits.
+ */
+int32_t manifest_imsi_encode(char const *const imsi,
+                             uint8_t ef_imsi[const MANIFEST_EF_IMSI_LEN]);
+
+/**
+ * @brief Override K, OPc, TOPc and the IMSI of an initialized instance.
+ * Unless TOPc is given, it is derived again from TOP and the new K.
+ * @param[in] sub Subscriber of the instance.
+ * @param[in, out] swsim_state
+ * @param[in, out] swicc_state The EF.IMSI of every application that has one
+ * gets the IMSI.
+ * @return 0 on success, -1 on failure.
+ */
+int32_t manifest_apply(manifest_sub_st const *const sub,
+                       swsim_st *const swsim_state,
+                       swicc_st *const swicc_state);
@@ -1,6 +1,70 @@
 #pragma once
 
 #include "common.h"
+#include "kdf.h"
+#include "log.h"
+#include "rijndael.h"
+
+/**
+ * SQN = SEQ || IND with the array scheme of 3GPP TS 33.102 V17.0.0 Annex C.3.
+ * The USIM keeps the highest accepted SEQ for every value of IND.
+ */
+#define MILENAGE_SQN_IND_LEN 5U /* bits */
+#define MILENAGE_SQN_ARRAY_LEN (1U << MILENAGE_SQN_IND_LEN)
+#define MILENAGE_SQN_ARRAY_SIZE (MILENAGE_SQN_ARRAY_LEN * 6U) /* bytes */
+/* Max distance of SEQ ahead of SEQ_MS per TS 33.102 V17.0.0 Annex C.2.1. */
+#define MILENAGE_SQN_DELTA (1ULL << 28U)
+/**
+ * Short file ID of the proprietary transparent EF in ADF.USIM which holds the
+ * SQN array, so that it persists with the card image.
+ */
+#define MILENAGE_SQN_EF_SID 0x1A
+
+/* Number of recent challenges whose responses are kept for retransmissions. */
+#define MILENAGE_CACHE_LEN 4U
+/* Length of the 'DB' response with RES, CK, IK, and Kc. */
+#define MILENAGE_RSP_LEN (2U + 8U + 1U + 16U + 1U + 16U + 1U + 8U)
+
+/**
+ * A successful response to AUTHENTICATE. It is only reused while its SQN is
+ * still the one last accepted for its IND, so it never lets a challenge in that
+ * the SQN checks would otherwise refuse for the first time.
+ */
+typedef struct milenage_cache_entry_s
+{
+    bool valid;
+    uint8_t rand[16];
+    uint8_t autn[16];
+    uint8_t sqn[6]; /* Unconcealed SQN that got accepted. */
+    uint8_t rsp[MILENAGE_RSP_LEN];
+} milenage_cache_entry_st;
+
+/**
+ * Responses to the last few successful challenges so that a terminal which
+ * retransmits AUTHENTICATE (e.g. after a link error) gets the same answer
+ * without running the algorithm again.
+ */
+typedef struct milenage_cache_s
+{
+    milenage_cache_entry_st entry[MILENAGE_CACHE_LEN];
+    uint8_t next; /* Entry to replace next. */
+
+    /* Number of challenges answered from the cache and computed again. */
+    uint64_t hit;
+    uint64_t miss;
+} milenage_cache_st;
+
+/* Authentication algorithms that can produce the vectors for AUTHENTICATE. */
+typedef enum milenage_algo_e
+{
+    MILENAGE_ALGO_MILENAGE = 0,
+    MILENAGE_ALGO_TUAK = 1,
+    /**
+     * XOR algorithm of the test USIM per ETSI TS 134 108 V17.0.0 clause.8.1.2.
+     * It provides no security and is only meant for signalling load tests.
+     */
+    MILENAGE_ALGO_XOR = 2,
+} milenage_algo_et;
 
 typedef struct milenage_s
 {
@@ -8,7 +72,10 @@ typedef struct milenage_s
      * Per ETSI TS 135 206 V17.0.0 clause.5.1 it is recommended to compute OPc
      * off the USIM. We allow the OPc computation to be done in both of the
      * specified ways, i.e., on USIM (op_present = true) and off USIM
-     * (op_present = false).
+     * (op_present = false). Either way, op_c always holds OPc: when computed
+     * on the USIM it is derived once whenever K or OP change (see
+     * milenage_k_set and milenage_op_set), so op_present only matters when
+     * provisioning.
      */
     bool op_present;
 
@@ -26,9 +93,190 @@ typedef struct milenage_s
     uint8_t r4;
     uint8_t r5;
 
+    /**
+     * If c1-c5 and r1-r5 are the standard ones (see milenage_param_std_check).
+     * These allow a faster path where rotations are word moves and XOR'ing with
+     * ci is a single byte flip.
+     */
+    bool param_std;
+
+    /**
+     * If the parameters passed milenage_config_validate. Authentication is
+     * refused until they do.
+     */
+    bool config_valid;
+
     uint8_t k[16];
+
+    /**
+     * Key schedule expanded from k. It is derived once whenever k changes (see
+     * milenage_k_set) so the f-functions never have to rebuild it.
+     */
+    rijndael_st rijndael;
+
+    /* Where authentication traces are written, NULL disables them. */
+    log_st *log;
+
+    /**
+     * Algorithm that computes the vectors used by AUTHENTICATE. The SQN array
+     * below is shared by all of them.
+     */
+    milenage_algo_et algo;
+    /* Parameters of MILENAGE_ALGO_TUAK. */
+    struct tuak_s const *tuak;
+
+    /**
+     * Serving network name (not NUL-terminated) used for 5G AKA. When set, the
+     * keys that the ME derives from the response (see kdf_5g_aka) are traced
+     * after every successful authentication. The response itself is the same
+     * as without it.
+     */
+    uint8_t snn[KDF_SNN_LEN_MAX];
+    uint8_t snn_len;
+
+    /**
+     * Highest accepted SQN for each IND, 6 bytes (big-endian) each. When NULL,
+     * sqn_array_mem is used (see milenage_sqn_array_set).
+     */
+    uint8_t *sqn_array;
+    uint8_t sqn_array_mem[MILENAGE_SQN_ARRAY_SIZE];
+    uint8_t sqn_ms_ind; /* IND of the highest accepted SQN (SQN_MS). */
+
+    /**
+     * Cleared whenever the key, OPc, or the SQN array storage change (see
+     * milenage_cache_clear).
+     */
+    milenage_cache_st cache;
 } milenage_st;
 
+/* Number of tuples processed together by milenage_all_xN. */
+#define MILENAGE_XN_CHUNK 16U
+
+/* Everything derived from one RAND by a single pass of Milenage. */
+typedef struct milenage_vec_s
+{
+    uint8_t sqn[6];     /* Unconcealed sequence number. */
+    uint8_t mac_a[8];   /* f1 */
+    uint8_t mac_s[8];   /* f1* */
+    uint8_t res[8];     /* f2 */
+    uint8_t ck[16];     /* f3 */
+    uint8_t ik[16];     /* f4 */
+    uint8_t ak[6];      /* f5 */
+    uint8_t ak_star[6]; /* f5* */
+    uint8_t kc[8];      /* c3(CK, IK) */
+} milenage_vec_st;
+
+/**
+ * @brief Check if c1-c5 and r1-r5 are the standard constants from ETSI TS 135
+ * 206 V17.0.0 clause.4.1 and select the specialized path if they are. This
+ * must be called every time the constants change.
+ * @param[in, out] milenage Milenage parameters.
+ */
+void milenage_param_std_check(milenage_st *const milenage);
+
+/**
+ * @brief Validate the operator parameters per ETSI TS 135 206 V17.0.0
+ * clause.5.3 and store the result in the config_valid flag. This is done once
+ * when the parameters are configured so authentication does not need to check
+ * them again. Pairs (ci, ri) that are not unique make the configuration
+ * invalid, ci with the not recommended parity only produce a warning.
+ * @param[in, out] milenage Milenage parameters.
+ * @return Success if the parameters are valid, error otherwise.
+ */
+swicc_ret_et milenage_config_validate(milenage_st *const milenage);
+
+/**
+ * @brief Set the subscriber key and expand the rijndael key schedule used by
+ * all Milenage functions. If OPc is computed on the USIM (op_present), it is
+ * derived again from OP and the new K. This must be called every time the key
+ * changes.
+ * @param[in, out] milenage Milenage parameters.
+ * @param[in] k Subscriber key.
+ */
+void milenage_k_set(milenage_st *const milenage, uint8_t const k[const 16]);
+
+/**
+ * @brief Set OP so that OPc is computed on the USIM. OPc is derived from OP and
+ * the current K right away and stored in op_c. The key must already be set.
+ * @param[in, out] milenage Milenage parameters.
+ * @param[in] op Operator variant algorithm configuration field.
+ */
+void milenage_op_set(milenage_st *const milenage, uint8_t const op[const 16]);
+
+/**
+ * @brief Compute all Milenage functions (f1, f1*, f2, f3, f4, f5, f5*) and the
+ * GSM Kc in one pass. TEMP = E[RAND ^ OPc]K is computed only once and shared
+ * by all the functions, so this takes 6 block encryptions instead of the 2
+ * needed by each function on its own.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number, or SQN ^ AK (as found in AUTN) when
+ * sqn_concealed is true.
+ * @param[in] sqn_concealed If the SQN is concealed with AK. In this case it is
+ * unconcealed before computing f1 and f1*.
+ * @param[in] amf Authentication management field.
+ * @param[out] vec Where all the outputs will be written.
+ * @note MAC-S is computed over the same SQN and AMF as MAC-A.
+ */
+void milenage_all(milenage_st const *const milenage,
+                  uint8_t const rand[const 16], uint8_t const sqn[const 6],
+                  bool const sqn_concealed, uint8_t const amf[const 2],
+                  milenage_vec_st *const vec);
+
+/**
+ * @brief Batch form of milenage_all. Computes everything for N independent
+ * (K, OPc, RAND) tuples, sharing block encryptions across the tuples so they
+ * can be interleaved or vectorized (see rijndael_encrypt_xN).
+ * @param[in] milenage Milenage parameters (holding K and OPc) of each tuple.
+ * @param[in] rand Random challenge of each tuple.
+ * @param[in] sqn Sequence number of each tuple (concealed or not, same as in
+ * milenage_all).
+ * @param[in] sqn_concealed If the SQNs are concealed with AK.
+ * @param[in] amf Authentication management field of each tuple.
+ * @param[out] vec Outputs of each tuple.
+ * @param[in] n Number of tuples.
+ */
+void milenage_all_xN(milenage_st const *const milenage[const],
+                     uint8_t const rand[const][16],
+                     uint8_t const sqn[const][6], bool const sqn_concealed,
+                     uint8_t const amf[const][2], milenage_vec_st vec[const],
+                     uint32_t const n);
+
+/**
+ * @brief Select where the SQN array is stored and find the highest SQN in it.
+ * This must be called every time the storage changes.
+ * @param[in, out] milenage Milenage parameters.
+ * @param[in, out] sqn_array Array of MILENAGE_SQN_ARRAY_SIZE bytes, or NULL to
+ * use the array inside the Milenage parameters.
+ */
+void milenage_sqn_array_set(milenage_st *const milenage,
+                            uint8_t *const sqn_array);
+
+/**
+ * @brief Forget all cached responses (the hit and miss counters are kept).
+ * This must be called when anything the responses depend on changes outside
+ * of the setters, e.g. when selecting another algorithm.
+ * @param[in, out] milenage Milenage parameters.
+ */
+void milenage_cache_clear(milenage_st *const milenage);
+
+/**
+ * @brief Perform UMTS authentication per 3GPP TS 33.102 V17.0.0 clause.6.3.3.
+ * The MAC is verified first, then the freshness of SQN is checked against the
+ * SQN array. Vectors come from the algorithm selected in the parameters. A
+ * retransmitted challenge whose SQN is still the last accepted one for its IND
+ * gets the same response again from the cache.
+ * @param[in, out] milenage Milenage parameters.
+ * @param[in] rand Random challenge.
+ * @param[in] token_auth AUTN.
+ * @param[out] output Response data: 'DB' with RES, CK, IK, and Kc on success or
+ * 'DC' with AUTS on a synchronization failure (3GPP TS 31.102 V17.5.0
+ * clause.7.1.2.1).
+ * @param[out] output_len Length of the response data.
+ * @return Success if a response was created (even for a synchronization
+ * failure), error if the MAC is wrong or the Milenage parameters were never
+ * validated (only when Milenage is selected).
+ */
 swicc_ret_et milenage(milenage_st *const milenage, uint8_t const rand[const 16],
                       uint8_t const token_auth[const 16],
                       uint8_t output[const SWICC_DATA_MAX],
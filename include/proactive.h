@@ -13,6 +13,7 @@
  */
 
 #include "common.h"
+#include "log.h"
 #include <stdbool.h>
 #include <string.h>
 
@@ -1054,12 +1055,13 @@ typedef struct swsim__proactive_s
 {
     uint32_t command_count;
 
+    /* Lengths are as wide as the buffers even with extended APDUs. */
     uint8_t command[SWICC_DATA_MAX];
-    uint16_t command_length;
+    uint32_t command_length;
     uint8_t response[SWICC_DATA_MAX];
-    uint16_t response_length;
+    uint32_t response_length;
     uint8_t envelope[SWICC_DATA_MAX];
-    uint16_t envelope_length;
+    uint32_t envelope_length;
 
     bool app_default_enable;
     bool app_default_response_wait;
@@ -1076,9 +1078,27 @@ typedef struct swsim__proactive_s
     sim__proactive__envelope_ft *app_proprietary__envelope;
     sim__proactive__step_ft *app_proprietary__step;
     sim__proactive__terminal_response_ft *app_proprietary__terminal_response;
+
+    /**
+     * If an event happened which can make an app create a command (see
+     * proactive_wake). proactive_step does nothing until one does.
+     */
+    bool step_pending;
+
+    /* Where proactive traces are written, NULL disables them. */
+    log_st *log;
 } swsim__proactive_st;
 
 sim__proactive__init_ft proactive_init;
 sim__proactive__envelope_ft proactive_app_default__envelope;
 sim__proactive__step_ft proactive_step;
+
+/**
+ * @brief Let the apps run in the next proactive_step. This must be called on
+ * every event that apps react to: TERMINAL PROFILE, TERMINAL RESPONSE,
+ * ENVELOPE, and expiry of timers kept by a proprietary app. An app that wants
+ * to be stepped again without an event (e.g. to poll) calls this from its step.
+ * @param[in, out] proactive
+ */
+void proactive_wake(swsim__proactive_st *const proactive);
 sim__proactive__terminal_response_ft proactive_app_default__terminal_response;
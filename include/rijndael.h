@@ -6,18 +6,38 @@ typedef struct rijndael_s
 {
     /* Rijndael round subkeys. */
     uint8_t round_keys[11][4][4];
+
+    /**
+     * The same round subkeys stored as byte strings (in the same order as the
+     * input and output) which is what the AES-NI backend needs.
+     */
+    uint8_t round_keys_bytes[11][16] __attribute__((aligned(16)));
 } rijndael_st;
 
 /**
  * @brief Rijndael encryption function. Takes 16-byte input and creates 16-byte
- * output using round keys already derived from 16-byte key.
- * @param[in, out] rijndael State of the rijndael block cipher.
+ * output using round keys already derived from 16-byte key. Uses AES-NI when
+ * the CPU supports it, otherwise uses the reference implementation.
+ * @param[in] rijndael State of the rijndael block cipher.
  * @param[in] input Input.
  * @param[out] output Output.
  */
-void rijndael_encrypt(rijndael_st *const rijndael,
+void rijndael_encrypt(rijndael_st const *const rijndael,
                       uint8_t const input[const 16], uint8_t output[const 16]);
 
+/**
+ * @brief Encrypt many independent blocks, each possibly under a different key,
+ * in one call. The blocks are interleaved (AES-NI), packed into wide registers
+ * (VAES), or bitsliced (portable fallback) depending on what the CPU supports.
+ * @param[in] states State of the rijndael block cipher to use for each block.
+ * @param[in] in Input blocks.
+ * @param[out] out Output blocks.
+ * @param[in] n Number of blocks.
+ */
+void rijndael_encrypt_xN(rijndael_st const *const states[const],
+                         uint8_t const in[const][16], uint8_t out[const][16],
+                         uint32_t const n);
+
 /**
  * @brief Initialize the rijndael cipher state.
  * @param[out] rijndael State of the rijndael block cipher that will be
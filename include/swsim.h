@@ -4,9 +4,14 @@
 #define SEMVER_MINOR 0
 #define SEMVER_PATCH 1
 
+#include "apdu.h"
+#include "gsm.h"
+#include "log.h"
 #include "milenage.h"
 #include "pin.h"
 #include "proactive.h"
+#include "tuak.h"
+#include <stdatomic.h>
 #include <stdint.h>
 #include <swicc/swicc.h>
 
@@ -16,6 +21,24 @@ typedef struct swsim_s
     pin_st pin[PIN_COUNT_MAX];
     swsim__proactive_st proactive;
     milenage_st milenage;
+    /* Used for AUTHENTICATE when milenage.algo selects TUAK. */
+    tuak_st tuak;
+    gsm_algo_et gsm_algo; /* Variant run by RUN GSM ALGORITHM. */
+
+    /* Response waiting for GET RESPONSE. */
+    sim_apdu_rsp_st rsp;
+    /**
+     * Return responses of case 4 commands directly with 9000 instead of
+     * waiting for GET RESPONSE. Atomic since it can be toggled at runtime
+     * (SIGUSR1) to compare the two modes.
+     */
+    atomic_bool rsp_direct;
+
+    /* Trace log of this instance, milenage and proactive point to it. */
+    log_st log;
+
+    /* State of the swICC this swSIM was initialized with. */
+    swicc_st *swicc_state;
 } swsim_st;
 
 /**
@@ -27,6 +50,33 @@ typedef struct swsim_s
  * @param[in] path_swicc Where the generated swICC FS file will be written. When
  * this is NULL, the generated swICC file will not be written to disk.
  * @return 0 on success, -1 on failure.
+ * @note All state of a card lives in its swsim_st and swicc_st and the shared
+ * tables are read-only, so different cards can be driven from different threads
+ * without locks.
  */
 int32_t swsim_init(swsim_st *const swsim_state, swicc_st *const swicc_state,
                    char const *const path_json, char const *const path_swicc);
+
+/**
+ * @brief Send a command to the card and get its response in-process, without a
+ * swICC server or any other transport in between. The terminal side of T=0 is
+ * done here: command data is sent when the card asks for it with ACK ALL, a
+ * case 2 command is resent with the Le of a 6CXX, and the response announced
+ * by 61XX (or the GSM 9FXX) is collected with GET RESPONSE.
+ * @param[in, out] swsim_state Initialized with swsim_init.
+ * @param[in] cmd Short command APDU per ISO/IEC 7816-3:2006 clause.12.1: CLA INS
+ * P1 P2, optionally followed by Le (case 2), or by Lc and the data (case 3),
+ * and then Le (case 4).
+ * @param[in] cmd_len Length of the command.
+ * @param[out] rsp Receives the response data followed by SW1 and SW2.
+ * @param[in, out] rsp_len Size of the response buffer on input, length of the
+ * response on output.
+ * @return 0 on success, -1 if the command is malformed, the response does not
+ * fit, or the exchange failed.
+ * @note Commands go through the same dispatch as with the swICC network
+ * client, so the ones swSIM leaves to swICC (e.g. READ BINARY, READ RECORD, and
+ * SEARCH RECORD) work too.
+ */
+int32_t swsim_apdu_transact(swsim_st *const swsim_state,
+                            uint8_t const *const cmd, uint32_t const cmd_len,
+                            uint8_t *const rsp, uint32_t *const rsp_len);
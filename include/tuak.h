@@ -0,0 +1,81 @@
+#pragma once
+
+#include "keccak.h"
+#include "milenage.h"
+
+/**
+ * TUAK per ETSI TS 135 231 V17.0.0 with the output lengths that fit the
+ * Milenage vector (milenage_vec_st): 64-bit MAC and RES, 128-bit CK and IK.
+ * The subscriber key can be 128 or 256 bits.
+ */
+#define TUAK_ALGONAME "TUAK1.0"
+#define TUAK_K_LEN_MAX 32U
+
+/* Number of tuples processed together by tuak_all_xN. */
+#define TUAK_XN_CHUNK 16U
+
+typedef struct tuak_s
+{
+    uint8_t k[TUAK_K_LEN_MAX];
+    uint8_t k_len; /* 16 or 32 bytes. */
+
+    /**
+     * TOPc is derived from TOP and K (see tuak_top_set) or provisioned directly
+     * like OPc is for Milenage.
+     */
+    uint8_t top_c[32];
+
+    /* Number of times Keccak-f[1600] is applied per function, usually 1. */
+    uint8_t iter;
+} tuak_st;
+
+/**
+ * @brief Set the subscriber key. If TOPc is computed on the USIM, tuak_top_set
+ * must be called again afterwards.
+ * @param[in, out] tuak TUAK parameters.
+ * @param[in] k Subscriber key.
+ * @param[in] k_len Length of the key (16 or 32 bytes).
+ * @return 0 on success, -1 if the key length is not supported.
+ */
+int32_t tuak_k_set(tuak_st *const tuak, uint8_t const *const k,
+                   uint8_t const k_len);
+
+/**
+ * @brief Derive TOPc from TOP and the current K per ETSI TS 135 231 V17.0.0
+ * clause.6.2 and store it in top_c. The key must already be set.
+ * @param[in, out] tuak TUAK parameters.
+ * @param[in] top Operator variant algorithm configuration field.
+ */
+void tuak_top_set(tuak_st *const tuak, uint8_t const top[const 32]);
+
+/**
+ * @brief Compute all TUAK functions (f1, f1*, f2, f3, f4, f5, f5*) and the GSM
+ * Kc. f1, f1*, and f5* are independent of each other so their permutations run
+ * together (see keccak_f1600_xN).
+ * @param[in] tuak TUAK parameters.
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number, or SQN ^ AK when sqn_concealed is true.
+ * @param[in] sqn_concealed If the SQN is concealed with AK.
+ * @param[in] amf Authentication management field.
+ * @param[out] vec Where all the outputs will be written.
+ */
+void tuak_all(tuak_st const *const tuak, uint8_t const rand[const 16],
+              uint8_t const sqn[const 6], bool const sqn_concealed,
+              uint8_t const amf[const 2], milenage_vec_st *const vec);
+
+/**
+ * @brief Batch form of tuak_all for N independent (K, TOPc, RAND) tuples. The
+ * permutations of all tuples are done together so they can be vectorized.
+ * @param[in] tuak TUAK parameters of each tuple.
+ * @param[in] rand Random challenge of each tuple.
+ * @param[in] sqn Sequence number of each tuple (concealed or not, same as in
+ * tuak_all).
+ * @param[in] sqn_concealed If the SQNs are concealed with AK.
+ * @param[in] amf Authentication management field of each tuple.
+ * @param[out] vec Outputs of each tuple.
+ * @param[in] n Number of tuples.
+ */
+void tuak_all_xN(tuak_st const *const tuak[const],
+                 uint8_t const rand[const][16], uint8_t const sqn[const][6],
+                 bool const sqn_concealed, uint8_t const amf[const][2],
+                 milenage_vec_st vec[const], uint32_t const n);
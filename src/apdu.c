@@ -18,9 +18,58 @@ swicc_apdu_cla_st sim_apdu_cmd_cla_parse(uint8_t const cla_raw)
         cla.sm = (cla_raw & 0b00001100) >> 2U;
         cla.lchan = cla_raw & 0b00000011;
     }
+    else if (cla_raw >> (8U - 3U) == 0b000U /* First interindustry. */)
+    {
+        cla.raw = cla_raw;
+        cla.type = SWICC_APDU_CLA_TYPE_INTERINDUSTRY;
+        cla.ccc = SWICC_APDU_CLA_CCC_INVALID; /* Chaining is not supported. */
+        cla.sm = (cla_raw & 0b00001100) >> 2U;
+        cla.lchan = cla_raw & 0b00000011;
+    }
+    else if (cla_raw >> (8U - 2U) == 0b01U /* Further interindustry. */)
+    {
+        cla.raw = cla_raw;
+        cla.type = SWICC_APDU_CLA_TYPE_INTERINDUSTRY;
+        cla.ccc = SWICC_APDU_CLA_CCC_INVALID;
+        /* SM bit b6 has the meaning of b4-b3 = 10 of the first classes. */
+        cla.sm = (cla_raw & 0b00100000) >> 4U;
+        /* Safe cast since it is at most 19. */
+        cla.lchan = (uint8_t)(4U + (cla_raw & 0b00001111));
+    }
     else
     {
         cla.type = SWICC_APDU_CLA_TYPE_INVALID;
     }
     return cla;
 }
+
+void sim_apdu_rsp_reset(sim_apdu_rsp_st *const rsp)
+{
+    rsp->len = 0U;
+    rsp->offset = 0U;
+}
+
+void sim_apdu_rsp_stage(sim_apdu_rsp_st *const rsp, uint32_t const len)
+{
+    rsp->len = len;
+    rsp->offset = 0U;
+}
+
+uint8_t const *sim_apdu_rsp_take(sim_apdu_rsp_st *const rsp,
+                                 uint32_t const len)
+{
+    if (rsp->len - rsp->offset < len)
+    {
+        return NULL;
+    }
+    uint8_t const *const part = &rsp->b[rsp->offset];
+    rsp->offset += len;
+    return part;
+}
+
+uint8_t sim_apdu_rsp_sw2(sim_apdu_rsp_st const *const rsp)
+{
+    uint32_t const left = rsp->len - rsp->offset;
+    /* Safe cast since it is checked to fit. */
+    return left > UINT8_MAX ? 0U : (uint8_t)left;
+}
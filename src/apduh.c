@@ -14,6 +14,35 @@
 #include <string.h>
 #include <swicc/fs/common.h>
 
+/**
+ * @brief Answer a command whose response was staged for GET RESPONSE. In the
+ * direct response mode, a response that fits in a short APDU is returned right
+ * away with 9000 which saves the GET RESPONSE exchange. Otherwise the terminal
+ * is told how much it can get.
+ * @param[in, out] swsim_state
+ * @param[out] res
+ * @param[in] sw1_get SW1 telling the terminal to send GET RESPONSE (61 or the
+ * GSM 9F).
+ * @note Returning data to a case 4 command is not allowed by T=0 (ETSI TS 102
+ * 221 V16.4.0 clause.7.3.1.1.4) so the mode is only for transports that pass
+ * the response on as is.
+ */
+static void apduh_rsp_give(swsim_st *const swsim_state,
+                           swicc_apdu_res_st *const res, uint8_t const sw1_get)
+{
+    sim_apdu_rsp_st *const rsp = &swsim_state->rsp;
+    uint32_t const left = rsp->len - rsp->offset;
+    if (atomic_load_explicit(&swsim_state->rsp_direct, memory_order_relaxed) &&
+        left <= SWICC_DATA_MAX_SHRT)
+    {
+        memcpy(res->data.b, sim_apdu_rsp_take(rsp, left), left);
+        /* Safe cast since it is no longer than a short APDU response. */
+        SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_NONE, 0U, (uint16_t)left);
+        return;
+    }
+    SWICC_APDUH_RES(res, sw1_get, sim_apdu_rsp_sw2(rsp), 0U);
+}
+
 /**
  * @brief Handle the SELECT command in the proprietary class A0 of GSM 11.11.
  * @note As described in GSM 11.11 v4.21.1 (ETS 300 608) clause.9.2.1 (command),
@@ -96,10 +125,12 @@ static swicc_ret_et apduh_gsm_select(swicc_st *const swicc_state,
             return SWICC_RET_SUCCESS;
         }
 
+        /* The response is made in the GET RESPONSE buffer directly. */
         swicc_fs_file_st *const file_selected = &swicc_state->fs.va.cur_file;
-        uint16_t select_res_len = sizeof(res->data);
+        uint16_t select_res_len = SIM_APDU_RSP_SIZE_U16;
         if (gsm_select_res(&swicc_state->fs, swicc_state->fs.va.cur_tree,
-                           file_selected, res->data.b, &select_res_len) != 0 ||
+                           file_selected, swsim_state->rsp.b,
+                           &select_res_len) != 0 ||
             select_res_len > UINT8_MAX)
         {
             res->sw1 = SWICC_APDU_SW1_CHER_UNK;
@@ -107,28 +138,10 @@ static swicc_ret_et apduh_gsm_select(swicc_st *const swicc_state,
             res->data.len = 0U;
             return SWICC_RET_SUCCESS;
         }
-        /* Safe cast due to check in if for GSM SELECT response creation. */
-        res->data.len = (uint8_t)select_res_len;
-
-        /* Copy response to the GET RESPONSE buffer. */
-        if (swicc_apdu_rc_enq(&swicc_state->apdu_rc, res->data.b,
-                              res->data.len) != SWICC_RET_SUCCESS)
-        {
-            /**
-             * @todo NV modified but can't indicate this, not sure what
-             * to do here.
-             */
-            res->sw1 = SWICC_APDU_SW1_CHER_UNK;
-            res->sw2 = 0U;
-            res->data.len = 0U;
-            return SWICC_RET_SUCCESS;
-        }
+        sim_apdu_rsp_stage(&swsim_state->rsp, select_res_len);
 
         /* "Length 'XX' of the response data." where 'XX' is SW2. */
-        res->sw1 = 0x9F;
-        /* Safe cast due to check while making GSM SELECT response. */
-        res->sw2 = (uint8_t)select_res_len; /* Length of response. */
-        res->data.len = 0U;
+        apduh_rsp_give(swsim_state, res, 0x9F);
         return SWICC_RET_SUCCESS;
     }
 }
@@ -155,10 +168,11 @@ static swicc_ret_et apduh_gsm_res_get(swicc_st *const swicc_state,
         return SWICC_RET_SUCCESS;
     }
 
-    uint32_t data_req_len = *cmd->p3;
-    if (swicc_apdu_rc_deq(&swicc_state->apdu_rc, res->data.b, &data_req_len) !=
-            SWICC_RET_SUCCESS ||
-        data_req_len != *cmd->p3)
+    swsim_st *const swsim_state = (swsim_st *)swicc_state->userdata;
+    uint8_t const *const part =
+        swsim_state == NULL ? NULL
+                            : sim_apdu_rsp_take(&swsim_state->rsp, *cmd->p3);
+    if (part == NULL)
     {
         /* Failed to get the requested data. */
         res->sw1 = SWICC_APDU_SW1_CHER_UNK;
@@ -167,6 +181,7 @@ static swicc_ret_et apduh_gsm_res_get(swicc_st *const swicc_state,
         return SWICC_RET_SUCCESS;
     }
 
+    memcpy(res->data.b, part, *cmd->p3);
     res->sw1 = SWICC_APDU_SW1_NORM_NONE;
     res->sw2 = 0U;
     res->data.len = *cmd->p3;
@@ -366,20 +381,18 @@ static swicc_ret_et apduh_gsm_gsm_algo_run(swicc_st *const swicc_state,
      * K (sometimes called Ki) is the A3/A8 individual subscriber authentication
      * key.
      */
-    gsm_algo(swsim_state->milenage.k, cmd->data->b, res->data.b);
-    res->data.len = 12U;
-    /* Copy response to the GET RESPONSE buffer. */
-    if (swicc_apdu_rc_enq(&swicc_state->apdu_rc, res->data.b, res->data.len) ==
-        SWICC_RET_SUCCESS)
-    {
-        SWICC_APDUH_RES(res, 0x9F, 12U, 0U);
-        return SWICC_RET_SUCCESS;
-    }
-    else
+    if (gsm_algo_run(swsim_state->gsm_algo, swsim_state->milenage.k,
+                     cmd->data->b, swsim_state->rsp.b) != 0)
     {
+        LOG_ERR(&swsim_state->log, "GSM algorithm %" PRIu64 " is unavailable.",
+                (uint64_t)swsim_state->gsm_algo);
         SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_UNK, 0U, 0U);
         return SWICC_RET_SUCCESS;
     }
+    /* SRES and Kc wait in the GET RESPONSE buffer. */
+    sim_apdu_rsp_stage(&swsim_state->rsp, 12U);
+    apduh_rsp_give(swsim_state, res, 0x9F);
+    return SWICC_RET_SUCCESS;
 }
 
 /**
@@ -692,13 +705,6 @@ static swicc_ret_et apduh_3gpp_select(swicc_st *const swicc_state,
         }
         else
         {
-            /**
-             * Make sure to fail when extended APDUs are used since they are
-             * unsupported here.
-             */
-            static_assert(
-                SWICC_DATA_MAX == SWICC_DATA_MAX_SHRT,
-                "Response buffer length might not fit in SW2 if SW1 is 0x61");
             if (swicc_state->fs.va.cur_tree == NULL)
             {
                 // When no tree is selected, this is not allowed.
@@ -706,20 +712,29 @@ static swicc_ret_et apduh_3gpp_select(swicc_st *const swicc_state,
                 return SWICC_RET_SUCCESS;
             }
 
-            /* The file that was requested to be selected. */
+            swsim_st *const swsim_state = swicc_state->userdata;
+            if (swsim_state == NULL)
+            {
+                SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_UNK, 0U, 0U);
+                return SWICC_RET_SUCCESS;
+            }
+
+            /**
+             * The file that was requested to be selected. The FCP is made in
+             * the GET RESPONSE buffer directly.
+             */
             swicc_fs_file_st *const file_selected =
                 &swicc_state->fs.va.cur_file;
-            uint16_t buf_select_len = sizeof(res->data.b);
-            int32_t const ret_select_res =
-                o3gpp_select_res(&swicc_state->fs, swicc_state->fs.va.cur_tree,
-                                 file_selected, res->data.b, &buf_select_len);
-            if (ret_select_res == 0 && buf_select_len <= UINT8_MAX &&
-                swicc_apdu_rc_enq(&swicc_state->apdu_rc, res->data.b,
-                                  buf_select_len) == SWICC_RET_SUCCESS)
+            uint16_t buf_select_len = SIM_APDU_RSP_SIZE_U16;
+            int32_t const ret_select_res = o3gpp_select_res(
+                &swicc_state->fs, swicc_state->fs.va.cur_tree, file_selected,
+                swsim_state->rsp.b, &buf_select_len);
+            if (ret_select_res == 0)
             {
-                /* Safe cast due to check in the 'if'. */
-                SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_BYTES_AVAILABLE,
-                                (uint8_t)buf_select_len, 0U);
+                /* FCPs longer than 255 bytes take a few GET RESPONSEs. */
+                sim_apdu_rsp_stage(&swsim_state->rsp, buf_select_len);
+                apduh_rsp_give(swsim_state, res,
+                               SWICC_APDU_SW1_NORM_BYTES_AVAILABLE);
                 return SWICC_RET_SUCCESS;
             }
             else
@@ -781,7 +796,12 @@ static swicc_ret_et apduh_etsi_terminal_profile(
         }
     }
 
-    /* Terminal profile is ignored. */
+    /**
+     * Terminal profile is ignored but it starts the proactive session so the
+     * apps get to run.
+     */
+    swsim_st *const swsim_state = swicc_state->userdata;
+    proactive_wake(&swsim_state->proactive);
     res->sw1 = SWICC_APDU_SW1_NORM_NONE;
     res->sw2 = 0U;
     res->data.len = 0U;
@@ -815,6 +835,21 @@ static swicc_ret_et apduh_etsi_cat_fetch(swicc_st *const swicc_state,
     if (procedure_count == 0U)
     {
         swsim_st *const swsim_state = swicc_state->userdata;
+        if (swsim_state->proactive.command_length > UINT8_MAX)
+        {
+            /**
+             * A command longer than Le can express is only possible with
+             * extended buffers, it is handed out through GET RESPONSE.
+             */
+            memcpy(swsim_state->rsp.b, swsim_state->proactive.command,
+                   swsim_state->proactive.command_length);
+            sim_apdu_rsp_stage(&swsim_state->rsp,
+                               swsim_state->proactive.command_length);
+            swsim_state->proactive.command_length = 0;
+            SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_BYTES_AVAILABLE,
+                            sim_apdu_rsp_sw2(&swsim_state->rsp), 0U);
+            return SWICC_RET_SUCCESS;
+        }
         if (*cmd->p3 != swsim_state->proactive.command_length)
         {
             /* Expected Le to be the exact length of the command. */
@@ -829,7 +864,8 @@ static swicc_ret_et apduh_etsi_cat_fetch(swicc_st *const swicc_state,
 
         res->sw1 = SWICC_APDU_SW1_NORM_NONE;
         res->sw2 = 0U;
-        res->data.len = swsim_state->proactive.command_length;
+        /* Safe cast since it is equal to P3. */
+        res->data.len = (uint8_t)swsim_state->proactive.command_length;
         swsim_state->proactive.command_length = 0;
         return SWICC_RET_SUCCESS;
     }
@@ -880,6 +916,7 @@ static swicc_ret_et apduh_etsi_cat_terminal_response(
     /* Copy response into the proactive struct. */
     memcpy(swsim_state->proactive.response, cmd->data->b, cmd->data->len);
     swsim_state->proactive.response_length = cmd->data->len;
+    proactive_wake(&swsim_state->proactive);
     if (swsim_state->proactive.app_default_response_wait)
     {
         /* Give response to default app. */
@@ -944,6 +981,7 @@ static swicc_ret_et apduh_etsi_cat_envelope(swicc_st *const swicc_state,
     swsim_st *const swsim_state = swicc_state->userdata;
     swsim_state->proactive.envelope_length = cmd->data->len;
     memcpy(swsim_state->proactive.envelope, cmd->data->b, cmd->data->len);
+    proactive_wake(&swsim_state->proactive);
 
     swicc_ret_et ret_envelope = SWICC_RET_SUCCESS;
     if (swsim_state->proactive.app_default_enable)
@@ -1065,18 +1103,25 @@ static swicc_ret_et apduh_3gpp_status(swicc_st *const swicc_state,
             SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_CMD, 0U, 0U);
             return SWICC_RET_SUCCESS;
         }
-        memset(res->data.b, 0xFF, *cmd->p3);
+        swsim_st *const swsim_state = swicc_state->userdata;
+        if (swsim_state == NULL)
+        {
+            SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_UNK, 0U, 0U);
+            return SWICC_RET_SUCCESS;
+        }
         swicc_fs_file_st *const file_selected = &swicc_state->fs.va.cur_adf;
-        uint16_t buf_select_len = sizeof(res->data.b);
-        int32_t const ret_select_res =
-            o3gpp_select_res(&swicc_state->fs, swicc_state->fs.va.cur_tree_adf,
-                             file_selected, res->data.b, &buf_select_len);
-        if (ret_select_res == 0 && buf_select_len <= UINT8_MAX &&
-            swicc_apdu_rc_enq(&swicc_state->apdu_rc, res->data.b,
-                              buf_select_len) == SWICC_RET_SUCCESS)
+        uint16_t buf_select_len = SIM_APDU_RSP_SIZE_U16;
+        int32_t const ret_select_res = o3gpp_select_res(
+            &swicc_state->fs, swicc_state->fs.va.cur_tree_adf, file_selected,
+            swsim_state->rsp.b, &buf_select_len);
+        if (ret_select_res == 0)
         {
+            sim_apdu_rsp_stage(&swsim_state->rsp, buf_select_len);
             if (buf_select_len == *cmd->p3)
             {
+                /* The whole response goes out now, nothing is left to get. */
+                memcpy(res->data.b, swsim_state->rsp.b, buf_select_len);
+                sim_apdu_rsp_reset(&swsim_state->rsp);
                 SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_NONE, 0U, *cmd->p3);
                 return SWICC_RET_SUCCESS;
             }
@@ -1084,16 +1129,15 @@ static swicc_ret_et apduh_3gpp_status(swicc_st *const swicc_state,
             {
                 // Not sure about this one. Is this valid?
                 SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_BYTES_AVAILABLE,
-                                (uint8_t)buf_select_len, *cmd->p3);
+                                sim_apdu_rsp_sw2(&swsim_state->rsp), *cmd->p3);
                 return SWICC_RET_SUCCESS;
             }
             else
             {
                 /* Requested wrong response length. */
                 /* "Wrong Le field." */
-                /* Safe cast due to check in 'if'. */
                 SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_LE,
-                                (uint8_t)buf_select_len, 0U);
+                                sim_apdu_rsp_sw2(&swsim_state->rsp), 0U);
                 return SWICC_RET_SUCCESS;
             }
         }
@@ -1527,7 +1571,18 @@ static swicc_ret_et apduh_3gpp_authenticate(swicc_st *const swicc_state,
         if (memcmp(rid, rid_usim, sizeof(rid_usim)) == 0 &&
             memcmp(pix, pix_usim, sizeof(pix_usim)) == 0)
         {
-            /* Performing UMTS authentication using milenage. */
+            /* Performing UMTS authentication using the selected algorithm. */
+            if (swsim_state->milenage.algo == MILENAGE_ALGO_MILENAGE &&
+                !swsim_state->milenage.config_valid)
+            {
+                /**
+                 * 6985 = "Conditions of use not satisfied" since the Milenage
+                 * parameters were never validated.
+                 */
+                SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_CMD, 0x85, 0);
+                return SWICC_RET_SUCCESS;
+            }
+
             if (cmd->data->len != 1 /* length of RAND */ + 16 /* RAND */ +
                                       1 /* length of auth token */ +
                                       16 /* auth token */)
@@ -1552,9 +1607,32 @@ static swicc_ret_et apduh_3gpp_authenticate(swicc_st *const swicc_state,
             uint8_t const *const rand = &cmd->data->b[1];
             uint8_t const *const token_auth = &cmd->data->b[1 + 16 + 1];
 
+            /**
+             * The SQN array is kept in a proprietary EF of the USIM so that it
+             * is saved with the card image. If the image does not have it, the
+             * array only lives in memory.
+             */
+            uint8_t *sqn_array = NULL;
+            swicc_fs_file_st file_sqn;
+            if (swicc_disk_lutsid_lookup(swicc_state->fs.va.cur_tree,
+                                         MILENAGE_SQN_EF_SID,
+                                         &file_sqn) == SWICC_RET_SUCCESS &&
+                file_sqn.hdr_item.type ==
+                    SWICC_FS_ITEM_TYPE_FILE_EF_TRANSPARENT &&
+                file_sqn.data_size >= MILENAGE_SQN_ARRAY_SIZE)
+            {
+                sqn_array = file_sqn.data;
+            }
+            if (sqn_array != swsim_state->milenage.sqn_array)
+            {
+                milenage_sqn_array_set(&swsim_state->milenage, sqn_array);
+            }
+
+            /* The response is made in the GET RESPONSE buffer directly. */
+            uint16_t rsp_len = 0U;
             swicc_ret_et const ret_milenage =
-                milenage(&swsim_state->milenage, rand, token_auth, res->data.b,
-                         &res->data.len);
+                milenage(&swsim_state->milenage, rand, token_auth,
+                         swsim_state->rsp.b, &rsp_len);
             if (ret_milenage != SWICC_RET_SUCCESS)
             {
                 /**
@@ -1566,23 +1644,9 @@ static swicc_ret_et apduh_3gpp_authenticate(swicc_st *const swicc_state,
             }
             else
             {
-                if (res->data.len > UINT8_MAX ||
-                    swicc_apdu_rc_enq(&swicc_state->apdu_rc, res->data.b,
-                                      res->data.len) == SWICC_RET_SUCCESS)
-                {
-                    /* Safe cast due to check in the 'if'. */
-                    SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_BYTES_AVAILABLE,
-                                    (uint8_t)res->data.len, 0U);
-                    return SWICC_RET_SUCCESS;
-                }
-                else
-                {
-                    SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_UNK, 0U, 0U);
-                    return SWICC_RET_SUCCESS;
-                }
-
-                SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_NONE, 0U,
-                                res->data.len);
+                sim_apdu_rsp_stage(&swsim_state->rsp, rsp_len);
+                apduh_rsp_give(swsim_state, res,
+                               SWICC_APDU_SW1_NORM_BYTES_AVAILABLE);
                 return SWICC_RET_SUCCESS;
             }
         }
@@ -1600,6 +1664,57 @@ static swicc_ret_et apduh_3gpp_authenticate(swicc_st *const swicc_state,
     return SWICC_RET_SUCCESS;
 }
 
+/**
+ * @brief Handle the GET RESPONSE command in the classes 0X, 4X, and 6X of
+ * ETSI TS 102 221 V16.4.0. Responses of swICC's own handlers are left to the
+ * swICC default.
+ * @note As described in ETSI TS 102 221 V16.4.0 clause.11.1.13 and
+ * clause.7.3.1.1.4 (case 4 commands).
+ */
+static swicc_apduh_ft apduh_3gpp_res_get;
+static swicc_ret_et apduh_3gpp_res_get(swicc_st *const swicc_state,
+                                       swicc_apdu_cmd_st const *const cmd,
+                                       swicc_apdu_res_st *const res,
+                                       uint32_t const procedure_count)
+{
+    swsim_st *const swsim_state = swicc_state->userdata;
+    if (swsim_state == NULL ||
+        swsim_state->rsp.offset >= swsim_state->rsp.len)
+    {
+        return SWICC_RET_APDU_UNHANDLED;
+    }
+
+    if (cmd->hdr->p1 != 0 || cmd->hdr->p2 != 0)
+    {
+        SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_P1P2, 0U, 0U);
+        return SWICC_RET_SUCCESS;
+    }
+
+    /* Le of 0 means 256. */
+    uint16_t const le = *cmd->p3 == 0U ? 256U : *cmd->p3;
+    uint32_t const left = swsim_state->rsp.len - swsim_state->rsp.offset;
+    if (le > left)
+    {
+        /* "Wrong length Le", SW2 indicates the available length. */
+        SWICC_APDUH_RES(res, SWICC_APDU_SW1_CHER_LE,
+                        sim_apdu_rsp_sw2(&swsim_state->rsp), 0U);
+        return SWICC_RET_SUCCESS;
+    }
+
+    memcpy(res->data.b, sim_apdu_rsp_take(&swsim_state->rsp, le), le);
+    if (le < left)
+    {
+        /* The rest of a long response needs more GET RESPONSEs. */
+        SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_BYTES_AVAILABLE,
+                        sim_apdu_rsp_sw2(&swsim_state->rsp), le);
+    }
+    else
+    {
+        SWICC_APDUH_RES(res, SWICC_APDU_SW1_NORM_NONE, 0U, le);
+    }
+    return SWICC_RET_SUCCESS;
+}
+
 /**
  * @brief Handle the UPDATE BINARY command in the proprietary class 0xA0
  * of 3GPP TS 51.011.
@@ -1621,214 +1736,139 @@ static swicc_ret_et apduh_gsm_bin_update(swicc_st *const swicc_state,
     return apduh_3gpp_bin_update(swicc_state, cmd, res, procedure_count);
 }
 
+/* Groups of CLA bytes that accept the same set of instructions. */
+typedef enum apduh_cla_e
+{
+    APDUH_CLA_NONE = 0,   /* Nothing is handled here. */
+    APDUH_CLA_ISO_046,    /* Interindustry 0X, 4X, and 6X. */
+    APDUH_CLA_ISO,        /* Any other interindustry CLA. */
+    APDUH_CLA_PROP_046,   /* Proprietary 0X, 4X, and 6X (ETSI + 3GPP). */
+    APDUH_CLA_ETSI,       /* Exactly 80 (ETSI). */
+    APDUH_CLA_ETSI_8CE,   /* Any other 8X, CX, and EX (ETSI + 3GPP). */
+    APDUH_CLA_GSM,        /* Exactly A0 (GSM). */
+    APDUH_CLA_COUNT,
+} apduh_cla_et;
+
+/**
+ * Every command handled by swSIM as (CLA group, INS, handler). The constraints
+ * on what instructions live in what CLA are described in ETSI TS 102 221
+ * V16.4.0 clause.10.1.2 table.10.5. Interindustry SELECT, RESET RETRY COUNTER,
+ * VERIFY, UPDATE BINARY, and AUTHENTICATE override the swICC defaults since the
+ * proprietary ones support fewer/different features and respond with
+ * proprietary BER-TLV tags. A duplicate (CLA group, INS) pair fails the build
+ * (-Woverride-init).
+ */
+// clang-format off
+#define APDUH_LIST(X)                                                          \
+    X(APDUH_CLA_ISO_046,  0xA4, apduh_3gpp_select) /* SELECT */                \
+    X(APDUH_CLA_ISO_046,  0x2C, apduh_3gpp_pin_unblock) /* UNBLOCK PIN */      \
+    X(APDUH_CLA_ISO_046,  0x20, apduh_3gpp_pin_verify) /* VERIFY PIN */        \
+    X(APDUH_CLA_ISO_046,  0xD6, apduh_3gpp_bin_update) /* UPDATE BINARY */     \
+    X(APDUH_CLA_ISO_046,  0x88, apduh_3gpp_authenticate) /* AUTHENTICATE */    \
+    X(APDUH_CLA_ISO_046,  0xC0, apduh_3gpp_res_get) /* GET RESPONSE */         \
+    X(APDUH_CLA_ISO,      0xA4, apduh_3gpp_select) /* SELECT */                \
+    X(APDUH_CLA_ISO,      0x2C, apduh_3gpp_pin_unblock) /* UNBLOCK PIN */      \
+    X(APDUH_CLA_ISO,      0x20, apduh_3gpp_pin_verify) /* VERIFY PIN */        \
+    X(APDUH_CLA_ISO,      0xD6, apduh_3gpp_bin_update) /* UPDATE BINARY */     \
+    X(APDUH_CLA_ISO,      0xC0, apduh_3gpp_res_get) /* GET RESPONSE */         \
+    X(APDUH_CLA_PROP_046, 0xA4, apduh_3gpp_select) /* SELECT */                \
+    X(APDUH_CLA_PROP_046, 0x2C, apduh_3gpp_pin_unblock) /* UNBLOCK PIN */      \
+    X(APDUH_CLA_PROP_046, 0x20, apduh_3gpp_pin_verify) /* VERIFY PIN */        \
+    X(APDUH_CLA_PROP_046, 0xD6, apduh_3gpp_bin_update) /* UPDATE BINARY */     \
+    X(APDUH_CLA_PROP_046, 0x88, apduh_3gpp_authenticate) /* AUTHENTICATE */    \
+    X(APDUH_CLA_PROP_046, 0xC0, apduh_3gpp_res_get) /* GET RESPONSE */         \
+    X(APDUH_CLA_ETSI,     0x10, apduh_etsi_terminal_profile) /* TERM. PROF. */ \
+    X(APDUH_CLA_ETSI,     0x12, apduh_etsi_cat_fetch) /* FETCH */              \
+    X(APDUH_CLA_ETSI,     0x14, apduh_etsi_cat_terminal_response) /* T. R. */  \
+    X(APDUH_CLA_ETSI,     0xC2, apduh_etsi_cat_envelope) /* ENVELOPE */        \
+    X(APDUH_CLA_ETSI,     0xF2, apduh_3gpp_status) /* STATUS */                \
+    X(APDUH_CLA_ETSI_8CE, 0xF2, apduh_3gpp_status) /* STATUS */                \
+    X(APDUH_CLA_GSM,      0xA4, apduh_gsm_select) /* SELECT */                 \
+    X(APDUH_CLA_GSM,      0xC0, apduh_gsm_res_get) /* GET RESPONSE */          \
+    X(APDUH_CLA_GSM,      0xB0, apduh_gsm_bin_read) /* READ BINARY */          \
+    X(APDUH_CLA_GSM,      0xF2, apduh_gsm_status) /* STATUS */                 \
+    X(APDUH_CLA_GSM,      0xD6, apduh_gsm_bin_update) /* UPDATE BINARY */      \
+    X(APDUH_CLA_GSM,      0x88, apduh_gsm_gsm_algo_run) /* RUN GSM ALGO */
+// clang-format on
+
+/* Handler of every (CLA group, INS), NULL when the command is not handled. */
+#define APDUH_TABLE_ENTRY(cla_, ins_, handler_) [cla_][ins_] = handler_,
+static swicc_apduh_ft *const apduh_table[APDUH_CLA_COUNT][UINT8_MAX + 1U] = {
+    APDUH_LIST(APDUH_TABLE_ENTRY)};
+#undef APDUH_TABLE_ENTRY
+
+/**
+ * @brief Find the group of a CLA (as parsed by swICC).
+ * @param[in] cla Class of the command.
+ * @return Group of the CLA.
+ */
+static apduh_cla_et apduh_cla_group(swicc_apdu_cla_st const cla)
+{
+    uint8_t const cla_hi = cla.raw & 0xF0;
+    bool const cla_046 = cla_hi == 0x00 || cla_hi == 0x40 || cla_hi == 0x60;
+    switch (cla.type)
+    {
+    case SWICC_APDU_CLA_TYPE_INTERINDUSTRY:
+        return cla_046 ? APDUH_CLA_ISO_046 : APDUH_CLA_ISO;
+    case SWICC_APDU_CLA_TYPE_PROPRIETARY:
+        if (cla.raw == 0x80)
+        {
+            return APDUH_CLA_ETSI;
+        }
+        if (cla.raw == 0xA0)
+        {
+            return APDUH_CLA_GSM;
+        }
+        if (cla_hi == 0x80 || cla_hi == 0xC0 || cla_hi == 0xE0)
+        {
+            return APDUH_CLA_ETSI_8CE;
+        }
+        return cla_046 ? APDUH_CLA_PROP_046 : APDUH_CLA_NONE;
+    default:
+        return APDUH_CLA_NONE;
+    }
+}
+
 swicc_ret_et sim_apduh_demux(swicc_st *const swicc_state,
                              swicc_apdu_cmd_st const *const cmd,
                              swicc_apdu_res_st *const res,
                              uint32_t const procedure_count)
 {
     swicc_ret_et ret = SWICC_RET_APDU_UNHANDLED;
-    switch (cmd->hdr->cla.type)
+    swsim_st *sim_state = swicc_state->userdata;
+    if (sim_state == NULL)
     {
-    case SWICC_APDU_CLA_TYPE_INTERINDUSTRY:
-        switch (cmd->hdr->ins)
-        {
-        case 0xA4: /* SELECT */
-            /**
-             * Override the default SELECT because the proprietary one supports
-             * fewer/different features and responds with proprietary BER-TLV
-             * tags.
-             */
-            ret = apduh_3gpp_select(swicc_state, cmd, res, procedure_count);
-            break;
-        case 0x2C: /* RESET RETRY COUNTER */
-            /**
-             * Override the default RESET RETRY COUNTER instruction with am
-             * UNBLOCK PIN.
-             */
-            ret =
-                apduh_3gpp_pin_unblock(swicc_state, cmd, res, procedure_count);
-            break;
-        case 0x20: /* VERIFY */
-            /**
-             * Override the default VERIFY instruction with a VERIFY PIN.
-             */
-            ret = apduh_3gpp_pin_verify(swicc_state, cmd, res, procedure_count);
-            break;
-        case 0xD6: /* UPDATE BINARY */
-            /**
-             * Override the default UPDATE BINARY with the UPDATE BINARY from
-             * 3GPP.
-             */
-            ret = apduh_3gpp_bin_update(swicc_state, cmd, res, procedure_count);
-            break;
-        case 0x88: /* AUTHENTICATE */
-            /**
-             * Override the default AUTHENTICATE command with AUTHENTICATE as
-             * defined by ETSI + 3GPP.
-             */
-            if ((cmd->hdr->cla.raw & 0xF0) == 0x00 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x40 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x60)
-            {
-                ret = apduh_3gpp_authenticate(swicc_state, cmd, res,
-                                              procedure_count);
-            }
-            break;
-        default:
-            break;
-        }
-        break;
-    case SWICC_APDU_CLA_TYPE_PROPRIETARY:
-        /* ETSI + 3GPP + GSM */
-        if (cmd->hdr->ins != 0xC0) /* GET RESPONSE instruction */
+        /* Without a swSIM state, everything is left to swICC. */
+        return SWICC_RET_APDU_UNHANDLED;
+    }
+    bool const proprietary =
+        cmd->hdr->cla.type == SWICC_APDU_CLA_TYPE_PROPRIETARY;
+    if (cmd->hdr->ins != 0xC0 /* GET RESPONSE */)
+    {
+        /* Make GET RESPONSE deterministically not work if resumed. */
+        sim_apdu_rsp_reset(&sim_state->rsp);
+        if (proprietary)
         {
-            /* Make GET RESPONSE deterministically not work if resumed. */
             swicc_apdu_rc_reset(&swicc_state->apdu_rc);
         }
+    }
 
-        /* The swICC does not parse proprietary CLAs beyond just the type. */
-        cmd->hdr->cla = sim_apdu_cmd_cla_parse(cmd->hdr->cla.raw);
-
-        /**
-         * The constraints on what instructions live in what CLA is described in
-         * ETSI TS 102 221 V16.4.0 clause.10.1.2 table.10.5.
-         */
-        switch (cmd->hdr->ins)
+    swicc_apduh_ft *const handler =
+        apduh_table[apduh_cla_group(cmd->hdr->cla)][cmd->hdr->ins];
+    if (handler != NULL)
+    {
+        if (proprietary)
         {
-        case 0xA4: /* SELECT */
-            /* ETSI + 3GPP */
-            if ((cmd->hdr->cla.raw & 0xF0) == 0x00 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x40 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x60)
-            {
-                ret = apduh_3gpp_select(swicc_state, cmd, res, procedure_count);
-            }
-            /* GSM */
-            else if (cmd->hdr->cla.raw == 0xA0)
-            {
-                ret = apduh_gsm_select(swicc_state, cmd, res, procedure_count);
-            }
-            break;
-        case 0x10: /* TERMINAL PROFILE */
-            /* ETSI */
-            if (cmd->hdr->cla.raw == 0x80)
-            {
-                ret = apduh_etsi_terminal_profile(swicc_state, cmd, res,
-                                                  procedure_count);
-            }
-            break;
-        case 0x12: /* FETCH */
-            /* ETSI */
-            if (cmd->hdr->cla.raw == 0x80)
-            {
-                ret = apduh_etsi_cat_fetch(swicc_state, cmd, res,
-                                           procedure_count);
-            }
-            break;
-        case 0x14: /* TERMINAL RESPONSE */
-            /* ETSI */
-            if (cmd->hdr->cla.raw == 0x80)
-            {
-                ret = apduh_etsi_cat_terminal_response(swicc_state, cmd, res,
-                                                       procedure_count);
-            }
-            break;
-        case 0xC2: /* ENVELOPE */
-            /* ETSI */
-            if (cmd->hdr->cla.raw == 0x80)
-            {
-                ret = apduh_etsi_cat_envelope(swicc_state, cmd, res,
-                                              procedure_count);
-            }
-            break;
-        case 0xC0: /* GET RESPONSE */
-            /* GSM */
-            if (cmd->hdr->cla.raw == 0xA0)
-            {
-                ret = apduh_gsm_res_get(swicc_state, cmd, res, procedure_count);
-            }
-            break;
-        case 0xB0: /* READ BINARY */
-            /* GSM */
-            if (cmd->hdr->cla.raw == 0xA0)
-            {
-                ret =
-                    apduh_gsm_bin_read(swicc_state, cmd, res, procedure_count);
-            }
-            break;
-        case 0xF2: /* STATUS */
-            /* ETSI + 3GPP */
-            if ((cmd->hdr->cla.raw & 0xF0) == 0x80 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0xC0 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0xE0)
-            {
-                ret = apduh_3gpp_status(swicc_state, cmd, res, procedure_count);
-            }
-            /* GSM */
-            else if (cmd->hdr->cla.raw == 0xA0)
-            {
-                ret = apduh_gsm_status(swicc_state, cmd, res, procedure_count);
-            }
-            break;
-        case 0x2C: /* UNBLOCK PIN */
-            if ((cmd->hdr->cla.raw & 0xF0) == 0x00 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x40 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x60)
-            {
-                ret = apduh_3gpp_pin_unblock(swicc_state, cmd, res,
-                                             procedure_count);
-            }
-            break;
-        case 0x20: /* VERIFY PIN */
-            if ((cmd->hdr->cla.raw & 0xF0) == 0x00 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x40 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x60)
-            {
-                ret = apduh_3gpp_pin_verify(swicc_state, cmd, res,
-                                            procedure_count);
-            }
-            break;
-        case 0xD6: /* UPDATE BINARY */
-            /* ETSI + 3GPP */
-            if ((cmd->hdr->cla.raw & 0xF0) == 0x00 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x40 ||
-                (cmd->hdr->cla.raw & 0xF0) == 0x60)
-            {
-                ret = apduh_3gpp_bin_update(swicc_state, cmd, res,
-                                            procedure_count);
-            }
-            else if (cmd->hdr->cla.raw == 0xA0)
-            {
-                ret = apduh_gsm_bin_update(swicc_state, cmd, res,
-                                           procedure_count);
-            }
-            break;
-        case 0x88: /* RUN GSM ALGORITHM */
-            /* GSM */
-            if (cmd->hdr->cla.raw == 0xA0)
-            {
-                ret = apduh_gsm_gsm_algo_run(swicc_state, cmd, res,
-                                             procedure_count);
-            }
-            /* ETSI + 3GPP */
-            else if ((cmd->hdr->cla.raw & 0xF0) == 0x00 ||
-                     (cmd->hdr->cla.raw & 0xF0) == 0x40 ||
-                     (cmd->hdr->cla.raw & 0xF0) == 0x60)
-            {
-                ret = apduh_3gpp_authenticate(swicc_state, cmd, res,
-                                              procedure_count);
-            }
-            break;
-        default:
-            break;
+            /**
+             * The swICC does not parse proprietary CLAs beyond just the type.
+             * This is only needed by commands that are actually handled.
+             */
+            cmd->hdr->cla = sim_apdu_cmd_cla_parse(cmd->hdr->cla.raw);
         }
-        break;
-    default:
-        break;
+        ret = handler(swicc_state, cmd, res, procedure_count);
     }
 
-    /* Run proactive applications. */
-    swsim_st *sim_state = swicc_state->userdata;
+    /* Run proactive applications if some event gave them work. */
     proactive_step(&sim_state->proactive);
     if (ret == SWICC_RET_SUCCESS)
     {
@@ -1836,20 +1876,21 @@ swicc_ret_et sim_apduh_demux(swicc_st *const swicc_state,
         {
             if (sim_state->proactive.command_length > 0)
             {
-                fprintf(
-                    stderr,
-                    "Proactive command present, overwriting status 9000 to 91%02X len=0x%04X.\n",
-                    (uint8_t)sim_state->proactive.command_length,
+                LOG_DBG(
+                    &sim_state->log,
+                    "Proactive command present, overwriting status 9000 to 91%02" PRIX64
+                    " len=0x%04" PRIX64 ".",
+                    sim_state->proactive.command_length & 0xFFU,
                     sim_state->proactive.command_length);
                 res->sw1 = 0x91;
-                static_assert(
-                    sizeof(sim_state->proactive.command) == 256,
-                    "Proactive command length does not fit in one byte.");
                 /**
-                 * Safe cast since the command buffer is no longer than the max
-                 * APDU length hence no longer than one byte.
+                 * A command that does not fit in SW2 is announced as 9100 and
+                 * FETCH then hands it out through GET RESPONSE.
+                 * Safe cast since it is checked to fit.
                  */
-                res->sw2 = (uint8_t)sim_state->proactive.command_length;
+                res->sw2 = sim_state->proactive.command_length > UINT8_MAX
+                               ? 0U
+                               : (uint8_t)sim_state->proactive.command_length;
             }
         }
     }
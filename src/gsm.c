@@ -357,76 +357,165 @@ int32_t gsm_select_res(swicc_fs_st const *const fs,
     }
 }
 
-void gsm_algo(uint8_t const ki[const 16], uint8_t const rand[const 16],
-              uint8_t res[const 12])
+/**
+ * @brief One butterfly level of the COMP128-1 compression for several
+ * instances at once. Pairs of bytes that are half a block apart get mixed and
+ * substituted with the table of the level. The instances are interleaved so
+ * their table lookups are independent of each other.
+ * @param[in, out] x State of each instance.
+ * @param[in] n Number of instances.
+ * @param[in] level Level of the butterfly (0 to 4).
+ */
+static inline __attribute__((always_inline)) void comp128_level(
+    uint8_t x[const][32U], uint32_t const n, uint32_t const level)
 {
-    uint8_t x[32U] = {0U};
-    uint8_t bit[128U] = {0U};
-    uint32_t m, n, y, z, bit_next;
+    uint8_t const *const table = comp128_table[level];
+    uint32_t const half = 16U >> level;
+    uint32_t const mask = (512U >> level) - 1U;
+    for (uint32_t block = 0U; block < 32U; block += 2U * half)
+    {
+        for (uint32_t m = block; m < block + half; ++m)
+        {
+            for (uint32_t l = 0U; l < n; ++l)
+            {
+                uint32_t const a = x[l][m];
+                uint32_t const b = x[l][m + half];
+                x[l][m] = table[(a + (2U * b)) & mask];
+                x[l][m + half] = table[((2U * a) + b) & mask];
+            }
+        }
+    }
+}
+
+/**
+ * @brief The COMP128-1 bit permutation. The 32 nibbles of the state are read
+ * as a 128-bit string and bit q of the new RAND half comes from bit 17 * q
+ * mod 128. Since 17 * (8 * j + k) = 8 * (j + 2 * k) + k mod 128, bit k of
+ * output byte j is bit k of input byte (j + 2 * k) mod 16, so the whole
+ * permutation is 8 masked byte rotations of one 128-bit word.
+ * @param[in, out] x State, the last 16 bytes receive the permuted bits.
+ */
+static void comp128_permute(uint8_t x[const 32U])
+{
+    /* Bit 7 of every byte. */
+    unsigned __int128 const mask_bit7 =
+        ((unsigned __int128)0x8080808080808080U << 64U) | 0x8080808080808080U;
 
-    for (uint8_t i = 16U; i < 32U; i++)
+    unsigned __int128 in = 0U;
+    for (uint32_t i = 0U; i < 16U; ++i)
     {
-        x[i] = rand[i - 16U];
+        in = (in << 8U) | (uint32_t)((x[2U * i] << 4U) | x[(2U * i) + 1U]);
     }
 
-    for (uint32_t i = 1U; i < 9U; i++)
+    unsigned __int128 out = in & mask_bit7;
+    for (uint32_t k = 1U; k < 8U; ++k)
+    {
+        unsigned __int128 const bits = in & (mask_bit7 >> k);
+        /* Byte j takes byte j + 2k, i.e. a left rotation by 2k bytes. */
+        out |= (bits << (16U * k)) | (bits >> (128U - (16U * k)));
+    }
+
+    for (uint32_t i = 0U; i < 16U; ++i)
+    {
+        /* Safe cast since only the lowest byte is kept. */
+        x[16U + i] = (uint8_t)(out >> (120U - (8U * i)));
+    }
+}
+
+/**
+ * @brief Run COMP128-1 for up to GSM_ALGO_LANES instances together. This is
+ * always inlined so that the number of instances is a constant and the loops
+ * over the instances get unrolled.
+ * @param[in] ki Key of each instance.
+ * @param[in] rand Challenge of each instance.
+ * @param[out] res Response of each instance.
+ * @param[in] n Number of instances.
+ */
+static inline __attribute__((always_inline)) void comp128_lanes(
+    uint8_t const ki[const][16], uint8_t const rand[const][16],
+    uint8_t res[const][12], uint32_t const n)
+{
+    uint8_t x[GSM_ALGO_LANES][32U];
+    for (uint32_t l = 0U; l < n; ++l)
+    {
+        memcpy(&x[l][16U], rand[l], 16U);
+    }
+
+    for (uint32_t i = 1U; i < 9U; ++i)
     {
         /* Load key into first 16 bytes of input. */
-        for (uint8_t j = 0; j < 16; j++)
+        for (uint32_t l = 0U; l < n; ++l)
         {
-            x[j] = ki[j];
+            memcpy(x[l], ki[l], 16U);
         }
 
         /* Perform substitutions. */
-        for (uint8_t j = 0U; j < 5U; j++)
+        for (uint32_t level = 0U; level < 5U; ++level)
         {
-            for (uint8_t k = 0U; k < (1U << j); k++)
-            {
-                for (uint8_t l = 0U; l < (1U << (4U - j)); l++)
-                {
-                    m = l + k * (1U << (5U - j));
-                    n = m + (1U << (4U - j));
-                    y = (x[m] + 2U * x[n]) % (1U << (9U - j));
-                    z = (2U * x[m] + x[n]) % (1U << (9U - j));
-                    x[m] = comp128_table[j][y];
-                    x[n] = comp128_table[j][z];
-                }
-            }
+            comp128_level(x, n, level);
         }
-        /* Form bits from bytes. */
-        for (uint8_t j = 0U; j < 32U; j++)
+
+        /* Permutation but not on the last loop. */
+        if (i < 8U)
         {
-            for (uint8_t k = 0U; k < 4U; k++)
+            for (uint32_t l = 0U; l < n; ++l)
             {
-                bit[4 * j + k] = (uint8_t)(x[j] >> (3U - k)) & 1U;
+                comp128_permute(x[l]);
             }
         }
-        /* Permutation but not on the last loop. */
-        if (i < 8)
+    }
+
+    for (uint32_t l = 0U; l < n; ++l)
+    {
+        for (uint8_t i = 0U; i < 4U; i++)
         {
-            for (uint8_t j = 0U; j < 16U; j++)
-            {
-                x[j + 16U] = 0U;
-                for (uint8_t k = 0U; k < 8U; k++)
-                {
-                    bit_next = ((8U * j + k) * 17U) % 128U;
-                    x[j + 16U] |= (uint8_t)(bit[bit_next] << (7 - k));
-                }
-            }
+            res[l][i] = (uint8_t)((x[l][2U * i] << 4U) | x[l][2U * i + 1U]);
+        }
+        for (uint8_t i = 0U; i < 6U; i++)
+        {
+            res[l][4 + i] = (uint8_t)((x[l][2U * i + 18U] << 6U) |
+                                      (x[l][2U * i + 18U + 1U] << 2U) |
+                                      (x[l][2U * i + 18U + 2U] >> 2U));
         }
+        res[l][4U + 6U] = (uint8_t)((x[l][2 * 6U + 18U] << 6U) |
+                                    (x[l][2U * 6U + 18U + 1U] << 2U));
+        res[l][4U + 7U] = 0U;
     }
+}
+
+void gsm_algo(uint8_t const ki[const 16], uint8_t const rand[const 16],
+              uint8_t res[const 12])
+{
+    /* Safe casts since each buffer is exactly one array of the batch. */
+    comp128_lanes((uint8_t const(*)[16])ki, (uint8_t const(*)[16])rand,
+                  (uint8_t(*)[12])res, 1U);
+}
 
-    for (uint8_t i = 0U; i < 4U; i++)
+void gsm_algo_batch(uint8_t const ki[const][16], uint8_t const rand[const][16],
+                    uint8_t res[const][12], uint32_t const n)
+{
+    uint32_t base = 0U;
+    for (; n - base >= GSM_ALGO_LANES; base += GSM_ALGO_LANES)
+    {
+        comp128_lanes(&ki[base], &rand[base], &res[base], GSM_ALGO_LANES);
+    }
+    for (; base < n; ++base)
     {
-        res[i] = (uint8_t)((x[2U * i] << 4U) | x[2U * i + 1U]);
+        comp128_lanes(&ki[base], &rand[base], &res[base], 1U);
     }
-    for (uint8_t i = 0U; i < 6U; i++)
+}
+
+int32_t gsm_algo_run(gsm_algo_et const algo, uint8_t const ki[const 16],
+                     uint8_t const rand[const 16], uint8_t res[const 12])
+{
+    switch (algo)
     {
-        res[4 + i] =
-            (uint8_t)((x[2U * i + 18U] << 6U) | (x[2U * i + 18U + 1U] << 2U) |
-                      (x[2U * i + 18U + 2U] >> 2U));
+    case GSM_ALGO_COMP128_1:
+        gsm_algo(ki, rand, res);
+        return 0;
+    case GSM_ALGO_COMP128_2:
+    case GSM_ALGO_COMP128_3:
+    default:
+        return -1;
     }
-    res[4U + 6U] =
-        (uint8_t)((x[2 * 6U + 18U] << 6U) | (x[2U * 6U + 18U + 1U] << 2U));
-    res[4U + 7U] = 0U;
 }
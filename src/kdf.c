@@ -0,0 +1,400 @@
+#include "kdf.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KDF_SHANI 1
+#include <immintrin.h>
+#else
+#define KDF_SHANI 0
+#endif
+
+#define SHA256_BLOCK_LEN 64U
+
+/* Round constants per FIPS 180-4 clause.4.2.2. */
+static uint32_t const sha256_k[64U] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1,
+    0x923F82A4, 0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786,
+    0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147,
+    0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+    0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A,
+    0x5B9CCA4F, 0x682E6FF3, 0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+/* Initial hash value per FIPS 180-4 clause.5.3.3. */
+static uint32_t const sha256_h0[8U] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+/* Running SHA-256 computation. */
+typedef struct sha256_s
+{
+    uint32_t state[8U];
+    uint8_t buf[SHA256_BLOCK_LEN];
+    uint32_t buf_len;
+    uint64_t len; /* Total bytes hashed so far. */
+} sha256_st;
+
+static inline uint32_t rotr32(uint32_t const x, uint32_t const r)
+{
+    return (x >> r) | (x << (32U - r));
+}
+
+/**
+ * @brief Compress blocks into the state per FIPS 180-4 clause.6.2.2.
+ * @param[in, out] state Hash value.
+ * @param[in] block Blocks of 64 bytes.
+ * @param[in] block_count Number of blocks.
+ */
+static void sha256_compress_ref(uint32_t state[const 8U],
+                                uint8_t const *const block,
+                                uint32_t const block_count)
+{
+    for (uint32_t b = 0U; b < block_count; ++b)
+    {
+        uint8_t const *const m = &block[b * SHA256_BLOCK_LEN];
+        uint32_t w[64U];
+        for (uint32_t t = 0U; t < 16U; ++t)
+        {
+            w[t] = ((uint32_t)m[t * 4U] << 24U) |
+                   ((uint32_t)m[(t * 4U) + 1U] << 16U) |
+                   ((uint32_t)m[(t * 4U) + 2U] << 8U) | m[(t * 4U) + 3U];
+        }
+        for (uint32_t t = 16U; t < 64U; ++t)
+        {
+            uint32_t const s0 = rotr32(w[t - 15U], 7U) ^
+                                rotr32(w[t - 15U], 18U) ^ (w[t - 15U] >> 3U);
+            uint32_t const s1 = rotr32(w[t - 2U], 17U) ^
+                                rotr32(w[t - 2U], 19U) ^ (w[t - 2U] >> 10U);
+            w[t] = w[t - 16U] + s0 + w[t - 7U] + s1;
+        }
+
+        uint32_t a = state[0U];
+        uint32_t bb = state[1U];
+        uint32_t c = state[2U];
+        uint32_t d = state[3U];
+        uint32_t e = state[4U];
+        uint32_t f = state[5U];
+        uint32_t g = state[6U];
+        uint32_t h = state[7U];
+        for (uint32_t t = 0U; t < 64U; ++t)
+        {
+            uint32_t const t1 = h +
+                                (rotr32(e, 6U) ^ rotr32(e, 11U) ^
+                                 rotr32(e, 25U)) +
+                                ((e & f) ^ (~e & g)) + sha256_k[t] + w[t];
+            uint32_t const t2 =
+                (rotr32(a, 2U) ^ rotr32(a, 13U) ^ rotr32(a, 22U)) +
+                ((a & bb) ^ (a & c) ^ (bb & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = bb;
+            bb = a;
+            a = t1 + t2;
+        }
+        state[0U] += a;
+        state[1U] += bb;
+        state[2U] += c;
+        state[3U] += d;
+        state[4U] += e;
+        state[5U] += f;
+        state[6U] += g;
+        state[7U] += h;
+    }
+}
+
+#if KDF_SHANI
+/**
+ * @brief Same as sha256_compress_ref but using the SHA extensions. Must only
+ * be called when the CPU supports them.
+ * @param[in, out] state Hash value.
+ * @param[in] block Blocks of 64 bytes.
+ * @param[in] block_count Number of blocks.
+ */
+__attribute__((target("sha,sse4.1"))) static void sha256_compress_shani(
+    uint32_t state[const 8U], uint8_t const *const block,
+    uint32_t const block_count)
+{
+    /* Message words are big-endian. */
+    __m128i const bswap =
+        _mm_set_epi64x(0x0C0D0E0F08090A0B, 0x0405060700010203);
+
+    /* The instructions want the state as ABEF and CDGH. */
+    __m128i tmp = _mm_loadu_si128((__m128i const *)&state[0U]);
+    __m128i state1 = _mm_loadu_si128((__m128i const *)&state[4U]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (uint32_t b = 0U; b < block_count; ++b)
+    {
+        __m128i const abef = state0;
+        __m128i const cdgh = state1;
+        __m128i w[4U];
+        for (uint32_t i = 0U; i < 4U; ++i)
+        {
+            w[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((__m128i const *)&block[(b * 64U) +
+                                                       (i * 16U)]),
+                bswap);
+        }
+
+        /* 4 rounds at a time, the schedule stays 3 groups ahead. */
+        for (uint32_t g = 0U; g < 16U; ++g)
+        {
+            __m128i msg = _mm_add_epi32(
+                w[g % 4U], _mm_loadu_si128((__m128i const *)&sha256_k[g * 4U]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g < 12U)
+            {
+                __m128i const w3 = w[(g + 3U) % 4U];
+                w[g % 4U] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(
+                        _mm_sha256msg1_epu32(w[g % 4U], w[(g + 1U) % 4U]),
+                        _mm_alignr_epi8(w3, w[(g + 2U) % 4U], 4)),
+                    w3);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    /* Back to ABCD and EFGH. */
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)&state[0U], state0);
+    _mm_storeu_si128((__m128i *)&state[4U], state1);
+}
+#endif
+
+/**
+ * Compression backend. The reference implementation is used unless the CPU
+ * has a faster alternative, which is checked once at startup.
+ */
+static void (*sha256_compress_backend)(
+    uint32_t state[const 8U], uint8_t const *const block,
+    uint32_t const block_count) = sha256_compress_ref;
+
+/**
+ * @brief Select the fastest compression backend supported by the CPU (using
+ * CPUID). Runs once before main.
+ */
+__attribute__((constructor)) static void kdf_backend_select(void)
+{
+#if KDF_SHANI
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+    {
+        sha256_compress_backend = sha256_compress_shani;
+    }
+#endif
+}
+
+/**
+ * @brief Continue hashing with more data.
+ * @param[in, out] sha256 Running hash.
+ * @param[in] data
+ * @param[in] data_len Length of the data.
+ */
+static void sha256_update(sha256_st *const sha256, uint8_t const *const data,
+                          uint32_t const data_len)
+{
+    uint32_t pos = 0U;
+    sha256->len += data_len;
+    if (sha256->buf_len > 0U)
+    {
+        uint32_t const fill = SHA256_BLOCK_LEN - sha256->buf_len < data_len
+                                  ? SHA256_BLOCK_LEN - sha256->buf_len
+                                  : data_len;
+        memcpy(&sha256->buf[sha256->buf_len], data, fill);
+        sha256->buf_len += fill;
+        pos += fill;
+        if (sha256->buf_len < SHA256_BLOCK_LEN)
+        {
+            return;
+        }
+        sha256_compress_backend(sha256->state, sha256->buf, 1U);
+        sha256->buf_len = 0U;
+    }
+
+    /* Whole blocks are compressed straight from the input. */
+    uint32_t const block_count = (data_len - pos) / SHA256_BLOCK_LEN;
+    if (block_count > 0U)
+    {
+        sha256_compress_backend(sha256->state, &data[pos], block_count);
+        pos += block_count * SHA256_BLOCK_LEN;
+    }
+    memcpy(sha256->buf, &data[pos], data_len - pos);
+    sha256->buf_len = data_len - pos;
+}
+
+/**
+ * @brief Pad the message per FIPS 180-4 clause.5.1.1 and output the digest.
+ * @param[in, out] sha256 Running hash.
+ * @param[out] digest
+ */
+static void sha256_final(sha256_st *const sha256,
+                         uint8_t digest[const KDF_OUT_LEN])
+{
+    uint64_t const len_bits = sha256->len * 8U;
+    uint8_t pad[SHA256_BLOCK_LEN + 8U] = {0x80};
+    uint32_t const pad_len =
+        (sha256->buf_len < SHA256_BLOCK_LEN - 8U ? SHA256_BLOCK_LEN
+                                                 : SHA256_BLOCK_LEN * 2U) -
+        sha256->buf_len;
+    for (uint32_t i = 0U; i < 8U; ++i)
+    {
+        /* Safe cast since only the lowest byte is kept. */
+        pad[pad_len - 1U - i] = (uint8_t)(len_bits >> (i * 8U));
+    }
+    sha256_update(sha256, pad, pad_len);
+
+    for (uint32_t i = 0U; i < 8U; ++i)
+    {
+        for (uint32_t j = 0U; j < 4U; ++j)
+        {
+            /* Safe cast since only the lowest byte is kept. */
+            digest[(i * 4U) + j] =
+                (uint8_t)(sha256->state[i] >> (24U - (j * 8U)));
+        }
+    }
+}
+
+/**
+ * @brief Start a hash from a state that already absorbed one block.
+ * @param[out] sha256 Running hash.
+ * @param[in] state Hash value after the first block, or the initial hash value
+ * when no block was absorbed.
+ * @param[in] len Number of bytes already absorbed.
+ */
+static void sha256_start(sha256_st *const sha256,
+                         uint32_t const state[const 8U], uint64_t const len)
+{
+    memcpy(sha256->state, state, sizeof(sha256->state));
+    sha256->buf_len = 0U;
+    sha256->len = len;
+}
+
+void kdf_key_set(kdf_key_st *const key, uint8_t const *const k,
+                 uint32_t const k_len)
+{
+    uint8_t k_block[SHA256_BLOCK_LEN] = {0U};
+    if (k_len > SHA256_BLOCK_LEN)
+    {
+        sha256_st sha256;
+        sha256_start(&sha256, sha256_h0, 0U);
+        sha256_update(&sha256, k, k_len);
+        sha256_final(&sha256, k_block);
+    }
+    else
+    {
+        memcpy(k_block, k, k_len);
+    }
+
+    uint8_t pad[SHA256_BLOCK_LEN];
+    for (uint32_t i = 0U; i < SHA256_BLOCK_LEN; ++i)
+    {
+        pad[i] = k_block[i] ^ 0x36;
+    }
+    memcpy(key->inner, sha256_h0, sizeof(key->inner));
+    sha256_compress_backend(key->inner, pad, 1U);
+    for (uint32_t i = 0U; i < SHA256_BLOCK_LEN; ++i)
+    {
+        pad[i] = k_block[i] ^ 0x5C;
+    }
+    memcpy(key->outer, sha256_h0, sizeof(key->outer));
+    sha256_compress_backend(key->outer, pad, 1U);
+}
+
+/**
+ * @brief Finish an HMAC whose inner hash already absorbed the message.
+ * @param[in] key Prepared key.
+ * @param[in, out] inner Inner hash.
+ * @param[out] mac
+ */
+static void hmac_final(kdf_key_st const *const key, sha256_st *const inner,
+                       uint8_t mac[const KDF_OUT_LEN])
+{
+    uint8_t digest[KDF_OUT_LEN];
+    sha256_final(inner, digest);
+    sha256_st outer;
+    sha256_start(&outer, key->outer, SHA256_BLOCK_LEN);
+    sha256_update(&outer, digest, sizeof(digest));
+    sha256_final(&outer, mac);
+}
+
+void kdf_hmac_sha256(kdf_key_st const *const key, uint8_t const *const msg,
+                     uint32_t const msg_len, uint8_t mac[const KDF_OUT_LEN])
+{
+    sha256_st inner;
+    sha256_start(&inner, key->inner, SHA256_BLOCK_LEN);
+    sha256_update(&inner, msg, msg_len);
+    hmac_final(key, &inner, mac);
+}
+
+void kdf(kdf_key_st const *const key, uint8_t const fc,
+         kdf_param_st const param[const], uint32_t const param_count,
+         uint8_t out[const KDF_OUT_LEN])
+{
+    /* S is hashed as it is built so it needs no buffer of its own. */
+    sha256_st inner;
+    sha256_start(&inner, key->inner, SHA256_BLOCK_LEN);
+    sha256_update(&inner, &fc, 1U);
+    for (uint32_t i = 0U; i < param_count; ++i)
+    {
+        /* Safe casts since only the lowest byte of each half is kept. */
+        uint8_t const len[2U] = {(uint8_t)(param[i].len >> 8U),
+                                 (uint8_t)param[i].len};
+        sha256_update(&inner, param[i].buf, param[i].len);
+        sha256_update(&inner, len, sizeof(len));
+    }
+    hmac_final(key, &inner, out);
+}
+
+void kdf_5g_aka(uint8_t const ck[const 16], uint8_t const ik[const 16],
+                uint8_t const *const res, uint8_t const res_len,
+                uint8_t const rand[const 16], uint8_t const sqn_ak[const 6],
+                uint8_t const *const snn, uint8_t const snn_len,
+                kdf_5g_st *const out)
+{
+    uint8_t ck_ik[32U];
+    memcpy(ck_ik, ck, 16U);
+    memcpy(&ck_ik[16U], ik, 16U);
+    kdf_key_st key;
+    kdf_key_set(&key, ck_ik, sizeof(ck_ik));
+
+    uint8_t derived[KDF_OUT_LEN];
+
+    /* RES* is the 128 least significant bits of the output. */
+    kdf_param_st const param_res_star[3U] = {
+        {snn, snn_len},
+        {rand, 16U},
+        {res, res_len},
+    };
+    kdf(&key, 0x6B, param_res_star, 3U, derived);
+    memcpy(out->res_star, &derived[16U], sizeof(out->res_star));
+
+    kdf_param_st const param_sqn[2U] = {
+        {snn, snn_len},
+        {sqn_ak, 6U},
+    };
+    kdf(&key, 0x6A, param_sqn, 2U, out->kausf);
+
+    /* CK' || IK' */
+    kdf(&key, 0x20, param_sqn, 2U, derived);
+    memcpy(out->ck_prime, derived, sizeof(out->ck_prime));
+    memcpy(out->ik_prime, &derived[16U], sizeof(out->ik_prime));
+}
@@ -0,0 +1,256 @@
+#include "keccak.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KECCAK_AVX2 1
+#include <immintrin.h>
+#else
+#define KECCAK_AVX2 0
+#endif
+
+#define KECCAK_ROUNDS 24U
+
+/* Round constants of the iota step per FIPS 202 clause.3.2.5. */
+static uint64_t const keccak_rc[KECCAK_ROUNDS] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A,
+    0x8000000080008000, 0x000000000000808B, 0x0000000080000001,
+    0x8000000080008081, 0x8000000000008009, 0x000000000000008A,
+    0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+    0x000000000000800A, 0x800000008000000A, 0x8000000080008081,
+    0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+};
+
+/**
+ * @brief Rotate a lane to the left.
+ * @param[in] x Lane to rotate.
+ * @param[in] r Number of bits to rotate by (1 to 63).
+ * @return Rotated lane.
+ */
+static inline uint64_t rotl64(uint64_t const x, uint32_t const r)
+{
+    return (x << r) | (x >> (64U - r));
+}
+
+/* Lane operations of the scalar permutation. */
+#define KECCAK_XOR(a, b) ((a) ^ (b))
+#define KECCAK_ANDN(a, b) (~(a) & (b))
+
+/**
+ * One round of Keccak-f[1600] from lanes s_ into lanes d_ per FIPS 202
+ * clause.3.3, fully unrolled so all lanes can stay in registers. The lane
+ * operations are given as macros so the scalar and the AVX2 permutations share
+ * the same round. Lanes b_ and c_ are temporaries.
+ */
+#define KECCAK_ROUND(xor_, rotl_, andn_, s_, d_, b_, c_, rc_)                  \
+    do                                                                         \
+    {                                                                          \
+        c_[0] = xor_(xor_(xor_(s_[0], s_[5]), xor_(s_[10], s_[15])), s_[20]);  \
+        c_[1] = xor_(xor_(xor_(s_[1], s_[6]), xor_(s_[11], s_[16])), s_[21]);  \
+        c_[2] = xor_(xor_(xor_(s_[2], s_[7]), xor_(s_[12], s_[17])), s_[22]);  \
+        c_[3] = xor_(xor_(xor_(s_[3], s_[8]), xor_(s_[13], s_[18])), s_[23]);  \
+        c_[4] = xor_(xor_(xor_(s_[4], s_[9]), xor_(s_[14], s_[19])), s_[24]);  \
+        c_[5] = xor_(c_[4], rotl_(c_[1], 1));                                  \
+        c_[6] = xor_(c_[0], rotl_(c_[2], 1));                                  \
+        c_[7] = xor_(c_[1], rotl_(c_[3], 1));                                  \
+        c_[8] = xor_(c_[2], rotl_(c_[4], 1));                                  \
+        c_[9] = xor_(c_[3], rotl_(c_[0], 1));                                  \
+        b_[0] = xor_(s_[0], c_[5]);                                            \
+        b_[1] = rotl_(xor_(s_[6], c_[6]), 44);                                 \
+        b_[2] = rotl_(xor_(s_[12], c_[7]), 43);                                \
+        b_[3] = rotl_(xor_(s_[18], c_[8]), 21);                                \
+        b_[4] = rotl_(xor_(s_[24], c_[9]), 14);                                \
+        d_[0] = xor_(xor_(b_[0], andn_(b_[1], b_[2])), rc_);                   \
+        d_[1] = xor_(b_[1], andn_(b_[2], b_[3]));                              \
+        d_[2] = xor_(b_[2], andn_(b_[3], b_[4]));                              \
+        d_[3] = xor_(b_[3], andn_(b_[4], b_[0]));                              \
+        d_[4] = xor_(b_[4], andn_(b_[0], b_[1]));                              \
+        b_[0] = rotl_(xor_(s_[3], c_[8]), 28);                                 \
+        b_[1] = rotl_(xor_(s_[9], c_[9]), 20);                                 \
+        b_[2] = rotl_(xor_(s_[10], c_[5]), 3);                                 \
+        b_[3] = rotl_(xor_(s_[16], c_[6]), 45);                                \
+        b_[4] = rotl_(xor_(s_[22], c_[7]), 61);                                \
+        d_[5] = xor_(b_[0], andn_(b_[1], b_[2]));                              \
+        d_[6] = xor_(b_[1], andn_(b_[2], b_[3]));                              \
+        d_[7] = xor_(b_[2], andn_(b_[3], b_[4]));                              \
+        d_[8] = xor_(b_[3], andn_(b_[4], b_[0]));                              \
+        d_[9] = xor_(b_[4], andn_(b_[0], b_[1]));                              \
+        b_[0] = rotl_(xor_(s_[1], c_[6]), 1);                                  \
+        b_[1] = rotl_(xor_(s_[7], c_[7]), 6);                                  \
+        b_[2] = rotl_(xor_(s_[13], c_[8]), 25);                                \
+        b_[3] = rotl_(xor_(s_[19], c_[9]), 8);                                 \
+        b_[4] = rotl_(xor_(s_[20], c_[5]), 18);                                \
+        d_[10] = xor_(b_[0], andn_(b_[1], b_[2]));                             \
+        d_[11] = xor_(b_[1], andn_(b_[2], b_[3]));                             \
+        d_[12] = xor_(b_[2], andn_(b_[3], b_[4]));                             \
+        d_[13] = xor_(b_[3], andn_(b_[4], b_[0]));                             \
+        d_[14] = xor_(b_[4], andn_(b_[0], b_[1]));                             \
+        b_[0] = rotl_(xor_(s_[4], c_[9]), 27);                                 \
+        b_[1] = rotl_(xor_(s_[5], c_[5]), 36);                                 \
+        b_[2] = rotl_(xor_(s_[11], c_[6]), 10);                                \
+        b_[3] = rotl_(xor_(s_[17], c_[7]), 15);                                \
+        b_[4] = rotl_(xor_(s_[23], c_[8]), 56);                                \
+        d_[15] = xor_(b_[0], andn_(b_[1], b_[2]));                             \
+        d_[16] = xor_(b_[1], andn_(b_[2], b_[3]));                             \
+        d_[17] = xor_(b_[2], andn_(b_[3], b_[4]));                             \
+        d_[18] = xor_(b_[3], andn_(b_[4], b_[0]));                             \
+        d_[19] = xor_(b_[4], andn_(b_[0], b_[1]));                             \
+        b_[0] = rotl_(xor_(s_[2], c_[7]), 62);                                 \
+        b_[1] = rotl_(xor_(s_[8], c_[8]), 55);                                 \
+        b_[2] = rotl_(xor_(s_[14], c_[9]), 39);                                \
+        b_[3] = rotl_(xor_(s_[15], c_[5]), 41);                                \
+        b_[4] = rotl_(xor_(s_[21], c_[6]), 2);                                 \
+        d_[20] = xor_(b_[0], andn_(b_[1], b_[2]));                             \
+        d_[21] = xor_(b_[1], andn_(b_[2], b_[3]));                             \
+        d_[22] = xor_(b_[2], andn_(b_[3], b_[4]));                             \
+        d_[23] = xor_(b_[3], andn_(b_[4], b_[0]));                             \
+        d_[24] = xor_(b_[4], andn_(b_[0], b_[1]));                             \
+    } while (0)
+
+/**
+ * @brief Scalar Keccak-f[1600].
+ * @param[in, out] state State to permute.
+ */
+static void keccak_f1600_ref(uint64_t state[const KECCAK_STATE_LANES])
+{
+    uint64_t a[KECCAK_STATE_LANES];
+    uint64_t e[KECCAK_STATE_LANES];
+    uint64_t b[5U];
+    uint64_t c[10U];
+    memcpy(a, state, sizeof(a));
+    /* Two rounds per iteration, the lanes go back and forth between a and e. */
+    for (uint32_t round = 0U; round < KECCAK_ROUNDS; round += 2U)
+    {
+        KECCAK_ROUND(KECCAK_XOR, rotl64, KECCAK_ANDN, a, e, b, c,
+                     keccak_rc[round]);
+        KECCAK_ROUND(KECCAK_XOR, rotl64, KECCAK_ANDN, e, a, b, c,
+                     keccak_rc[round + 1U]);
+    }
+    memcpy(state, a, sizeof(a));
+}
+
+/**
+ * @brief Apply the scalar permutation to each state.
+ * @param[in, out] state States to permute.
+ * @param[in] n Number of states.
+ */
+static void keccak_f1600_xN_ref(uint64_t state[const][KECCAK_STATE_LANES],
+                                uint32_t const n)
+{
+    for (uint32_t i = 0U; i < n; ++i)
+    {
+        keccak_f1600_ref(state[i]);
+    }
+}
+
+#if KECCAK_AVX2
+/* Rotate the 4 lanes in a register to the left by a constant r (1 to 63). */
+#define KECCAK_ROTL_X4(x, r)                                                   \
+    _mm256_or_si256(_mm256_slli_epi64((x), (r)),                               \
+                    _mm256_srli_epi64((x), 64 - (r)))
+
+/**
+ * @brief Keccak-f[1600] on 4 states at once, lane i of every state is in one
+ * 256-bit register. Must only be called when the CPU supports AVX2.
+ * @param[in, out] state States to permute.
+ */
+__attribute__((target("avx2"))) static void keccak_f1600_x4_avx2(
+    uint64_t state[const 4U][KECCAK_STATE_LANES])
+{
+    __m256i a[KECCAK_STATE_LANES];
+    __m256i e[KECCAK_STATE_LANES];
+    __m256i b[5U];
+    __m256i c[10U];
+    for (uint32_t i = 0U; i < KECCAK_STATE_LANES; ++i)
+    {
+        /* Safe casts since the lanes are only moved around. */
+        a[i] = _mm256_set_epi64x((long long)state[3U][i],
+                                 (long long)state[2U][i],
+                                 (long long)state[1U][i],
+                                 (long long)state[0U][i]);
+    }
+
+    for (uint32_t round = 0U; round < KECCAK_ROUNDS; round += 2U)
+    {
+        /* Safe casts since the constants are only moved around. */
+        KECCAK_ROUND(_mm256_xor_si256, KECCAK_ROTL_X4, _mm256_andnot_si256, a,
+                     e, b, c, _mm256_set1_epi64x((long long)keccak_rc[round]));
+        KECCAK_ROUND(
+            _mm256_xor_si256, KECCAK_ROTL_X4, _mm256_andnot_si256, e, a, b, c,
+            _mm256_set1_epi64x((long long)keccak_rc[round + 1U]));
+    }
+
+    for (uint32_t i = 0U; i < KECCAK_STATE_LANES; ++i)
+    {
+        uint64_t lanes[4U];
+        _mm256_storeu_si256((__m256i *)lanes, a[i]);
+        for (uint32_t s = 0U; s < 4U; ++s)
+        {
+            state[s][i] = lanes[s];
+        }
+    }
+}
+
+/**
+ * @brief Apply the permutation to groups of 4 states with AVX2. A last group of
+ * 2 or 3 states is padded to 4 since that is still faster than permuting them
+ * one by one. Must only be called when the CPU supports AVX2.
+ * @param[in, out] state States to permute.
+ * @param[in] n Number of states.
+ */
+static void keccak_f1600_xN_avx2(uint64_t state[const][KECCAK_STATE_LANES],
+                                 uint32_t const n)
+{
+    uint32_t i = 0U;
+    for (; i + 4U <= n; i += 4U)
+    {
+        keccak_f1600_x4_avx2(&state[i]);
+    }
+    if (n - i >= 2U)
+    {
+        uint64_t group[4U][KECCAK_STATE_LANES] = {{0U}};
+        memcpy(group, &state[i], (n - i) * sizeof(group[0U]));
+        keccak_f1600_x4_avx2(group);
+        memcpy(&state[i], group, (n - i) * sizeof(group[0U]));
+    }
+    else
+    {
+        keccak_f1600_xN_ref(&state[i], n - i);
+    }
+}
+#endif
+
+/**
+ * Multi-state backend. The scalar permutation is used unless the CPU has a
+ * faster alternative, which is checked once at startup.
+ */
+static void (*keccak_f1600_xN_backend)(
+    uint64_t state[const][KECCAK_STATE_LANES],
+    uint32_t const n) = keccak_f1600_xN_ref;
+
+/**
+ * @brief Select the fastest multi-state backend supported by the CPU (using
+ * CPUID). Runs once before main.
+ */
+__attribute__((constructor)) static void keccak_backend_select(void)
+{
+#if KECCAK_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        keccak_f1600_xN_backend = keccak_f1600_xN_avx2;
+    }
+#endif
+}
+
+void keccak_f1600(uint64_t state[const KECCAK_STATE_LANES])
+{
+    keccak_f1600_ref(state);
+}
+
+void keccak_f1600_xN(uint64_t state[const][KECCAK_STATE_LANES],
+                     uint32_t const n)
+{
+    keccak_f1600_xN_backend(state, n);
+}
@@ -0,0 +1,210 @@
+#include "log.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/* How long the background thread sleeps when all logs are empty. */
+#define LOG_THREAD_IDLE_NS 5000000L
+
+static pthread_mutex_t log_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_st *log_registry = NULL;
+/* Serializes starting and stopping the background thread. */
+static pthread_mutex_t log_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t log_thread;
+static bool log_thread_running = false;
+static atomic_bool log_thread_stop_req = false;
+
+/**
+ * @brief Format one record.
+ * @param[in] rcrd Record to format.
+ * @param[in] out Where to write the formatted record.
+ */
+static void log_rcrd_print(log_rcrd_st const *const rcrd, FILE *const out)
+{
+    /**
+     * The format string is not a literal here, but the LOG macros require all
+     * conversions to consume a uint64_t so passing all arguments is safe.
+     */
+    fprintf(out, rcrd->fmt, rcrd->arg[0U], rcrd->arg[1U], rcrd->arg[2U],
+            rcrd->arg[3U], rcrd->arg[4U], rcrd->arg[5U]);
+    if (rcrd->hex_redacted)
+    {
+        fprintf(out, "<redacted>");
+    }
+    else
+    {
+        for (uint8_t i = 0U; i < rcrd->hex_len; ++i)
+        {
+            fprintf(out, "%02X", rcrd->hex[i]);
+        }
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * @brief Background thread that drains all registered logs until it is asked
+ * to stop and there is nothing left to drain.
+ */
+static void *log_thread_main(__attribute__((unused)) void *const arg)
+{
+    static struct timespec const idle = {.tv_sec = 0,
+                                         .tv_nsec = LOG_THREAD_IDLE_NS};
+    while (1)
+    {
+        /* Read the request before draining so no record gets left behind. */
+        bool const stop = atomic_load(&log_thread_stop_req);
+        uint32_t count = 0U;
+
+        pthread_mutex_lock(&log_registry_mutex);
+        for (log_st *log = log_registry; log != NULL; log = log->next)
+        {
+            count += log_drain(log, stderr);
+        }
+        pthread_mutex_unlock(&log_registry_mutex);
+
+        if (count > 0U)
+        {
+            fflush(stderr);
+        }
+        else if (stop)
+        {
+            break;
+        }
+        else
+        {
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+void log_init(log_st *const log, log_lvl_et const lvl, bool const secret)
+{
+    memset(log, 0U, sizeof(*log));
+    atomic_init(&log->head, 0U);
+    atomic_init(&log->tail, 0U);
+    atomic_init(&log->dropped, 0U);
+    log->lvl = lvl;
+    log->secret = secret;
+    log->next = NULL;
+}
+
+void log_rcrd(log_st *const log, char const *const fmt,
+              uint64_t const arg[const LOG_ARG_MAX], bool const secret,
+              uint8_t const *const hex, uint32_t const hex_len)
+{
+    _Static_assert((LOG_RING_LEN & (LOG_RING_LEN - 1U)) == 0U,
+                   "Log ring length must be a power of 2.");
+
+    uint32_t const head =
+        atomic_load_explicit(&log->head, memory_order_relaxed);
+    uint32_t const tail =
+        atomic_load_explicit(&log->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_LEN)
+    {
+        atomic_fetch_add_explicit(&log->dropped, 1U, memory_order_relaxed);
+        return;
+    }
+
+    log_rcrd_st *const rcrd = &log->rcrd[head & (LOG_RING_LEN - 1U)];
+    rcrd->fmt = fmt;
+    memcpy(rcrd->arg, arg, sizeof(rcrd->arg));
+    rcrd->hex_redacted = false;
+    rcrd->hex_len = 0U;
+    if (hex != NULL)
+    {
+        if (secret && !log->secret)
+        {
+            rcrd->hex_redacted = true;
+        }
+        else
+        {
+            /* Safe cast since the length is limited to LOG_HEX_MAX. */
+            rcrd->hex_len =
+                (uint8_t)(hex_len > LOG_HEX_MAX ? LOG_HEX_MAX : hex_len);
+            memcpy(rcrd->hex, hex, rcrd->hex_len);
+        }
+    }
+
+    atomic_store_explicit(&log->head, head + 1U, memory_order_release);
+}
+
+uint32_t log_drain(log_st *const log, FILE *const out)
+{
+    uint32_t const head =
+        atomic_load_explicit(&log->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+    uint32_t count = 0U;
+
+    for (; tail != head; ++tail, ++count)
+    {
+        log_rcrd_print(&log->rcrd[tail & (LOG_RING_LEN - 1U)], out);
+        atomic_store_explicit(&log->tail, tail + 1U, memory_order_release);
+    }
+
+    uint32_t const dropped =
+        atomic_exchange_explicit(&log->dropped, 0U, memory_order_relaxed);
+    if (dropped > 0U)
+    {
+        fprintf(out, "Log: dropped %u records.\n", dropped);
+    }
+    return count;
+}
+
+void log_register(log_st *const log)
+{
+    pthread_mutex_lock(&log_registry_mutex);
+    log->next = log_registry;
+    log_registry = log;
+    pthread_mutex_unlock(&log_registry_mutex);
+}
+
+void log_unregister(log_st *const log)
+{
+    pthread_mutex_lock(&log_registry_mutex);
+    for (log_st **link = &log_registry; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == log)
+        {
+            *link = log->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&log_registry_mutex);
+
+    /* The background thread no longer sees this log so it's safe to drain. */
+    log->next = NULL;
+    log_drain(log, stderr);
+}
+
+int32_t log_thread_start(void)
+{
+    int32_t ret = 0;
+    pthread_mutex_lock(&log_thread_mutex);
+    if (!log_thread_running)
+    {
+        atomic_store(&log_thread_stop_req, false);
+        if (pthread_create(&log_thread, NULL, log_thread_main, NULL) == 0)
+        {
+            log_thread_running = true;
+        }
+        else
+        {
+            ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&log_thread_mutex);
+    return ret;
+}
+
+void log_thread_stop(void)
+{
+    pthread_mutex_lock(&log_thread_mutex);
+    if (log_thread_running)
+    {
+        atomic_store(&log_thread_stop_req, true);
+        pthread_join(log_thread, NULL);
+        log_thread_running = false;
+    }
+    pthread_mutex_unlock(&log_thread_mutex);
+}
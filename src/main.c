@@ -1,3 +1,6 @@
+/* Needed for the CPU affinity of threads. */
+#define _GNU_SOURCE
+
 /* Use color in the help commands no matter what. */
 #ifndef DEBUG_CLR
 #define DEBUG_CLR
@@ -6,21 +9,356 @@
 #define SERVER_IP_DEF "127.0.0.1"
 #define SERVER_PORT_DEF "37324"
 
+#include "log.h"
+#include "manifest.h"
 #include "pin.h"
 #include "swsim.h"
 #include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <swicc/swicc.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Instances are limited to keep thread and memory use reasonable. */
+#define INSTANCE_COUNT_MAX 4096U
+
+/* Instances initialized by a thread of the init pool per take. */
+#define INSTANCE_INIT_CHUNK 8U
+
+/* Configuration shared by all instances. */
+typedef struct instance_cfg_s
+{
+    char const *server_ip;
+    char const *server_port;
+    char const *path_swiccfs;
+    char const *path_fsjson_load;
+    log_lvl_et log_lvl;
+    bool log_secret;
+    milenage_algo_et auth_algo;
+    char const *snn;
+    bool rsp_direct;
+    manifest_sub_st const *sub_arr; /* One per instance, or NULL. */
+} instance_cfg_st;
+
+typedef struct host_s host_st;
 
-swicc_net_client_st client_ctx = {0U};
+/* One simulated card with its own state and connection to the server. */
+typedef struct instance_s
+{
+    swsim_st swsim_state;
+    swicc_st swicc_state;
+    swicc_net_client_st client_ctx;
+    atomic_bool done; /* Set when the thread is about to return. */
+    instance_cfg_st const *cfg;
+    host_st *host;
+    uint32_t idx;
+    bool init_done;
+    pthread_t thread;
+    swicc_ret_et ret;
+} instance_st;
+
+/**
+ * Instances are initialized in parallel (loading the FS and expanding keys
+ * takes a while for thousands of them). Every thread takes the next chunk of
+ * instances until none are left, so faster threads take over the work that
+ * slower ones did not get to.
+ */
+typedef struct instance_init_pool_s
+{
+    instance_st *instance_arr;
+    uint32_t instance_count;
+    atomic_uint_fast32_t instance_next;
+    atomic_bool failed;
+} instance_init_pool_st;
+
+/* All instances of this process, each one runs on a thread of its own. */
+struct host_s
+{
+    instance_st *instance_arr;
+    uint32_t instance_count;
+    /**
+     * Card image to save on exit, it holds state like the SQN array. It is
+     * only saved with a single instance since all instances start from the
+     * same image.
+     */
+    swicc_st *image_swicc_state;
+    char const *image_path;
+
+    /**
+     * The main thread waits for SIGINT or SIGTERM with sigwait, the last
+     * instance to finish sends it SIGTERM.
+     */
+    pthread_t thread_main;
+    atomic_uint_fast32_t run_left; /* Instances still running. */
+    atomic_bool stop;              /* Set once the instances have to stop. */
+};
+
+/**
+ * Signal handlers get no context so this is how they reach the running host.
+ * Apart from the log thread, it is the only process-wide state of swSIM.
+ */
+static host_st *host_sig = NULL;
+
+static void image_save(host_st const *const host)
+{
+    if (host->image_swicc_state != NULL &&
+        swicc_disk_save(&host->image_swicc_state->fs.disk, host->image_path) !=
+            SWICC_RET_SUCCESS)
+    {
+        fprintf(stderr, "Failed to save the swICC FS file.\n");
+    }
+}
+
+/* Report how often AUTHENTICATE was answered from the response cache. */
+static void auth_cache_print(host_st const *const host)
+{
+    if (host->instance_count == 0U)
+    {
+        return;
+    }
+    uint64_t hit = 0U;
+    uint64_t miss = 0U;
+    for (uint32_t i = 0U; i < host->instance_count; ++i)
+    {
+        hit += host->instance_arr[i].swsim_state.milenage.cache.hit;
+        miss += host->instance_arr[i].swsim_state.milenage.cache.miss;
+    }
+    fprintf(stderr,
+            "AUTHENTICATE cache: %" PRIu64 " hits, %" PRIu64 " misses.\n",
+            hit, miss);
+}
+
+/* Toggle the direct response mode to compare the latency of both modes. */
+static void sig_rsp_direct_handler(__attribute__((unused)) int signum)
+{
+    host_st const *const host = host_sig;
+    for (uint32_t i = 0U; host != NULL && i < host->instance_count; ++i)
+    {
+        swsim_st *const swsim_state = &host->instance_arr[i].swsim_state;
+        atomic_store(&swsim_state->rsp_direct,
+                     !atomic_load(&swsim_state->rsp_direct));
+    }
+}
+
+/**
+ * Does nothing, it is only there so that SIGUSR2 interrupts the blocking calls
+ * of an instance thread instead of terminating the process.
+ */
+static void sig_wake_handler(__attribute__((unused)) int signum)
+{
+}
+
+/**
+ * @brief Make the running instances of a host return and join their threads.
+ * A thread blocked waiting for the server gets interrupted by SIGUSR2, which is
+ * sent again until the thread returns since it may arrive in the middle of a
+ * command. That command is finished first, so the card image is consistent
+ * once all threads are joined.
+ * @param[in, out] host
+ * @param[in] run_count Number of instance threads that were started.
+ */
+static void host_stop(host_st *const host, uint32_t const run_count)
+{
+    atomic_store(&host->stop, true);
+    struct timespec const wait = {.tv_nsec = 10000000};
+    for (uint32_t i = 0U; i < run_count; ++i)
+    {
+        instance_st *const instance = &host->instance_arr[i];
+        while (!atomic_load(&instance->done))
+        {
+            pthread_kill(instance->thread, SIGUSR2);
+            nanosleep(&wait, NULL);
+        }
+        pthread_join(instance->thread, NULL);
+    }
+}
 
-static void sig_exit_handler(__attribute__((unused)) int signum)
+/**
+ * @brief Initialize an instance.
+ * @param[in, out] instance Its config and index must already be set.
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t instance_init(instance_st *const instance)
 {
-    fprintf(stderr, "Shutting down...\n");
-    swicc_net_client_destroy(&client_ctx);
-    fflush(NULL);
-    exit(0);
+    instance_cfg_st const *const cfg = instance->cfg;
+    /**
+     * The first instance generates the swICC FS file (if asked to) before the
+     * others get to load it.
+     */
+    if (swsim_init(&instance->swsim_state, &instance->swicc_state,
+                   instance->idx == 0U ? cfg->path_fsjson_load : NULL,
+                   cfg->path_swiccfs) != 0)
+    {
+        return -1;
+    }
+    swsim_st *const swsim_state = &instance->swsim_state;
+    swsim_state->proactive.app_default_enable = true;
+    swsim_state->log.lvl = cfg->log_lvl;
+    swsim_state->log.secret = cfg->log_secret;
+    swsim_state->milenage.algo = cfg->auth_algo;
+    atomic_init(&swsim_state->rsp_direct, cfg->rsp_direct);
+    if (cfg->snn != NULL)
+    {
+        /* Safe cast since the length was checked when parsing. */
+        swsim_state->milenage.snn_len = (uint8_t)strlen(cfg->snn);
+        memcpy(swsim_state->milenage.snn, cfg->snn,
+               swsim_state->milenage.snn_len);
+    }
+    if (cfg->sub_arr != NULL &&
+        manifest_apply(&cfg->sub_arr[instance->idx], swsim_state,
+                       &instance->swicc_state) != 0)
+    {
+        fprintf(stderr,
+                "Failed to apply the manifest to instance %" PRIu32 ".\n",
+                instance->idx);
+        swicc_terminate(&instance->swicc_state);
+        return -1;
+    }
+    log_register(&swsim_state->log);
+    instance->init_done = true;
+    return 0;
+}
+
+/**
+ * @brief Initialize chunks of instances until there are none left.
+ * @param[in, out] arg The init pool.
+ * @return NULL.
+ */
+static void *instance_init_run(void *const arg)
+{
+    instance_init_pool_st *const pool = arg;
+    while (!atomic_load_explicit(&pool->failed, memory_order_relaxed))
+    {
+        uint32_t const first = (uint32_t)atomic_fetch_add_explicit(
+            &pool->instance_next, INSTANCE_INIT_CHUNK, memory_order_relaxed);
+        if (first >= pool->instance_count)
+        {
+            break;
+        }
+        uint32_t const last = first + INSTANCE_INIT_CHUNK < pool->instance_count
+                                  ? first + INSTANCE_INIT_CHUNK
+                                  : pool->instance_count;
+        for (uint32_t i = first; i < last; ++i)
+        {
+            if (instance_init(&pool->instance_arr[i]) != 0)
+            {
+                atomic_store_explicit(&pool->failed, true,
+                                      memory_order_relaxed);
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Initialize all instances. The first one is done alone since it may
+ * generate the FS file that the others load, the rest are done by a pool of one
+ * thread per CPU.
+ * @param[in, out] instance_all
+ * @param[in] count
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t instance_init_all(instance_st *const instance_all,
+                                 uint32_t const count)
+{
+    if (instance_init(&instance_all[0U]) != 0)
+    {
+        return -1;
+    }
+
+    instance_init_pool_st pool = {
+        .instance_arr = instance_all,
+        .instance_count = count,
+    };
+    atomic_init(&pool.instance_next, 1U);
+    atomic_init(&pool.failed, false);
+
+    long const cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t thread_max = cpu_count > 0 ? (uint32_t)cpu_count : 1U;
+    uint32_t const chunk_count =
+        (count - 1U + INSTANCE_INIT_CHUNK - 1U) / INSTANCE_INIT_CHUNK;
+    thread_max = thread_max < chunk_count ? thread_max : chunk_count;
+
+    /* The main thread takes part in the pool too. */
+    pthread_t thread[thread_max > 1U ? thread_max - 1U : 1U];
+    uint32_t thread_count = 0U;
+    for (; thread_count + 1U < thread_max; ++thread_count)
+    {
+        if (pthread_create(&thread[thread_count], NULL, instance_init_run,
+                           &pool) != 0)
+        {
+            break;
+        }
+    }
+    instance_init_run(&pool);
+    for (uint32_t i = 0U; i < thread_count; ++i)
+    {
+        pthread_join(thread[i], NULL);
+    }
+    return atomic_load(&pool.failed) ? -1 : 0;
+}
+
+/**
+ * @brief Connect an instance to the server and run it until it disconnects.
+ * @param[in, out] arg The instance.
+ * @return NULL.
+ */
+static void *instance_run(void *const arg)
+{
+    instance_st *const instance = arg;
+    host_st *const host = instance->host;
+    instance->ret =
+        swicc_net_client_create(&instance->client_ctx, instance->cfg->server_ip,
+                                instance->cfg->server_port);
+    if (instance->ret != SWICC_RET_SUCCESS)
+    {
+        if (!atomic_load(&host->stop))
+        {
+            fprintf(stderr,
+                    "Instance %" PRIu32 ": failed to create a client.\n",
+                    instance->idx);
+        }
+    }
+    else
+    {
+        /* The host may have stopped while the client was being created. */
+        if (!atomic_load(&host->stop))
+        {
+            instance->ret =
+                swicc_net_client(&instance->swicc_state, &instance->client_ctx);
+        }
+        /* Errors are expected once the host interrupted the client to stop. */
+        bool const stopped = atomic_load(&host->stop);
+        if (!stopped && instance->ret == SWICC_RET_NET_DISCONNECTED)
+        {
+            fprintf(stderr,
+                    "Instance %" PRIu32
+                    ": client was disconnected from server.\n",
+                    instance->idx);
+        }
+        else if (!stopped && instance->ret != SWICC_RET_SUCCESS)
+        {
+            fprintf(stderr,
+                    "Instance %" PRIu32 ": failed to run network client.\n",
+                    instance->idx);
+        }
+        swicc_net_client_destroy(&instance->client_ctx);
+    }
+
+    /* The last instance to return wakes up the main thread. */
+    if (atomic_fetch_sub(&host->run_left, 1U) == 1U)
+    {
+        pthread_kill(host->thread_main, SIGTERM);
+    }
+    atomic_store(&instance->done, true);
+    return NULL;
 }
 
 static void print_usage(char const *const arg0)
@@ -33,12 +371,28 @@ static void print_usage(char const *const arg0)
         "\n<"CLR_KND("--port")" "CLR_VAL("port")" | "CLR_KND("-p")" "CLR_VAL("port")">"
         "\n<"CLR_KND("--fs")" "CLR_VAL("path")" | "CLR_KND("-f")" "CLR_VAL("path")">"
         "\n["CLR_KND("--fs-gen")" "CLR_VAL("path")" | "CLR_KND("-g")" "CLR_VAL("path")"]"
+        "\n["CLR_KND("--log-level")" "CLR_VAL("level")" | "CLR_KND("-l")" "CLR_VAL("level")"]"
+        "\n["CLR_KND("--log-secret")" | "CLR_KND("-s")"]"
+        "\n["CLR_KND("--auth-algo")" "CLR_VAL("algo")" | "CLR_KND("-a")" "CLR_VAL("algo")"]"
+        "\n["CLR_KND("--snn")" "CLR_VAL("name")" | "CLR_KND("-n")" "CLR_VAL("name")"]"
+        "\n["CLR_KND("--rsp-direct")" | "CLR_KND("-d")"]"
+        "\n["CLR_KND("--instances")" "CLR_VAL("count")" | "CLR_KND("-N")" "CLR_VAL("count")"]"
+        "\n["CLR_KND("--manifest")" "CLR_VAL("path")" | "CLR_KND("-m")" "CLR_VAL("path")"]"
+        "\n["CLR_KND("--pin")" | "CLR_KND("-P")"]"
         "\n"
         "\n- IP and port form the address of the server that swSIM will connect to (by default "CLR_TXT(CLR_YEL, SERVER_IP_DEF":"SERVER_PORT_DEF)")."
-        "\n- FS path is a location for loading and saving the swICC FS file."
+        "\n- FS path is a location for loading and saving the swICC FS file. It is saved again on exit to keep the card state (e.g. the SQN array)."
         "\n- FS gen path is the JSON FS definition location for generating a swICC FS file."
         "\n- Note that if the FS gen path is given, the swICC FS file at the given path will be overwritten with the generated one."
         "\n- The file extension for swICC FS files is '.swiccfs'."
+        "\n- Log level is 0 (none), 1 (error), 2 (warning), 3 (info, default), or 4 (debug). Debug traces are only compiled into debug builds."
+        "\n- Log secret enables hex dumps of key material in the log."
+        "\n- Auth algo is 'milenage' (default), 'tuak', or 'xor', it selects the algorithm used by AUTHENTICATE. The 'xor' algorithm of the test USIM is only for signalling load tests."
+        "\n- SNN is the serving network name (e.g. '5G:mnc001.mcc001.3gppnetwork.org'). When given, the 5G AKA keys (RES*, Kausf, CK', IK') derived from every successful authentication are written to the log."
+        "\n- Rsp direct makes SELECT, AUTHENTICATE, and RUN GSM ALGORITHM return their response right away with 9000 instead of 61XX/9FXX and a GET RESPONSE. This is not allowed by T=0 so it is only for transports that pass responses on as is. Sending SIGUSR1 toggles the mode at runtime."
+        "\n- Instances is the number of cards simulated by this process (1 by default, or one per manifest line when a manifest is given). Each one has its own state and connection to the server and runs on its own thread. With more than one instance the swICC FS file is not saved on exit."
+        "\n- Manifest path is a file with one subscriber per instance in the key file format of auc-gen: '<IMSI> <K> [<OPc> [<SQN>]]'. The IMSI, K, and OPc of each instance are overridden with the ones of its line. For TUAK, K can have 64 hex digits (256 bits) and the line can end with 'top=<hex>' to set TOP or 'topc=<hex>' to set TOPc, both 64 hex digits."
+        "\n- Pin shards the instances across the online CPUs by pinning the thread of instance i to CPU (i mod CPU count). This keeps an authentication burst of all instances spread evenly over the cores."
         "\n",
         arg0);
     // clang-format on
@@ -59,6 +413,14 @@ int32_t main(int32_t const argc, char *const argv[argc])
         {"port", required_argument, 0, 'p'},
         {"fs", required_argument, 0, 'f'},
         {"fs-gen", required_argument, 0, 'g'},
+        {"log-level", required_argument, 0, 'l'},
+        {"log-secret", no_argument, 0, 's'},
+        {"auth-algo", required_argument, 0, 'a'},
+        {"snn", required_argument, 0, 'n'},
+        {"rsp-direct", no_argument, 0, 'd'},
+        {"instances", required_argument, 0, 'N'},
+        {"manifest", required_argument, 0, 'm'},
+        {"pin", no_argument, 0, 'P'},
         {0, 0, 0, 0},
     };
 
@@ -66,12 +428,21 @@ int32_t main(int32_t const argc, char *const argv[argc])
     char const *server_port = NULL;
     char const *path_swiccfs = NULL;
     char const *path_fsjson_load = NULL;
+    log_lvl_et log_lvl = LOG_LVL_INF;
+    bool log_secret = false;
+    milenage_algo_et auth_algo = MILENAGE_ALGO_MILENAGE;
+    char const *snn = NULL;
+    bool rsp_direct = false;
+    uint32_t count = 0U;
+    char const *path_manifest = NULL;
+    bool pin = false;
 
     int32_t ch;
     while (1)
     {
         int32_t opt_idx = 0;
-        ch = getopt_long(argc, argv, "hvi:p:f:g:", options_long, &opt_idx);
+        ch = getopt_long(argc, argv, "hvi:p:f:g:l:sa:n:dN:m:P", options_long,
+                         &opt_idx);
         if (ch == -1)
         {
             break;
@@ -97,6 +468,76 @@ int32_t main(int32_t const argc, char *const argv[argc])
         case 'g':
             path_fsjson_load = optarg;
             break;
+        case 'l': {
+            char *end = NULL;
+            unsigned long const lvl = strtoul(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || lvl > LOG_LVL_DBG)
+            {
+                fprintf(stderr, "Invalid log level: '%s'.\n", optarg);
+                print_usage(argv[0U]);
+                return EXIT_FAILURE;
+            }
+            /* Safe cast since the level was checked to be in range. */
+            log_lvl = (log_lvl_et)lvl;
+            break;
+        }
+        case 's':
+            log_secret = true;
+            break;
+        case 'a':
+            if (strcmp(optarg, "milenage") == 0)
+            {
+                auth_algo = MILENAGE_ALGO_MILENAGE;
+            }
+            else if (strcmp(optarg, "tuak") == 0)
+            {
+                auth_algo = MILENAGE_ALGO_TUAK;
+            }
+            else if (strcmp(optarg, "xor") == 0)
+            {
+                auth_algo = MILENAGE_ALGO_XOR;
+            }
+            else
+            {
+                fprintf(stderr, "Invalid authentication algorithm: '%s'.\n",
+                        optarg);
+                print_usage(argv[0U]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            if (strlen(optarg) == 0U || strlen(optarg) > KDF_SNN_LEN_MAX)
+            {
+                fprintf(stderr, "Invalid serving network name: '%s'.\n",
+                        optarg);
+                print_usage(argv[0U]);
+                return EXIT_FAILURE;
+            }
+            snn = optarg;
+            break;
+        case 'd':
+            rsp_direct = true;
+            break;
+        case 'N': {
+            char *end = NULL;
+            unsigned long const count_arg = strtoul(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || count_arg == 0U ||
+                count_arg > INSTANCE_COUNT_MAX)
+            {
+                fprintf(stderr, "Invalid instance count: '%s'.\n", optarg);
+                print_usage(argv[0U]);
+                return EXIT_FAILURE;
+            }
+            /* Safe cast since the count was checked to be in range. */
+            count = (uint32_t)count_arg;
+            break;
+        }
+        case 'm':
+            path_manifest = optarg;
+            break;
+        case 'P':
+            pin = true;
+            break;
         case '?':
             break;
         }
@@ -130,56 +571,194 @@ int32_t main(int32_t const argc, char *const argv[argc])
         print_usage(argv[0U]);
         return EXIT_FAILURE;
     }
+
+    manifest_sub_st *sub_arr = NULL;
+    uint32_t sub_count = 0U;
+    if (path_manifest != NULL)
+    {
+        FILE *const f = fopen(path_manifest, "r");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Failed to open manifest '%s'.\n", path_manifest);
+            return EXIT_FAILURE;
+        }
+        int32_t const ret_manifest = manifest_read(f, &sub_arr, &sub_count);
+        fclose(f);
+        if (ret_manifest != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        if (count == 0U)
+        {
+            count = sub_count;
+        }
+        if (sub_count < count || count > INSTANCE_COUNT_MAX)
+        {
+            fprintf(stderr,
+                    "Manifest has %" PRIu32 " subscribers for %" PRIu32
+                    " instances.\n",
+                    sub_count, count);
+            free(sub_arr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (count == 0U)
+    {
+        count = 1U;
+    }
+
     fprintf(stderr,
             "swSIM:"
             "\n  swICC FS at '%s'."
             "\n  FS JSON at  '%s'."
-            "\n  Connect to   %s:%s.\n\n",
+            "\n  Connect to   %s:%s."
+            "\n  Instances    %" PRIu32 ".\n\n",
             path_swiccfs, path_fsjson_load == NULL ? "?" : path_fsjson_load,
-            server_ip, server_port);
+            server_ip, server_port, count);
 
-    swsim_st swsim_state = {0U};
-    swicc_st swicc_state = {0U};
     swicc_ret_et ret = SWICC_RET_ERROR;
+    instance_st *const instance_all = calloc(count, sizeof(*instance_all));
+    if (instance_all == NULL)
+    {
+        fprintf(stderr, "Failed to allocate instances.\n");
+        free(sub_arr);
+        return EXIT_FAILURE;
+    }
+
+    instance_cfg_st const cfg = {
+        .server_ip = server_ip,
+        .server_port = server_port,
+        .path_swiccfs = path_swiccfs,
+        .path_fsjson_load = path_fsjson_load,
+        .log_lvl = log_lvl,
+        .log_secret = log_secret,
+        .auth_algo = auth_algo,
+        .snn = snn,
+        .rsp_direct = rsp_direct,
+        .sub_arr = sub_arr,
+    };
+    for (uint32_t i = 0U; i < count; ++i)
+    {
+        instance_all[i].cfg = &cfg;
+        instance_all[i].idx = i;
+    }
+    int32_t const ret_init = instance_init_all(instance_all, count);
+    free(sub_arr);
 
-    if (swsim_init(&swsim_state, &swicc_state, path_fsjson_load,
-                   path_swiccfs) == 0)
+    if (ret_init == 0)
     {
-        swsim_state.proactive.app_default_enable = true;
+        host_st host = {
+            .instance_arr = instance_all,
+            .instance_count = count,
+            .image_swicc_state =
+                count == 1U ? &instance_all[0U].swicc_state : NULL,
+            .image_path = path_swiccfs,
+            .thread_main = pthread_self(),
+        };
+        atomic_init(&host.run_left, count);
+        atomic_init(&host.stop, false);
+        for (uint32_t i = 0U; i < count; ++i)
+        {
+            instance_all[i].host = &host;
+            atomic_init(&instance_all[i].done, false);
+        }
+        host_sig = &host;
+
+        /**
+         * Exit signals are blocked in all threads (they inherit the mask) and
+         * only taken by the main thread with sigwait, so shutting down runs
+         * outside of a signal handler. SIGUSR2 interrupts blocking calls
+         * since it is registered without SA_RESTART.
+         */
+        sigset_t sig_exit_set;
+        sigemptyset(&sig_exit_set);
+        sigaddset(&sig_exit_set, SIGINT);
+        sigaddset(&sig_exit_set, SIGTERM);
+        struct sigaction sig_wake = {.sa_handler = sig_wake_handler};
+        sigemptyset(&sig_wake.sa_mask);
+        if (pthread_sigmask(SIG_BLOCK, &sig_exit_set, NULL) == 0 &&
+            sigaction(SIGUSR2, &sig_wake, NULL) == 0 &&
+            signal(SIGUSR1, sig_rsp_direct_handler) != SIG_ERR)
+        {
+            ret = SWICC_RET_SUCCESS;
+        }
+        if (log_thread_start() != 0)
+        {
+            fprintf(stderr, "Failed to start the log thread.\n");
+        }
 
-        ret = swicc_net_client_sig_register(sig_exit_handler);
         if (ret == SWICC_RET_SUCCESS)
         {
-            ret = swicc_net_client_create(&client_ctx, server_ip, server_port);
-            if (ret == SWICC_RET_SUCCESS)
+            fprintf(stderr, "Press ctrl-c to exit.\n");
+            long const cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+            uint32_t run_count = 0U;
+            for (; run_count < count; ++run_count)
             {
-                fprintf(stderr, "Press ctrl-c to exit.\n");
-                ret = swicc_net_client(&swicc_state, &client_ctx);
-                if (ret != SWICC_RET_SUCCESS)
+                pthread_attr_t attr;
+                pthread_attr_init(&attr);
+                if (pin && cpu_count > 0)
                 {
-                    if (ret != SWICC_RET_NET_DISCONNECTED)
-                    {
-                        fprintf(stderr, "Failed to run network client.\n");
-                    }
-                    else
-                    {
-                        fprintf(stderr,
-                                "Client was disconnected from server.\n");
-                    }
+                    cpu_set_t cpu_set;
+                    CPU_ZERO(&cpu_set);
+                    CPU_SET(run_count % (uint32_t)cpu_count, &cpu_set);
+                    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set),
+                                                &cpu_set);
+                }
+                int const ret_create =
+                    pthread_create(&instance_all[run_count].thread, &attr,
+                                   instance_run, &instance_all[run_count]);
+                pthread_attr_destroy(&attr);
+                if (ret_create != 0)
+                {
+                    fprintf(stderr,
+                            "Failed to start instance %" PRIu32 ".\n",
+                            run_count);
+                    ret = SWICC_RET_ERROR;
+                    break;
                 }
-                swicc_net_client_destroy(&client_ctx);
             }
-            else
+
+            if (run_count == count)
+            {
+                /* Woken up by ctrl-c or once all instances have returned. */
+                int signum;
+                sigwait(&sig_exit_set, &signum);
+            }
+            bool const stop_requested =
+                run_count == count && atomic_load(&host.run_left) > 0U;
+            if (stop_requested)
+            {
+                fprintf(stderr, "Shutting down...\n");
+            }
+            host_stop(&host, run_count);
+            for (uint32_t i = 0U; i < run_count; ++i)
             {
-                fprintf(stderr, "Failed to create a client.\n");
+                if (!stop_requested && instance_all[i].ret != SWICC_RET_SUCCESS)
+                {
+                    ret = instance_all[i].ret;
+                }
             }
         }
         else
         {
             fprintf(stderr, "Failed to register signal handler.\n");
         }
-        swicc_terminate(&swicc_state);
+        /* All instances are stopped so the image is no longer written to. */
+        host_sig = NULL;
+        auth_cache_print(&host);
+        image_save(&host);
+        log_thread_stop();
+    }
+
+    for (uint32_t i = 0U; i < count; ++i)
+    {
+        if (instance_all[i].init_done)
+        {
+            swicc_terminate(&instance_all[i].swicc_state);
+            log_unregister(&instance_all[i].swsim_state.log);
+        }
     }
+    free(instance_all);
 
     if (ret == SWICC_RET_NET_DISCONNECTED)
     {
@@ -0,0 +1,288 @@
+#include "manifest.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Decode a hex string of an exact length.
+ * @param[in] hex Hex string.
+ * @param[out] bin Where the decoded bytes are written.
+ * @param[in] bin_len Expected number of bytes.
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t hex_decode(char const *const hex, uint8_t *const bin,
+                          uint32_t const bin_len)
+{
+    if (strlen(hex) != bin_len * 2U)
+    {
+        return -1;
+    }
+    for (uint32_t i = 0; i < bin_len * 2U; ++i)
+    {
+        char const c = hex[i];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9')
+        {
+            nibble = (uint8_t)(c - '0');
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            nibble = (uint8_t)(c - 'A' + 10);
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            nibble = (uint8_t)(c - 'a' + 10);
+        }
+        else
+        {
+            return -1;
+        }
+        if (i % 2U == 0U)
+        {
+            bin[i / 2U] = (uint8_t)(nibble << 4U);
+        }
+        else
+        {
+            bin[i / 2U] |= nibble;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse one 'name=value' field of a manifest line into a subscriber.
+ * @param[in] name Name of the field.
+ * @param[in] value Value of the field.
+ * @param[in, out] sub
+ * @return 0 on success, -1 if the field is unknown or its value is invalid.
+ */
+static int32_t manifest_field_parse(char const *const name,
+                                    char const *const value,
+                                    manifest_sub_st *const sub)
+{
+    if (strcmp(name, "top") == 0)
+    {
+        return hex_decode(value, sub->top, sizeof(sub->top));
+    }
+    else if (strcmp(name, "topc") == 0)
+    {
+        sub->top_c_present = true;
+        return hex_decode(value, sub->top_c, sizeof(sub->top_c));
+    }
+    return -1;
+}
+
+int32_t manifest_read(FILE *const f, manifest_sub_st **const sub_arr,
+                      uint32_t *const sub_count)
+{
+    manifest_sub_st *sub_all = NULL;
+    uint32_t sub_max = 0U;
+    uint32_t count = 0U;
+    char line[384];
+    uint64_t line_num = 0U;
+    int32_t ret = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        ++line_num;
+        char imsi[32];
+        if (line[0] == '#' || sscanf(line, "%31s", imsi) != 1)
+        {
+            continue;
+        }
+
+        if (count == sub_max)
+        {
+            sub_max = sub_max == 0U ? 64U : sub_max * 2U;
+            manifest_sub_st *const sub_new =
+                realloc(sub_all, sub_max * sizeof(*sub_new));
+            if (sub_new == NULL)
+            {
+                fprintf(stderr, "Failed to allocate manifest subscribers.\n");
+                ret = -1;
+                break;
+            }
+            sub_all = sub_new;
+        }
+        manifest_sub_st *const sub = &sub_all[count];
+        memset(sub, 0, sizeof(*sub));
+
+        /**
+         * The columns (IMSI, K, OPc, SQN) come first and are followed by the
+         * named fields.
+         */
+        char *column[4U] = {NULL};
+        uint32_t column_count = 0U;
+        bool field_seen = false;
+        bool valid = true;
+        char *save = NULL;
+        for (char *token = strtok_r(line, " \t\r\n", &save);
+             token != NULL && valid; token = strtok_r(NULL, " \t\r\n", &save))
+        {
+            char *const eq = strchr(token, '=');
+            if (eq != NULL)
+            {
+                *eq = '\0';
+                field_seen = true;
+                valid = manifest_field_parse(token, eq + 1, sub) == 0;
+            }
+            else if (column_count < 4U && !field_seen)
+            {
+                column[column_count++] = token;
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+        if (valid && column_count < 2U)
+        {
+            fprintf(stderr, "Manifest line %" PRIu64 " is incomplete.\n",
+                    line_num);
+            ret = -1;
+            break;
+        }
+
+        uint8_t ef_imsi[MANIFEST_EF_IMSI_LEN];
+        /* Safe cast since the K is either 128 or 256 bits. */
+        sub->k_len = (uint8_t)(valid && strlen(column[1U]) == 64U ? 32U : 16U);
+        sub->op_c_present = column_count >= 3U;
+        if (!valid || manifest_imsi_encode(column[0U], ef_imsi) != 0 ||
+            hex_decode(column[1U], sub->k, sub->k_len) != 0 ||
+            (sub->op_c_present &&
+             hex_decode(column[2U], sub->op_c, sizeof(sub->op_c)) != 0))
+        {
+            fprintf(stderr, "Manifest line %" PRIu64 " is invalid.\n",
+                    line_num);
+            ret = -1;
+            break;
+        }
+        memcpy(sub->imsi, column[0U], strlen(column[0U]));
+        ++count;
+    }
+
+    if (ret == 0 && count == 0U)
+    {
+        fprintf(stderr, "Manifest has no subscribers.\n");
+        ret = -1;
+    }
+    if (ret != 0)
+    {
+        free(sub_all);
+        return -1;
+    }
+    *sub_arr = sub_all;
+    *sub_count = count;
+    return 0;
+}
+
+int32_t manifest_imsi_encode(char const *const imsi,
+                             uint8_t ef_imsi[const MANIFEST_EF_IMSI_LEN])
+{
+    size_t const imsi_len = strlen(imsi);
+    if (imsi_len < 6U || imsi_len > MANIFEST_IMSI_LEN_MAX)
+    {
+        return -1;
+    }
+    for (size_t i = 0U; i < imsi_len; ++i)
+    {
+        if (imsi[i] < '0' || imsi[i] > '9')
+        {
+            return -1;
+        }
+    }
+
+    memset(ef_imsi, 0xFF, MANIFEST_EF_IMSI_LEN);
+    /**
+     * The first nibble holds the parity (bit 4 is set for an odd number of
+     * digits) and the type of identity (001 for IMSI), so the digits start
+     * at the second nibble.
+     */
+    /* Safe cast since the IMSI has at most 15 digits. */
+    ef_imsi[0U] = (uint8_t)((imsi_len + 2U) / 2U);
+    ef_imsi[1U] = imsi_len % 2U == 1U ? 0x09 : 0x01;
+    for (size_t i = 0U; i < imsi_len; ++i)
+    {
+        /* Safe cast since it is a single digit. */
+        uint8_t const digit = (uint8_t)(imsi[i] - '0');
+        uint8_t *const byte = &ef_imsi[1U + ((i + 1U) / 2U)];
+        if (i % 2U == 0U)
+        {
+            *byte = (uint8_t)((*byte & 0x0F) | (digit << 4U));
+        }
+        else
+        {
+            *byte = (uint8_t)((*byte & 0xF0) | digit);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Override the keys of the Milenage and TUAK parameters of an instance.
+ * @param[in] sub Subscriber of the instance.
+ * @param[in, out] swsim_state
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t manifest_key_apply(manifest_sub_st const *const sub,
+                                  swsim_st *const swsim_state)
+{
+    milenage_st *const milenage = &swsim_state->milenage;
+    if (sub->op_c_present)
+    {
+        milenage->op_present = false;
+        memcpy(milenage->op_c, sub->op_c, sizeof(milenage->op_c));
+    }
+    /* Milenage only takes a 128-bit K and keeps its own otherwise. */
+    if (sub->k_len == sizeof(milenage->k))
+    {
+        milenage_k_set(milenage, sub->k);
+    }
+
+    tuak_st *const tuak = &swsim_state->tuak;
+    if (tuak_k_set(tuak, sub->k, sub->k_len) != 0)
+    {
+        return -1;
+    }
+    if (sub->top_c_present)
+    {
+        memcpy(tuak->top_c, sub->top_c, sizeof(tuak->top_c));
+    }
+    else
+    {
+        /**
+         * TOPc depends on K so it is derived again, by default from the zero
+         * TOP of swsim_init.
+         */
+        tuak_top_set(tuak, sub->top);
+    }
+    return 0;
+}
+
+int32_t manifest_apply(manifest_sub_st const *const sub,
+                       swsim_st *const swsim_state,
+                       swicc_st *const swicc_state)
+{
+    uint8_t ef_imsi[MANIFEST_EF_IMSI_LEN];
+    if (manifest_imsi_encode(sub->imsi, ef_imsi) != 0 ||
+        manifest_key_apply(sub, swsim_state) != 0)
+    {
+        return -1;
+    }
+
+    /* Only applications (e.g. ADF.USIM) have an EF.IMSI with this SID. */
+    bool imsi_set = false;
+    for (swicc_disk_tree_st *tree = swicc_state->fs.disk.root; tree != NULL;
+         tree = tree->next)
+    {
+        swicc_fs_file_st file_imsi;
+        if (swicc_disk_lutsid_lookup(tree, MANIFEST_EF_IMSI_SID,
+                                     &file_imsi) == SWICC_RET_SUCCESS &&
+            file_imsi.hdr_item.type == SWICC_FS_ITEM_TYPE_FILE_EF_TRANSPARENT &&
+            file_imsi.data_size >= MANIFEST_EF_IMSI_LEN)
+        {
+            memcpy(file_imsi.data, ef_imsi, MANIFEST_EF_IMSI_LEN);
+            imsi_set = true;
+        }
+    }
+    return imsi_set ? 0 : -1;
+}
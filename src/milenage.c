@@ -1,5 +1,7 @@
 #include "milenage.h"
+#include "kdf.h"
 #include "rijndael.h"
+#include "tuak.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -53,15 +55,31 @@ static void rotl128(uint8_t n[const 16], uint32_t const r)
     }
 }
 
+/**
+ * @brief Rotate a number n by a whole number of 32-bit words to the left with
+ * wrap-around. Same as rotl128 with r = 32 * words but done with word moves.
+ * @param[in, out] n Number to rotate.
+ * @param[in] words Number of words to rotate by.
+ */
+static void rotl128_word(uint8_t n[const 16], uint32_t const words)
+{
+    uint32_t w[4];
+    memcpy(w, n, sizeof(w));
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        memcpy(&n[i * 4], &w[(i + words) % 4], sizeof(w[0]));
+    }
+}
+
 /**
  * @brief Function to compute OPc from OP and K per ETSI TS 135 206 V17.0.0
  * annex.1.
- * @param[in, out] rijndael State of rijndael block cipher. It must be
+ * @param[in] rijndael State of rijndael block cipher. It must be
  * initialized before calling this function.
  * @param[in] op OP that will be used to compute OPc.
  * @param[out] op_c Compute OPc will be written here.
  */
-static void opc(rijndael_st *const rijndael, uint8_t const op[const 16],
+static void opc(rijndael_st const *const rijndael, uint8_t const op[const 16],
                 uint8_t op_c[const 16])
 {
     rijndael_encrypt(rijndael, op, op_c);
@@ -69,45 +87,36 @@ static void opc(rijndael_st *const rijndael, uint8_t const op[const 16],
 }
 
 /**
- * @brief Generic function to help implement f1, and f1* as defined per
- * ETSI TS 135 206 V17.0.0.
+ * @brief Compute the TEMP value shared by all Milenage functions per ETSI TS
+ * 135 206 V17.0.0 clause.4.1.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
- * @param[out] output = E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K ^ OPc.
+ * @param[out] temp = E[RAND ^ OPc]K.
  */
-static void f11star_generic(milenage_st const *const milenage,
-                            uint8_t const k[const 16],
-                            uint8_t const rand[const 16],
-                            uint8_t const sqn[const 6],
-                            uint8_t const amf[const 2],
-                            uint8_t output[const 16])
+static void temp_get(milenage_st const *const milenage,
+                     uint8_t const rand[const 16], uint8_t temp[const 16])
 {
-    uint8_t op_c[16];
-
-    rijndael_st rijndael;
-    rijndael_init(&rijndael, k);
-
-    if (milenage->op_present)
-    {
-        fprintf(stderr, "Milenage: f1 uses usim-computed OPc.\n");
-        opc(&rijndael, milenage->op, op_c);
-    }
-    else
-    {
-        fprintf(stderr, "Milenage: f1 uses pre-computed OPc.\n");
-        for (uint8_t i = 0; i < 16; ++i)
-        {
-            op_c[i] = milenage->op_c[i];
-        }
-    }
-
     uint8_t enc0_in[16];
-    xorv((uint8_t const *const)rand, op_c, 16, enc0_in);
-    uint8_t enc0_out[16];
-    rijndael_encrypt(&rijndael, enc0_in, enc0_out);
+    /* RAND ^ OPc */
+    xorv(rand, milenage->op_c, 16, enc0_in);
 
-    uint8_t enc1_in[16];
+    /* E[RAND ^ OPc]K */
+    rijndael_encrypt(&milenage->rijndael, enc0_in, temp);
+}
+
+/**
+ * @brief Create the block which is encrypted to get OUT1 (used by f1 and f1*)
+ * per ETSI TS 135 206 V17.0.0 clause.4.1.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] temp TEMP = E[RAND ^ OPc]K.
+ * @param[in] sqn Sequence number.
+ * @param[in] amf Authentication management field.
+ * @param[out] enc1_in = TEMP ^ rot(IN1 ^ OPc, r1) ^ c1.
+ */
+static void out1_in(milenage_st const *const milenage,
+                    uint8_t const temp[const 16], uint8_t const sqn[const 6],
+                    uint8_t const amf[const 2], uint8_t enc1_in[const 16])
+{
     /* Create 128b integer = SQN || AMF || SQN || AMF. */
     for (uint8_t i = 0; i < 6; ++i)
     {
@@ -121,50 +130,162 @@ static void f11star_generic(milenage_st const *const milenage,
     }
 
     /* (SQN || AMF || SQN || AMF) ^ OPc */
-    xorv(enc1_in, op_c, 16, enc1_in);
+    xorv(enc1_in, milenage->op_c, 16, enc1_in);
 
-    /* rot((SQN || AMF || SQN || AMF) ^ OPc, r1) */
-    rotl128(enc1_in, milenage->r1);
+    if (milenage->param_std)
+    {
+        /* Standard r1 is a multiple of 32 and c1 only has a last byte. */
+        rotl128_word(enc1_in, milenage->r1 / 32U);
+        enc1_in[15] ^= milenage->c1[15];
+    }
+    else
+    {
+        /* rot((SQN || AMF || SQN || AMF) ^ OPc, r1) */
+        rotl128(enc1_in, milenage->r1);
 
-    /* rot((SQN || AMF || SQN || AMF) ^ OPc, r1) ^ c1 */
-    xorv(enc1_in, milenage->c1, 16, enc1_in);
+        /* rot((SQN || AMF || SQN || AMF) ^ OPc, r1) ^ c1 */
+        xorv(enc1_in, milenage->c1, 16, enc1_in);
+    }
 
     /* E[RAND ^ OPc]K ^ (rot((SQN || AMF || SQN || AMF) ^ OPc, r1) ^ c1) */
-    xorv(enc1_in, enc0_out, 16, enc1_in);
+    xorv(enc1_in, temp, 16, enc1_in);
+}
+
+/**
+ * @brief Create the block which is encrypted to get one of OUT2-OUT5 (used by
+ * f2, f3, f4, f5, and f5*) per ETSI TS 135 206 V17.0.0 clause.4.1.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] temp TEMP = E[RAND ^ OPc]K.
+ * @param[in] c Constant ci.
+ * @param[in] r Rotation ri.
+ * @param[out] enc1_in = rot(TEMP ^ OPc, r) ^ c.
+ */
+static void outn_in(milenage_st const *const milenage,
+                    uint8_t const temp[const 16], uint8_t const c[const 16],
+                    uint8_t const r, uint8_t enc1_in[const 16])
+{
+    /* E[RAND ^ OPc]K ^ OPc */
+    xorv(temp, milenage->op_c, 16, enc1_in);
+
+    if (milenage->param_std)
+    {
+        /* Standard ri are multiples of 32 and ci only have a last byte. */
+        rotl128_word(enc1_in, r / 32U);
+        enc1_in[15] ^= c[15];
+    }
+    else
+    {
+        /* rot(E[RAND ^ OPc]K ^ OPc, r) */
+        rotl128(enc1_in, r);
+
+        /* rot(E[RAND ^ OPc]K ^ OPc, r) ^ c */
+        xorv(enc1_in, c, 16, enc1_in);
+    }
+}
 
-    uint8_t enc1_out[16];
+/**
+ * @brief Compute OUT1 (used by f1 and f1*) from TEMP per ETSI TS 135 206
+ * V17.0.0 clause.4.1.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] temp TEMP = E[RAND ^ OPc]K.
+ * @param[in] sqn Sequence number.
+ * @param[in] amf Authentication management field.
+ * @param[out] out1 = E[TEMP ^ rot(IN1 ^ OPc, r1) ^ c1]K ^ OPc.
+ */
+static void out1_get(milenage_st const *const milenage,
+                     uint8_t const temp[const 16], uint8_t const sqn[const 6],
+                     uint8_t const amf[const 2], uint8_t out1[const 16])
+{
+    uint8_t enc1_in[16];
+    out1_in(milenage, temp, sqn, amf, enc1_in);
 
     /* E[E[RAND ^ OPc]K ^ (rot((SQN || AMF || SQN || AMF) ^ OPc, r1) ^ c1)]K */
-    rijndael_encrypt(&rijndael, enc1_in, enc1_out);
+    rijndael_encrypt(&milenage->rijndael, enc1_in, out1);
 
     /**
-     * At this point: enc1_out = OUT1.
+     * At this point: out1 = OUT1 ^ OPc.
      * With OUT1 defined in ETSI TS 135 206 V17.0.0.
      */
+    xorv(out1, milenage->op_c, 16, out1);
+}
 
-    xorv(enc1_out, op_c, 16, enc1_out);
+/**
+ * @brief Compute one of OUT2-OUT5 (used by f2, f3, f4, f5, and f5*) from TEMP
+ * per ETSI TS 135 206 V17.0.0 clause.4.1.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] temp TEMP = E[RAND ^ OPc]K.
+ * @param[in] c Constant ci.
+ * @param[in] r Rotation ri.
+ * @param[out] out = E[rot(TEMP ^ OPc, r) ^ c]K ^ OPc.
+ */
+static void outn_get(milenage_st const *const milenage,
+                     uint8_t const temp[const 16], uint8_t const c[const 16],
+                     uint8_t const r, uint8_t out[const 16])
+{
+    uint8_t enc1_in[16];
+    outn_in(milenage, temp, c, r, enc1_in);
 
-    for (uint8_t i = 0; i < 16; ++i)
-    {
-        output[i] = enc1_out[i];
-    }
+    /* E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K */
+    rijndael_encrypt(&milenage->rijndael, enc1_in, out);
+
+    /* E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K ^ OPc */
+    xorv(out, milenage->op_c, 16, out);
+}
+
+/**
+ * @brief Compute the GSM cipher key for UMTS-GSM interoperability purposes.
+ * The process of generating it, is called the "C3 conversion".
+ * @param[in] ck Confidentiality key.
+ * @param[in] ik Integrity key.
+ * @param[out] kc = CK1 ^ CK2 ^ IK1 ^ IK2.
+ */
+static void kc_get(uint8_t const ck[const 16], uint8_t const ik[const 16],
+                   uint8_t kc[const 8])
+{
+    uint8_t kc_tmp0[8];
+    uint8_t kc_tmp1[8];
+    xorv(ck, &ik[8], 8, kc_tmp0);
+    xorv(&ck[8], ik, 8, kc_tmp1);
+    xorv(kc_tmp0, kc_tmp1, 8, kc);
+}
+
+/**
+ * @brief Generic function to help implement f1, and f1* as defined per
+ * ETSI TS 135 206 V17.0.0.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number.
+ * @param[in] amf Authentication management field.
+ * @param[out] output = E[TEMP ^ rot(IN1 ^ OPc, r1) ^ c1]K ^ OPc.
+ */
+static void f11star_generic(milenage_st const *const milenage,
+                            uint8_t const rand[const 16],
+                            uint8_t const sqn[const 6],
+                            uint8_t const amf[const 2],
+                            uint8_t output[const 16])
+{
+    uint8_t temp[16];
+    temp_get(milenage, rand, temp);
+
+    out1_get(milenage, temp, sqn, amf, output);
 }
 
 /**
  * @brief Function f1 as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage state and parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[in] sqn Sequence number.
  * @param[in] amf Authentication management field.
  * @param[out] mac_a Network authnetication code.
  */
-static void f1(milenage_st const *const milenage, uint8_t const k[const 16],
-               uint8_t const rand[const 16], uint8_t const sqn[const 6],
-               uint8_t const amf[const 2], uint8_t mac_a[const 8])
+__attribute__((unused)) static void f1(milenage_st const *const milenage,
+                                       uint8_t const rand[const 16],
+                                       uint8_t const sqn[const 6],
+                                       uint8_t const amf[const 2],
+                                       uint8_t mac_a[const 8])
 {
     uint8_t output[16];
-    f11star_generic(milenage, k, rand, sqn, amf, output);
+    f11star_generic(milenage, rand, sqn, amf, output);
     for (uint8_t i = 0; i < 8; ++i)
     {
         mac_a[i] = output[i];
@@ -174,21 +295,19 @@ static void f1(milenage_st const *const milenage, uint8_t const k[const 16],
 /**
  * @brief Function f1* as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[in] sqn Sequence number.
  * @param[in] amf Authentication management field.
  * @param[out] mac_s Resynch authentication code.
  */
 __attribute__((unused)) static void f1star(milenage_st const *const milenage,
-                                           uint8_t const k[const 16],
                                            uint8_t const rand[const 16],
                                            uint8_t const sqn[const 6],
                                            uint8_t const amf[const 2],
                                            uint8_t mac_s[const 8])
 {
     uint8_t output[16];
-    f11star_generic(milenage, k, rand, sqn, amf, output);
+    f11star_generic(milenage, rand, sqn, amf, output);
     for (uint8_t i = 0; i < 8; ++i)
     {
         mac_s[i] = output[8 + i];
@@ -199,78 +318,34 @@ __attribute__((unused)) static void f1star(milenage_st const *const milenage,
  * @brief Generic function to help implement f2, f3, f4, and f5 as defined per
  * ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[out] output = E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K ^ OPc.
+ * @param[in] c Constant ci.
+ * @param[in] r Rotation ri.
  */
 static void f2345_generic(milenage_st const *const milenage,
-                          uint8_t const k[const 16],
                           uint8_t const rand[const 16],
                           uint8_t output[const 16], uint8_t const c[const 16],
                           uint8_t const r)
 {
-    rijndael_st rijndael;
-    rijndael_init(&rijndael, k);
-
-    uint8_t op_c[16];
-    if (milenage->op_present)
-    {
-        fprintf(stderr, "Milenage: f2345 uses usim-computed OPc.\n");
-        opc(&rijndael, milenage->op, op_c);
-    }
-    else
-    {
-        fprintf(stderr, "Milenage: f2345 uses pre-computed OPc.\n");
-        for (uint8_t i = 0; i < 16; ++i)
-        {
-            op_c[i] = milenage->op_c[i];
-        }
-    }
-
-    uint8_t enc0_in[16];
-    /* RAND ^ OPc */
-    xorv(rand, op_c, 16, enc0_in);
-
-    uint8_t enc0_out[16];
-    /* E[RAND ^ OPc]K */
-    rijndael_encrypt(&rijndael, enc0_in, enc0_out);
-
-    uint8_t enc1_in[16];
-    /* E[RAND ^ OPc]K ^ OPc */
-    xorv(enc0_out, op_c, 16, enc1_in);
+    uint8_t temp[16];
+    temp_get(milenage, rand, temp);
 
-    /* rot(E[RAND ^ OPc]K ^ OPc, r) */
-    rotl128(enc1_in, r);
-
-    /* rot(E[RAND ^ OPc]K ^ OPc, r) ^ c */
-    xorv(enc1_in, c, 16, enc1_in);
-
-    uint8_t enc1_out[16];
-    /* E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K */
-    rijndael_encrypt(&rijndael, enc1_in, enc1_out);
-
-    /* E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K ^ OPc */
-    xorv(enc1_out, op_c, 16, enc1_out);
-
-    /* output = E[rot(E[RAND ^ OPc]K ^ OPc, r) ^ c]K ^ OPc */
-    for (uint8_t i = 0; i < 16; ++i)
-    {
-        output[i] = enc1_out[i];
-    }
+    outn_get(milenage, temp, c, r, output);
 }
 
 /**
  * @brief Function f2 as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[out] res Response.
  */
-static void f2(milenage_st const *const milenage, uint8_t const k[const 16],
-               uint8_t const rand[const 16], uint8_t res[const 8])
+__attribute__((unused)) static void f2(milenage_st const *const milenage,
+                                       uint8_t const rand[const 16],
+                                       uint8_t res[const 8])
 {
     uint8_t output[16];
-    f2345_generic(milenage, k, rand, output, milenage->c2, milenage->r2);
+    f2345_generic(milenage, rand, output, milenage->c2, milenage->r2);
     for (uint8_t i = 0; i < 8; ++i)
     {
         res[i] = output[8 + i];
@@ -280,41 +355,41 @@ static void f2(milenage_st const *const milenage, uint8_t const k[const 16],
 /**
  * @brief Function f3 as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[out] ck Confidentiality key.
  */
-static void f3(milenage_st const *const milenage, uint8_t const k[const 16],
-               uint8_t const rand[const 16], uint8_t ck[const 16])
+__attribute__((unused)) static void f3(milenage_st const *const milenage,
+                                       uint8_t const rand[const 16],
+                                       uint8_t ck[const 16])
 {
-    f2345_generic(milenage, k, rand, ck, milenage->c3, milenage->r3);
+    f2345_generic(milenage, rand, ck, milenage->c3, milenage->r3);
 }
 
 /**
  * @brief Function f4 as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[out] ik Integrity key.
  */
-static void f4(milenage_st const *const milenage, uint8_t const k[const 16],
-               uint8_t const rand[const 16], uint8_t ik[const 16])
+__attribute__((unused)) static void f4(milenage_st const *const milenage,
+                                       uint8_t const rand[const 16],
+                                       uint8_t ik[const 16])
 {
-    f2345_generic(milenage, k, rand, ik, milenage->c4, milenage->r4);
+    f2345_generic(milenage, rand, ik, milenage->c4, milenage->r4);
 }
 
 /**
  * @brief Function f5 as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[out] ak Anonimity key.
  */
-static void f5(milenage_st const *const milenage, uint8_t const k[const 16],
-               uint8_t const rand[const 16], uint8_t ak[const 6])
+__attribute__((unused)) static void f5(milenage_st const *const milenage,
+                                       uint8_t const rand[const 16],
+                                       uint8_t ak[const 6])
 {
     uint8_t output[16];
-    f2345_generic(milenage, k, rand, output, milenage->c2, milenage->r2);
+    f2345_generic(milenage, rand, output, milenage->c2, milenage->r2);
     for (uint8_t i = 0; i < 6; ++i)
     {
         ak[i] = output[i];
@@ -324,33 +399,54 @@ static void f5(milenage_st const *const milenage, uint8_t const k[const 16],
 /**
  * @brief Function f5* as defined in ETSI TS 135 206 V17.0.0.
  * @param[in] milenage Milenage parameters.
- * @param[in] k Subscriber key.
  * @param[in] rand Random challenge.
  * @param[out] ak Resynch anonimity key.
  */
 __attribute__((unused)) static void f5star(milenage_st const *const milenage,
-                                           uint8_t const k[const 16],
                                            uint8_t const rand[const 16],
                                            uint8_t ak[const 6])
 {
     uint8_t output[16];
-    f2345_generic(milenage, k, rand, output, milenage->c5, milenage->r5);
+    f2345_generic(milenage, rand, output, milenage->c5, milenage->r5);
     for (uint8_t i = 0; i < 6; ++i)
     {
         ak[i] = output[i];
     }
 }
 
-swicc_ret_et milenage(milenage_st *const milenage, uint8_t const rand[const 16],
-                      uint8_t const autn[const 16],
-                      uint8_t output[const SWICC_DATA_MAX],
-                      uint16_t *const output_len)
+void milenage_param_std_check(milenage_st *const milenage)
+{
+    /* Standard constants per ETSI TS 135 206 V17.0.0 clause.4.1. */
+    static uint8_t const r_std[5] = {64, 0, 32, 64, 96};
+    static uint8_t const c_std_last[5] = {0x00, 0x01, 0x02, 0x04, 0x08};
+
+    uint8_t const *const c[5] = {
+        milenage->c1, milenage->c2, milenage->c3, milenage->c4, milenage->c5,
+    };
+    uint8_t const r[5] = {
+        milenage->r1, milenage->r2, milenage->r3, milenage->r4, milenage->r5,
+    };
+    static uint8_t const zero[15] = {0};
+
+    milenage->param_std = true;
+    for (uint8_t i = 0; i < 5; ++i)
+    {
+        if (r[i] != r_std[i] || c[i][15] != c_std_last[i] ||
+            memcmp(c[i], zero, sizeof(zero)) != 0)
+        {
+            milenage->param_std = false;
+        }
+    }
+}
+
+swicc_ret_et milenage_config_validate(milenage_st *const milenage)
 {
     /**
      * Per ETSI TS 135 206 V17.0.0 clause.5.3, pairs (ci,ri) must all be
      * different. This is a requirement. It is also recommended that c1 has even
      * parity, and c2-c5 all have odd parity.
      */
+    bool valid = true;
     {
         uint8_t c[5][4][4];
         memcpy(c[0], milenage->c1, sizeof(c[0]));
@@ -379,6 +475,7 @@ swicc_ret_et milenage(milenage_st *const milenage, uint8_t const rand[const 16],
                         c[i][1][3], c[i][2][0], c[i][2][1], c[i][2][2],
                         c[i][2][3], c[i][3][0], c[i][3][1], c[i][3][2],
                         c[i][3][3], r[i]);
+                    valid = false;
                 }
             }
         }
@@ -418,125 +515,493 @@ swicc_ret_et milenage(milenage_st *const milenage, uint8_t const rand[const 16],
         }
     }
 
-    fprintf(stderr, "Milenage: RAND=");
-    for (uint8_t i = 0; i < 16; ++i)
+    milenage->config_valid = valid;
+    if (!valid)
     {
-        fprintf(stderr, "%02X", rand[i]);
+        return SWICC_RET_ERROR;
     }
-    fprintf(stderr, ".\n");
-    fprintf(stderr, "Milenage: AUTN=");
+
+    fprintf(stderr, "Milenage: using %s OPc.\n",
+            milenage->op_present ? "usim-computed" : "pre-computed");
+
+    milenage_param_std_check(milenage);
+    return SWICC_RET_SUCCESS;
+}
+
+void milenage_k_set(milenage_st *const milenage, uint8_t const k[const 16])
+{
+    memcpy(milenage->k, k, sizeof(milenage->k));
+    rijndael_init(&milenage->rijndael, milenage->k);
+    milenage_cache_clear(milenage);
+
+    /* OPc depends on K when it is computed on the USIM. */
+    if (milenage->op_present)
+    {
+        opc(&milenage->rijndael, milenage->op, milenage->op_c);
+    }
+}
+
+void milenage_op_set(milenage_st *const milenage, uint8_t const op[const 16])
+{
+    memcpy(milenage->op, op, sizeof(milenage->op));
+    milenage->op_present = true;
+    opc(&milenage->rijndael, milenage->op, milenage->op_c);
+    milenage_cache_clear(milenage);
+}
+
+void milenage_all(milenage_st const *const milenage,
+                  uint8_t const rand[const 16], uint8_t const sqn[const 6],
+                  bool const sqn_concealed, uint8_t const amf[const 2],
+                  milenage_vec_st *const vec)
+{
+    /* TEMP is shared by all functions so it is only computed once. */
+    uint8_t temp[16];
+    temp_get(milenage, rand, temp);
+
+    uint8_t out[16];
+
+    /* OUT2 gives f5 (AK) and f2 (RES). */
+    outn_get(milenage, temp, milenage->c2, milenage->r2, out);
+    memcpy(vec->ak, &out[0], sizeof(vec->ak));
+    memcpy(vec->res, &out[8], sizeof(vec->res));
+
+    /* AK is needed to recover SQN from AUTN before f1 can be computed. */
+    if (sqn_concealed)
+    {
+        xorv(sqn, vec->ak, sizeof(vec->sqn), vec->sqn);
+    }
+    else
+    {
+        memcpy(vec->sqn, sqn, sizeof(vec->sqn));
+    }
+
+    /* OUT1 gives f1 (MAC-A) and f1* (MAC-S). */
+    out1_get(milenage, temp, vec->sqn, amf, out);
+    memcpy(vec->mac_a, &out[0], sizeof(vec->mac_a));
+    memcpy(vec->mac_s, &out[8], sizeof(vec->mac_s));
+
+    /* OUT3 is f3 (CK) and OUT4 is f4 (IK). */
+    outn_get(milenage, temp, milenage->c3, milenage->r3, vec->ck);
+    outn_get(milenage, temp, milenage->c4, milenage->r4, vec->ik);
+
+    /* OUT5 gives f5* (AK*). */
+    outn_get(milenage, temp, milenage->c5, milenage->r5, out);
+    memcpy(vec->ak_star, &out[0], sizeof(vec->ak_star));
+
+    /* GSM cipher key via the C3 conversion. */
+    kc_get(vec->ck, vec->ik, vec->kc);
+}
+
+void milenage_all_xN(milenage_st const *const milenage[const],
+                     uint8_t const rand[const][16],
+                     uint8_t const sqn[const][6], bool const sqn_concealed,
+                     uint8_t const amf[const][2], milenage_vec_st vec[const],
+                     uint32_t const n)
+{
+    /**
+     * Tuples are processed in chunks. OUT1, OUT3, OUT4, and OUT5 of a chunk
+     * are encrypted together so each chunk needs 3 multi-block calls.
+     */
+    for (uint32_t base = 0; base < n; base += MILENAGE_XN_CHUNK)
+    {
+        uint32_t const count =
+            n - base < MILENAGE_XN_CHUNK ? n - base : MILENAGE_XN_CHUNK;
+        milenage_st const *const *const m = &milenage[base];
+        milenage_vec_st *const v = &vec[base];
+
+        rijndael_st const *rijndael[MILENAGE_XN_CHUNK * 4];
+        uint8_t temp[MILENAGE_XN_CHUNK][16];
+        uint8_t in[MILENAGE_XN_CHUNK * 4][16];
+        uint8_t out[MILENAGE_XN_CHUNK * 4][16];
+
+        /* TEMP = E[RAND ^ OPc]K */
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            xorv(rand[base + i], m[i]->op_c, 16, in[i]);
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                rijndael[(j * count) + i] = &m[i]->rijndael;
+            }
+        }
+        rijndael_encrypt_xN(rijndael, in, temp, count);
+
+        /* OUT2 gives f5 (AK) and f2 (RES), and AK unconceals SQN. */
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            outn_in(m[i], temp[i], m[i]->c2, m[i]->r2, in[i]);
+        }
+        rijndael_encrypt_xN(rijndael, in, out, count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            xorv(out[i], m[i]->op_c, 16, out[i]);
+            memcpy(v[i].ak, &out[i][0], sizeof(v[i].ak));
+            memcpy(v[i].res, &out[i][8], sizeof(v[i].res));
+            if (sqn_concealed)
+            {
+                xorv(sqn[base + i], v[i].ak, sizeof(v[i].sqn), v[i].sqn);
+            }
+            else
+            {
+                memcpy(v[i].sqn, sqn[base + i], sizeof(v[i].sqn));
+            }
+        }
+
+        /* OUT1, OUT3, OUT4, and OUT5 together. */
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            out1_in(m[i], temp[i], v[i].sqn, amf[base + i], in[i]);
+            outn_in(m[i], temp[i], m[i]->c3, m[i]->r3, in[count + i]);
+            outn_in(m[i], temp[i], m[i]->c4, m[i]->r4, in[(2 * count) + i]);
+            outn_in(m[i], temp[i], m[i]->c5, m[i]->r5, in[(3 * count) + i]);
+        }
+        rijndael_encrypt_xN(rijndael, in, out, 4 * count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                uint8_t *const out_j = out[(j * count) + i];
+                xorv(out_j, m[i]->op_c, 16, out_j);
+            }
+            memcpy(v[i].mac_a, &out[i][0], sizeof(v[i].mac_a));
+            memcpy(v[i].mac_s, &out[i][8], sizeof(v[i].mac_s));
+            memcpy(v[i].ck, out[count + i], sizeof(v[i].ck));
+            memcpy(v[i].ik, out[(2 * count) + i], sizeof(v[i].ik));
+            memcpy(v[i].ak_star, out[(3 * count) + i], sizeof(v[i].ak_star));
+            kc_get(v[i].ck, v[i].ik, v[i].kc);
+        }
+    }
+}
+
+/**
+ * @brief Load a 48-bit SQN stored big-endian.
+ * @param[in] sqn
+ * @return SQN as an integer.
+ */
+static uint64_t sqn_load(uint8_t const sqn[const 6])
+{
+    uint64_t v = 0;
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        v = (v << 8U) | sqn[i];
+    }
+    return v;
+}
+
+/**
+ * @brief Store a 48-bit SQN big-endian.
+ * @param[in] v SQN as an integer.
+ * @param[out] sqn
+ */
+static void sqn_store(uint64_t const v, uint8_t sqn[const 6])
+{
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        /* Safe cast since only the lowest byte is kept. */
+        sqn[5 - i] = (uint8_t)(v >> (i * 8U));
+    }
+}
+
+static uint8_t *sqn_array_get(milenage_st *const milenage)
+{
+    return milenage->sqn_array != NULL ? milenage->sqn_array
+                                       : milenage->sqn_array_mem;
+}
+
+void milenage_sqn_array_set(milenage_st *const milenage,
+                            uint8_t *const sqn_array)
+{
+    milenage->sqn_array = sqn_array;
+    milenage_cache_clear(milenage);
+    uint8_t const *const array = sqn_array_get(milenage);
+    milenage->sqn_ms_ind = 0;
+    for (uint8_t ind = 1; ind < MILENAGE_SQN_ARRAY_LEN; ++ind)
+    {
+        if (sqn_load(&array[ind * 6U]) >
+            sqn_load(&array[milenage->sqn_ms_ind * 6U]))
+        {
+            milenage->sqn_ms_ind = ind;
+        }
+    }
+}
+
+/**
+ * @brief Compute all authentication functions with the XOR algorithm of the
+ * test USIM per ETSI TS 134 108 V17.0.0 clause.8.1.2.2. Everything is derived
+ * from XDOUT = K ^ RAND with byte moves, so this costs next to nothing.
+ * @param[in] milenage Milenage parameters (only K is used).
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number, or SQN ^ AK when sqn_concealed is true.
+ * @param[in] sqn_concealed If the SQN is concealed with AK.
+ * @param[in] amf Authentication management field.
+ * @param[out] vec Where all the outputs will be written.
+ * @note The test USIM uses the same AK for f5 and f5*, and the same XMAC
+ * construction for f1 and f1*.
+ */
+static void xor_all(milenage_st const *const milenage,
+                    uint8_t const rand[const 16], uint8_t const sqn[const 6],
+                    bool const sqn_concealed, uint8_t const amf[const 2],
+                    milenage_vec_st *const vec)
+{
+    uint8_t xdout[16];
+    xorv(milenage->k, rand, 16, xdout);
+
+    /* RES = XDOUT[0..63], CK = XDOUT <<< 8, IK = XDOUT <<< 16. */
+    memcpy(vec->res, xdout, sizeof(vec->res));
     for (uint8_t i = 0; i < 16; ++i)
     {
-        if (i == 6 || i == 8)
+        vec->ck[i] = xdout[(i + 1) % 16];
+        vec->ik[i] = xdout[(i + 2) % 16];
+    }
+
+    /* AK = XDOUT[24..71] */
+    memcpy(vec->ak, &xdout[3], sizeof(vec->ak));
+    memcpy(vec->ak_star, vec->ak, sizeof(vec->ak_star));
+    if (sqn_concealed)
+    {
+        xorv(sqn, vec->ak, sizeof(vec->sqn), vec->sqn);
+    }
+    else
+    {
+        memcpy(vec->sqn, sqn, sizeof(vec->sqn));
+    }
+
+    /* XMAC = XDOUT[0..63] ^ CDOUT where CDOUT = SQN || AMF. */
+    uint8_t cdout[8];
+    memcpy(cdout, vec->sqn, sizeof(vec->sqn));
+    memcpy(&cdout[6], amf, 2);
+    xorv(xdout, cdout, sizeof(cdout), vec->mac_a);
+    memcpy(vec->mac_s, vec->mac_a, sizeof(vec->mac_s));
+
+    kc_get(vec->ck, vec->ik, vec->kc);
+}
+
+void milenage_cache_clear(milenage_st *const milenage)
+{
+    for (uint8_t i = 0; i < MILENAGE_CACHE_LEN; ++i)
+    {
+        milenage->cache.entry[i].valid = false;
+    }
+    milenage->cache.next = 0;
+}
+
+/**
+ * @brief Find the cached response to a retransmitted challenge.
+ * @param[in] milenage Milenage parameters.
+ * @param[in] rand Random challenge.
+ * @param[in] autn AUTN.
+ * @return The cached entry, or NULL if the challenge was not answered recently
+ * or its SQN is no longer the last accepted one for its IND.
+ */
+static milenage_cache_entry_st const *cache_get(milenage_st *const milenage,
+                                                uint8_t const rand[const 16],
+                                                uint8_t const autn[const 16])
+{
+    for (uint8_t i = 0; i < MILENAGE_CACHE_LEN; ++i)
+    {
+        milenage_cache_entry_st const *const entry = &milenage->cache.entry[i];
+        if (!entry->valid || memcmp(entry->rand, rand, 16) != 0 ||
+            memcmp(entry->autn, autn, 16) != 0)
+        {
+            continue;
+        }
+        /* Safe cast since IND is only the lowest bits of SQN. */
+        uint8_t const ind =
+            (uint8_t)(entry->sqn[5] & (MILENAGE_SQN_ARRAY_LEN - 1U));
+        uint8_t const *const sqn_array = sqn_array_get(milenage);
+        if (memcmp(&sqn_array[ind * 6U], entry->sqn, sizeof(entry->sqn)) != 0)
         {
-            fprintf(stderr, " ");
+            return NULL;
         }
-        fprintf(stderr, "%02X", autn[i]);
+        return entry;
     }
-    fprintf(stderr, ".\n");
+    return NULL;
+}
 
-    uint8_t sqn_xor_ak[6];
-    memcpy(sqn_xor_ak, autn, sizeof(sqn_xor_ak));
+/**
+ * @brief Compute all authentication functions with the selected algorithm.
+ * @param[in] milenage Milenage parameters (which select the algorithm).
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number, or SQN ^ AK when sqn_concealed is true.
+ * @param[in] sqn_concealed If the SQN is concealed with AK.
+ * @param[in] amf Authentication management field.
+ * @param[out] vec Where all the outputs will be written.
+ */
+static void vec_get(milenage_st const *const milenage,
+                    uint8_t const rand[const 16], uint8_t const sqn[const 6],
+                    bool const sqn_concealed, uint8_t const amf[const 2],
+                    milenage_vec_st *const vec)
+{
+    switch (milenage->algo)
+    {
+    case MILENAGE_ALGO_TUAK:
+        tuak_all(milenage->tuak, rand, sqn, sqn_concealed, amf, vec);
+        break;
+    case MILENAGE_ALGO_XOR:
+        xor_all(milenage, rand, sqn, sqn_concealed, amf, vec);
+        break;
+    case MILENAGE_ALGO_MILENAGE:
+    default:
+        milenage_all(milenage, rand, sqn, sqn_concealed, amf, vec);
+        break;
+    }
+}
 
-    uint8_t ak[6];
-    f5(milenage, milenage->k, rand, ak);
+swicc_ret_et milenage(milenage_st *const milenage, uint8_t const rand[const 16],
+                      uint8_t const autn[const 16],
+                      uint8_t output[const SWICC_DATA_MAX],
+                      uint16_t *const output_len)
+{
+    log_st *const log = milenage->log;
+    if (milenage->algo == MILENAGE_ALGO_MILENAGE && !milenage->config_valid)
+    {
+        LOG_ERR(log,
+                "Milenage: refusing to authenticate with unvalidated parameters.");
+        *output_len = 0;
+        return SWICC_RET_ERROR;
+    }
 
-    /**
-     * TODO: Verify the sequence number per ETSI TS 133 102 V14.1.0
-     * clause.6.3.3.
-     */
-    uint8_t sqn[6];
-    xorv(ak, sqn_xor_ak, sizeof(ak), sqn);
+    milenage_cache_entry_st const *const cached =
+        cache_get(milenage, rand, autn);
+    if (cached != NULL)
+    {
+        memcpy(output, cached->rsp, sizeof(cached->rsp));
+        *output_len = sizeof(cached->rsp);
+        ++milenage->cache.hit;
+        LOG_DBG(log, "Milenage: answered a retransmitted challenge again.");
+        return SWICC_RET_SUCCESS;
+    }
+    ++milenage->cache.miss;
 
-    fprintf(stderr, "Milenage: SQN=%02X%02X%02X%02X%02X%02X.\n", sqn[0], sqn[1],
-            sqn[2], sqn[3], sqn[4], sqn[5]);
+    LOG_HEX(log, LOG_LVL_DBG, false, rand, 16U, "Milenage: RAND=");
+    LOG_HEX(log, LOG_LVL_DBG, false, autn, 16U, "Milenage: AUTN=");
 
     uint8_t amf[2];
     memcpy(amf, &autn[6], sizeof(amf));
 
-    fprintf(stderr, "Milenage: AMF=%02X%02X.\n", amf[0], amf[1]);
+    /* SQN ^ AK is the first part of AUTN. */
+    milenage_vec_st vec;
+    vec_get(milenage, rand, autn, true, amf, &vec);
+
+    LOG_HEX(log, LOG_LVL_DBG, false, vec.sqn, sizeof(vec.sqn),
+            "Milenage: SQN=");
+    LOG_HEX(log, LOG_LVL_DBG, false, amf, sizeof(amf), "Milenage: AMF=");
 
-    uint8_t xmac_a[8];
-    f1(milenage, milenage->k, rand, sqn, amf, xmac_a);
     uint8_t mac_a[8];
     memcpy(mac_a, &autn[8], sizeof(mac_a));
 
-    fprintf(stderr, "Mileage: XMACa=");
-    for (uint8_t i = 0; i < 8; ++i)
-    {
-        fprintf(stderr, "%02X", xmac_a[i]);
-    }
-    fprintf(stderr, ".\n");
-    fprintf(stderr, "Milenage: MACa=");
-    for (uint8_t i = 0; i < 8; ++i)
+    LOG_HEX(log, LOG_LVL_DBG, false, vec.mac_a, sizeof(vec.mac_a),
+            "Milenage: XMACa=");
+    LOG_HEX(log, LOG_LVL_DBG, false, mac_a, sizeof(mac_a), "Milenage: MACa=");
+
+    if (memcmp(vec.mac_a, mac_a, sizeof(vec.mac_a)) != 0)
     {
-        fprintf(stderr, "%02X", mac_a[i]);
+        LOG_HEX(log, LOG_LVL_WRN, false, vec.mac_a, sizeof(vec.mac_a),
+                "Milenage: failed to validate MAC from network xmac_a=");
+        *output_len = 0;
+        return SWICC_RET_ERROR;
     }
-    fprintf(stderr, ".\n");
 
     /**
-     * Response is per 3GPP TS 31.102 V17.5.0 clause.7.1.2.1 and clause.6.3.3.
+     * SQN is fresh if SEQ is higher than the one last accepted with the same
+     * IND and not too far ahead of the highest accepted one per 3GPP TS 33.102
+     * V17.0.0 Annex C.2.1 and C.2.2.
      */
-    if (memcmp(xmac_a, mac_a, sizeof(xmac_a)) == 0)
+    uint8_t *const sqn_array = sqn_array_get(milenage);
+    uint64_t const sqn = sqn_load(vec.sqn);
+    uint64_t const sqn_ms = sqn_load(&sqn_array[milenage->sqn_ms_ind * 6U]);
+    /* Safe cast since IND is only the lowest bits of SQN. */
+    uint8_t const ind = (uint8_t)(sqn & (MILENAGE_SQN_ARRAY_LEN - 1U));
+    uint64_t const seq = sqn >> MILENAGE_SQN_IND_LEN;
+    uint64_t const seq_ind =
+        sqn_load(&sqn_array[ind * 6U]) >> MILENAGE_SQN_IND_LEN;
+    uint64_t const seq_ms = sqn_ms >> MILENAGE_SQN_IND_LEN;
+    if (seq <= seq_ind || (seq > seq_ms && seq - seq_ms > MILENAGE_SQN_DELTA))
     {
-        uint8_t res[8];
-        f2(milenage, milenage->k, rand, res);
-
-        uint8_t ck[16];
-        f3(milenage, milenage->k, rand, ck);
-
-        uint8_t ik[16];
-        f4(milenage, milenage->k, rand, ik);
-
         /**
-         * GSM cipher key for UMTS-GSM interoperability purposes.
-         * The process of generating it, is called the "C3 conversion".
+         * Synchronization failure: AUTS = SQN_MS ^ AK* || MAC-S where MAC-S
+         * uses the dummy AMF of all zeros per 3GPP TS 33.102 V17.0.0
+         * clause.6.3.3.
          */
-        uint8_t kc[8];
-        uint8_t kc_tmp0[8];
-        uint8_t kc_tmp1[8];
-        xorv(ck, &ik[8], 8, kc_tmp0);
-        xorv(&ck[8], ik, 8, kc_tmp1);
-        xorv(kc_tmp0, kc_tmp1, 8, kc);
+        uint8_t const amf_resync[2] = {0x00, 0x00};
+        uint8_t sqn_ms_buf[6];
+        sqn_store(sqn_ms, sqn_ms_buf);
+        milenage_vec_st vec_resync;
+        vec_get(milenage, rand, sqn_ms_buf, false, amf_resync, &vec_resync);
 
         uint8_t i = 0;
-        output[i++] = 0xDB; /* "Successful 3G authentication" tag per 3GPP
-                               TS 31.102 V17.5.0 clause.7.1.2.1. */
-        output[i++] = sizeof(res);
-        memcpy(&output[i], res, sizeof(res));
-        i += sizeof(res);
+        output[i++] = 0xDC; /* "Synchronisation failure" tag per 3GPP TS
+                               31.102 V17.5.0 clause.7.1.2.1. */
+        output[i++] = 6 + sizeof(vec_resync.mac_s);
+        xorv(sqn_ms_buf, vec_resync.ak_star, 6, &output[i]);
+        i += 6;
+        memcpy(&output[i], vec_resync.mac_s, sizeof(vec_resync.mac_s));
+        i += sizeof(vec_resync.mac_s);
+
+        *output_len = i;
+        LOG_HEX(log, LOG_LVL_WRN, false, sqn_ms_buf, sizeof(sqn_ms_buf),
+                "Milenage: SQN is not fresh, resynchronizing with SQN_MS=");
+        return SWICC_RET_SUCCESS;
+    }
+    memcpy(&sqn_array[ind * 6U], vec.sqn, sizeof(vec.sqn));
+    if (sqn > sqn_ms)
+    {
+        milenage->sqn_ms_ind = ind;
+    }
 
-        output[i++] = sizeof(ck);
-        memcpy(&output[i], ck, sizeof(ck));
-        i += sizeof(ck);
+    /**
+     * Response is per 3GPP TS 31.102 V17.5.0 clause.7.1.2.1 and clause.6.3.3.
+     */
+    uint8_t i = 0;
+    output[i++] = 0xDB; /* "Successful 3G authentication" tag per 3GPP
+                           TS 31.102 V17.5.0 clause.7.1.2.1. */
+    output[i++] = sizeof(vec.res);
+    memcpy(&output[i], vec.res, sizeof(vec.res));
+    i += sizeof(vec.res);
 
-        output[i++] = sizeof(ik);
-        memcpy(&output[i], ik, sizeof(ik));
-        i += sizeof(ik);
+    output[i++] = sizeof(vec.ck);
+    memcpy(&output[i], vec.ck, sizeof(vec.ck));
+    i += sizeof(vec.ck);
 
-        output[i++] = sizeof(kc);
-        memcpy(&output[i], kc, sizeof(kc));
-        i += sizeof(kc);
+    output[i++] = sizeof(vec.ik);
+    memcpy(&output[i], vec.ik, sizeof(vec.ik));
+    i += sizeof(vec.ik);
 
-        *output_len = i;
-        fprintf(stderr, "Mileage: authenticated.\n");
-        fprintf(stderr, "Mileage: response=");
-        for (uint8_t j = 0; j < i; ++j)
-        {
-            fprintf(stderr, "%02X", output[j]);
-        }
-        fprintf(stderr, ".\n");
+    output[i++] = sizeof(vec.kc);
+    memcpy(&output[i], vec.kc, sizeof(vec.kc));
+    i += sizeof(vec.kc);
 
-        return SWICC_RET_SUCCESS;
+    *output_len = i;
+    LOG_DBG(log, "Milenage: authenticated.");
+
+    if (i == MILENAGE_RSP_LEN)
+    {
+        milenage_cache_entry_st *const entry =
+            &milenage->cache.entry[milenage->cache.next];
+        /* Safe cast since the index is less than MILENAGE_CACHE_LEN. */
+        milenage->cache.next =
+            (uint8_t)((milenage->cache.next + 1U) % MILENAGE_CACHE_LEN);
+        entry->valid = true;
+        memcpy(entry->rand, rand, sizeof(entry->rand));
+        memcpy(entry->autn, autn, sizeof(entry->autn));
+        memcpy(entry->sqn, vec.sqn, sizeof(entry->sqn));
+        memcpy(entry->rsp, output, sizeof(entry->rsp));
     }
-    else
+    LOG_HEX(log, LOG_LVL_DBG, true, output, i, "Milenage: response=");
+
+    if (milenage->snn_len > 0U && log_enabled(log, LOG_LVL_INF))
     {
-        fprintf(stderr, "Mileage: failed to validate MAC from network xmac_a=");
-        for (uint8_t i = 0; i < 8; ++i)
-        {
-            fprintf(stderr, "%02X", xmac_a[i]);
-        }
-        *output_len = 0;
-        return SWICC_RET_ERROR;
+        kdf_5g_st keys_5g;
+        kdf_5g_aka(vec.ck, vec.ik, vec.res, sizeof(vec.res), rand, autn,
+                   milenage->snn, milenage->snn_len, &keys_5g);
+        LOG_HEX(log, LOG_LVL_INF, false, keys_5g.res_star,
+                sizeof(keys_5g.res_star), "Milenage: 5G RES*=");
+        LOG_HEX(log, LOG_LVL_INF, true, keys_5g.kausf, sizeof(keys_5g.kausf),
+                "Milenage: 5G Kausf=");
+        LOG_HEX(log, LOG_LVL_INF, true, keys_5g.ck_prime,
+                sizeof(keys_5g.ck_prime), "Milenage: 5G CK'=");
+        LOG_HEX(log, LOG_LVL_INF, true, keys_5g.ik_prime,
+                sizeof(keys_5g.ik_prime), "Milenage: 5G IK'=");
     }
+
+    return SWICC_RET_SUCCESS;
 }
@@ -900,9 +900,9 @@ static swicc_ret_et proactive_cmd__tlv__capability_configuration_parameters(
 }
 
 static swicc_ret_et proactive_cmd(
-    swsim__proactive__command_st const *const command,
+    log_st *const log, swsim__proactive__command_st const *const command,
     uint8_t (*const command_buffer)[SWICC_DATA_MAX],
-    uint16_t *const command_length)
+    uint32_t *const command_length)
 {
     /* ETSI TS 101 220 V17.1.0 clause 7.2. */
     static uint8_t const tags[] = {
@@ -930,7 +930,7 @@ static swicc_ret_et proactive_cmd(
     {
         if (dry_run)
         {
-            fprintf(stderr, "Proactive UICC Command: Encoding dry run.\n");
+            LOG_DBG(log, "Proactive UICC Command: Encoding dry run.");
             bertlv_buf = NULL;
             bertlv_len = 0;
         }
@@ -942,8 +942,9 @@ static swicc_ret_et proactive_cmd(
             }
             bertlv_len = enc.len;
             bertlv_buf = command_buffer;
-            fprintf(stderr,
-                    "Proactive UICC Command: Encoding real run: len=%u.\n",
+            LOG_DBG(log,
+                    "Proactive UICC Command: Encoding real run: len=%" PRIu64
+                    ".",
                     bertlv_len);
         }
 
@@ -1249,12 +1250,8 @@ static swicc_ret_et proactive_cmd(
         /* Stop when finished with the real run (i.e. not dry run). */
         if (!dry_run)
         {
-            if (bertlv_len <= UINT16_MAX)
-            {
-                ret_bertlv = SWICC_RET_SUCCESS;
-                /* Safe cast since we check for type overflow in if. */
-                *command_length = (uint16_t)bertlv_len;
-            }
+            ret_bertlv = SWICC_RET_SUCCESS;
+            *command_length = bertlv_len;
             break;
         }
     }
@@ -1501,8 +1498,9 @@ static swicc_ret_et proactive_app_default__step(
 
         if (command_created)
         {
-            swicc_ret_et const ret = proactive_cmd(
-                &command, &proactive->command, &proactive->command_length);
+            swicc_ret_et const ret =
+                proactive_cmd(proactive->log, &command, &proactive->command,
+                              &proactive->command_length);
             if (ret == SWICC_RET_SUCCESS)
             {
                 // Screen has been selected.
@@ -1529,7 +1527,7 @@ sim__proactive__envelope_ft proactive_app_default__envelope;
 swicc_ret_et proactive_app_default__envelope(
     swsim__proactive_st *const proactive)
 {
-    fprintf(stderr, "Envelope: start parsing.\n");
+    LOG_DBG(proactive->log, "Envelope: start parsing.");
     static uint8_t const root_tag[] = {
         0xD3, /* 'D3': Menu Selection */
     };
@@ -1574,7 +1572,7 @@ swicc_ret_et proactive_app_default__envelope(
 
     if (ret_tag == SWICC_RET_SUCCESS)
     {
-        fprintf(stderr, "Envelope: tags created.\n");
+        LOG_DBG(proactive->log, "Envelope: tags created.");
 
         swicc_dato_bertlv_dec_st tlv_decoder;
         swicc_dato_bertlv_dec_init(&tlv_decoder, proactive->envelope,
@@ -1594,9 +1592,9 @@ swicc_ret_et proactive_app_default__envelope(
              tlv_root.len.form == SWICC_DATO_BERTLV_LEN_FORM_DEFINITE_LONG) &&
             tlv_root.tag.cla == SWICC_DATO_BERTLV_TAG_CLA_PRIVATE)
         {
-            fprintf(
-                stderr,
-                "Envelope: root tag has valid class and root has valid length format.\n");
+            LOG_DBG(
+                proactive->log,
+                "Envelope: root tag has valid class and root has valid length format.");
 
             for (uint32_t tag_i = 0; tag_i < root_tag_count; ++tag_i)
             {
@@ -1607,7 +1605,7 @@ swicc_ret_et proactive_app_default__envelope(
                     {
                     /* Menu Selection */
                     case 0: {
-                        fprintf(stderr, "Envelope menu selection.\n");
+                        LOG_DBG(proactive->log, "Envelope menu selection.");
                         swicc_dato_bertlv_dec_st tlv_decoder_device_identities;
                         swicc_dato_bertlv_st tlv_device_identities;
                         swicc_dato_bertlv_dec_st tlv_decoder_item_identifier;
@@ -1636,9 +1634,9 @@ swicc_ret_et proactive_app_default__envelope(
                             tlv_item_identifier.len.form ==
                                 SWICC_DATO_BERTLV_LEN_FORM_DEFINITE_SHORT)
                         {
-                            fprintf(
-                                stderr,
-                                "Envelope menu selection: extracted mandatory items.\n");
+                            LOG_DBG(
+                                proactive->log,
+                                "Envelope menu selection: extracted mandatory items.");
 
                             /**
                              * This field is optional so this decode may
@@ -1660,9 +1658,10 @@ swicc_ret_et proactive_app_default__envelope(
 
                             uint8_t const item_identifier =
                                 tlv_decoder_item_identifier.buf[0];
-                            fprintf(
-                                stderr,
-                                "Envelope menu selection: item identifier 0x%02X.\n",
+                            LOG_DBG(
+                                proactive->log,
+                                "Envelope menu selection: item identifier 0x%02" PRIX64
+                                ".",
                                 item_identifier);
                             if (item_identifier >= APP_DEFAULT__SCREEN__INVALID)
                             {
@@ -1811,7 +1810,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -1930,7 +1930,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -2038,7 +2039,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -2127,7 +2129,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -2243,7 +2246,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -2345,7 +2349,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -2452,7 +2457,8 @@ swicc_ret_et proactive_app_default__envelope(
                                         };
 
                                         swicc_ret_et const ret = proactive_cmd(
-                                            &command, &proactive->command,
+                                            proactive->log, &command,
+                                            &proactive->command,
                                             &proactive->command_length);
                                         if (ret == SWICC_RET_SUCCESS)
                                         {
@@ -2508,10 +2514,25 @@ void proactive_init(swsim__proactive_st *const proactive)
     proactive->app_proprietary = NULL;
     proactive->app_proprietary__step = NULL;
     proactive->app_proprietary__init = NULL;
+
+    /* The first step initializes the app. */
+    proactive->step_pending = true;
+}
+
+void proactive_wake(swsim__proactive_st *const proactive)
+{
+    proactive->step_pending = true;
 }
 
 swicc_ret_et proactive_step(swsim__proactive_st *const proactive)
 {
+    /* Nothing changed since the last step so no app has anything to do. */
+    if (!proactive->step_pending)
+    {
+        return SWICC_RET_SUCCESS;
+    }
+    proactive->step_pending = false;
+
     /* Initialize the default app in the very first step. */
     if (proactive->command_count == 0)
     {
@@ -1,5 +1,12 @@
 #include "rijndael.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#define RIJNDAEL_AESNI 1
+#include <immintrin.h>
+#else
+#define RIJNDAEL_AESNI 0
+#endif
+
 /* Rijndael S box table. */
 static uint8_t const sbox[256] = {
     99,  124, 119, 123, 242, 107, 111, 197, 48,  1,   103, 43,  254, 215, 171,
@@ -181,8 +188,15 @@ static void column_mix(uint8_t state[const 4][4])
     }
 }
 
-void rijndael_encrypt(rijndael_st *const rijndael,
-                      uint8_t const input[const 16], uint8_t output[const 16])
+/**
+ * @brief Reference (byte-oriented) implementation of the encryption function.
+ * @param[in] rijndael State of the rijndael block cipher.
+ * @param[in] input Input.
+ * @param[out] output Output.
+ */
+static void rijndael_encrypt_ref(rijndael_st const *const rijndael,
+                                 uint8_t const input[const 16],
+                                 uint8_t output[const 16])
 {
     uint8_t state[4][4];
 
@@ -217,7 +231,501 @@ void rijndael_encrypt(rijndael_st *const rijndael,
     return;
 }
 
+#if RIJNDAEL_AESNI
+/**
+ * @brief Implementation of the encryption function using the AES-NI
+ * instructions. Must only be called when the CPU supports them.
+ * @param[in] rijndael State of the rijndael block cipher.
+ * @param[in] input Input.
+ * @param[out] output Output.
+ */
+__attribute__((target("aes,sse2"))) static void rijndael_encrypt_aesni(
+    rijndael_st const *const rijndael, uint8_t const input[const 16],
+    uint8_t output[const 16])
+{
+    __m128i const *const round_keys =
+        (__m128i const *)rijndael->round_keys_bytes;
+    __m128i state = _mm_loadu_si128((__m128i const *)input);
+
+    state = _mm_xor_si128(state, _mm_load_si128(&round_keys[0]));
+    for (uint8_t r = 1; r < 10; ++r)
+    {
+        state = _mm_aesenc_si128(state, _mm_load_si128(&round_keys[r]));
+    }
+    state = _mm_aesenclast_si128(state, _mm_load_si128(&round_keys[10]));
+
+    _mm_storeu_si128((__m128i *)output, state);
+}
+#endif
+
+/**
+ * The bitsliced backend encrypts this many blocks at once. Bit j of byte i of
+ * block b is stored in bit (16 * b + i) of word j, so 8 64-bit words hold 4
+ * blocks.
+ */
+#define RIJNDAEL_BS_LANES 4U
+
+/* A 16-bit lane mask repeated for each of the bitsliced blocks. */
+#define RIJNDAEL_BS_MASK(m) ((uint64_t)(m) * UINT64_C(0x0001000100010001))
+
+/**
+ * @brief Transpose an 8x8 bit matrix where byte i is row i. Afterwards byte j
+ * holds bit j of every input byte.
+ * @param[in] x Matrix to transpose.
+ * @return Transposed matrix.
+ */
+static uint64_t bs_transpose8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7U)) & UINT64_C(0x00AA00AA00AA00AA);
+    x ^= t ^ (t << 7U);
+    t = (x ^ (x >> 14U)) & UINT64_C(0x0000CCCC0000CCCC);
+    x ^= t ^ (t << 14U);
+    t = (x ^ (x >> 28U)) & UINT64_C(0x00000000F0F0F0F0);
+    x ^= t ^ (t << 28U);
+    return x;
+}
+
+/**
+ * @brief Convert blocks to the bitsliced representation.
+ * @param[in] block Blocks to convert.
+ * @param[out] w Bitsliced blocks.
+ */
+static void bs_pack(uint8_t const *const block[const RIJNDAEL_BS_LANES],
+                    uint64_t w[const 8])
+{
+    for (uint8_t j = 0; j < 8; ++j)
+    {
+        w[j] = 0;
+    }
+    for (uint8_t b = 0; b < RIJNDAEL_BS_LANES; ++b)
+    {
+        for (uint8_t h = 0; h < 2; ++h)
+        {
+            uint64_t x = 0;
+            for (uint8_t k = 0; k < 8; ++k)
+            {
+                x |= (uint64_t)block[b][(8 * h) + k] << (8U * k);
+            }
+            x = bs_transpose8(x);
+            for (uint8_t j = 0; j < 8; ++j)
+            {
+                w[j] |= ((x >> (8U * j)) & 0xFF) << ((16U * b) + (8U * h));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Convert blocks from the bitsliced representation.
+ * @param[in] w Bitsliced blocks.
+ * @param[out] block Where the blocks will be written.
+ */
+static void bs_unpack(uint64_t const w[const 8],
+                      uint8_t *const block[const RIJNDAEL_BS_LANES])
+{
+    for (uint8_t b = 0; b < RIJNDAEL_BS_LANES; ++b)
+    {
+        for (uint8_t h = 0; h < 2; ++h)
+        {
+            uint64_t x = 0;
+            for (uint8_t j = 0; j < 8; ++j)
+            {
+                x |= ((w[j] >> ((16U * b) + (8U * h))) & 0xFF) << (8U * j);
+            }
+            x = bs_transpose8(x);
+            for (uint8_t k = 0; k < 8; ++k)
+            {
+                /* Safe cast since the value is masked to 8 bits. */
+                block[b][(8 * h) + k] = (uint8_t)((x >> (8U * k)) & 0xFF);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Reduce a bitsliced polynomial of degree up to 14 modulo the Rijndael
+ * polynomial x^8 + x^4 + x^3 + x + 1.
+ * @param[in, out] p Polynomial to reduce.
+ * @param[out] r Reduced polynomial.
+ */
+static void bs_gf_reduce(uint64_t p[const 15], uint64_t r[const 8])
+{
+    for (uint8_t k = 14; k >= 8; --k)
+    {
+        p[k - 8] ^= p[k];
+        p[k - 7] ^= p[k];
+        p[k - 5] ^= p[k];
+        p[k - 4] ^= p[k];
+    }
+    for (uint8_t k = 0; k < 8; ++k)
+    {
+        r[k] = p[k];
+    }
+}
+
+/**
+ * @brief Multiply bitsliced bytes in GF(2^8).
+ * @param[in] a
+ * @param[in] b
+ * @param[out] r Product of a and b.
+ */
+static void bs_gf_mul(uint64_t const a[const 8], uint64_t const b[const 8],
+                      uint64_t r[const 8])
+{
+    uint64_t p[15] = {0};
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        for (uint8_t j = 0; j < 8; ++j)
+        {
+            p[i + j] ^= a[i] & b[j];
+        }
+    }
+    bs_gf_reduce(p, r);
+}
+
+/**
+ * @brief Square bitsliced bytes in GF(2^8). This is linear so it is much
+ * cheaper than a general multiplication.
+ * @param[in] a
+ * @param[out] r Square of a.
+ */
+static void bs_gf_sqr(uint64_t const a[const 8], uint64_t r[const 8])
+{
+    uint64_t p[15] = {0};
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        p[2 * i] = a[i];
+    }
+    bs_gf_reduce(p, r);
+}
+
+/**
+ * @brief Byte substitution transformation on bitsliced blocks. The S-box is
+ * computed (inversion as x^254 followed by the affine transformation) instead
+ * of looked up so it runs in constant time.
+ * @param[in, out] s Bitsliced blocks.
+ */
+static void bs_byte_sub(uint64_t s[const 8])
+{
+    uint64_t x2[8], x3[8], x12[8], x14[8], x15[8], t[8], inv[8];
+
+    bs_gf_sqr(s, x2);
+    bs_gf_mul(x2, s, x3);
+    bs_gf_sqr(x3, t);
+    bs_gf_sqr(t, x12);
+    bs_gf_mul(x12, x3, x15);
+    bs_gf_mul(x12, x2, x14);
+
+    /* x^240 = (x^15)^16 */
+    bs_gf_sqr(x15, t);
+    bs_gf_sqr(t, inv);
+    bs_gf_sqr(inv, t);
+    bs_gf_sqr(t, inv);
+
+    /* x^254 = x^240 * x^14 */
+    bs_gf_mul(inv, x14, t);
+
+    /* Affine transformation with constant 0x63. */
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        s[i] = t[i] ^ t[(i + 4) % 8] ^ t[(i + 5) % 8] ^ t[(i + 6) % 8] ^
+               t[(i + 7) % 8];
+    }
+    s[0] = ~s[0];
+    s[1] = ~s[1];
+    s[5] = ~s[5];
+    s[6] = ~s[6];
+}
+
+/**
+ * @brief Row shift transformation on bitsliced blocks.
+ * @param[in, out] s Bitsliced blocks.
+ */
+static void bs_row_shift(uint64_t s[const 8])
+{
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        uint64_t const w = s[i];
+        s[i] = (w & RIJNDAEL_BS_MASK(0x1111)) |
+               ((w & RIJNDAEL_BS_MASK(0x2220)) >> 4U) |
+               ((w & RIJNDAEL_BS_MASK(0x0002)) << 12U) |
+               ((w & RIJNDAEL_BS_MASK(0x4400)) >> 8U) |
+               ((w & RIJNDAEL_BS_MASK(0x0044)) << 8U) |
+               ((w & RIJNDAEL_BS_MASK(0x8000)) >> 12U) |
+               ((w & RIJNDAEL_BS_MASK(0x0888)) << 4U);
+    }
+}
+
+/**
+ * @brief Rotate the rows of every column of bitsliced blocks.
+ * @param[in] w One word of bitsliced blocks.
+ * @param[in] n Number of rows to rotate by (1 to 3).
+ * @return Word where row r holds what was in row (r + n) % 4.
+ */
+static uint64_t bs_column_rot(uint64_t const w, uint8_t const n)
+{
+    uint64_t const nibble = UINT64_C(0x1111111111111111);
+    uint64_t const mask_lo = ((UINT64_C(1) << (4U - n)) - 1U) * nibble;
+    return ((w >> n) & mask_lo) | ((w << (4U - n)) & ~mask_lo);
+}
+
+/**
+ * @brief Mix column transformation on bitsliced blocks.
+ * @param[in, out] s Bitsliced blocks.
+ */
+static void bs_column_mix(uint64_t s[const 8])
+{
+    uint64_t rot1[8];
+    uint64_t t[8];
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        rot1[i] = bs_column_rot(s[i], 1);
+        t[i] = s[i] ^ rot1[i];
+    }
+
+    /* 2 * (a[r] ^ a[r + 1]) */
+    uint64_t const x[8] = {
+        t[7], t[0] ^ t[7], t[1], t[2] ^ t[7], t[3] ^ t[7], t[4], t[5], t[6],
+    };
+
+    /* 2 * a[r] ^ 3 * a[r + 1] ^ a[r + 2] ^ a[r + 3] */
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        s[i] = x[i] ^ rot1[i] ^ bs_column_rot(s[i], 2) ^
+               bs_column_rot(s[i], 3);
+    }
+}
+
+/**
+ * @brief Bitsliced implementation of the encryption function which encrypts
+ * several blocks, each under its own key, at once.
+ * @param[in] rijndael State of the rijndael block cipher for each block.
+ * @param[in] input Inputs.
+ * @param[out] output Outputs.
+ */
+static void rijndael_encrypt_bs(
+    rijndael_st const *const rijndael[const RIJNDAEL_BS_LANES],
+    uint8_t const *const input[const RIJNDAEL_BS_LANES],
+    uint8_t *const output[const RIJNDAEL_BS_LANES])
+{
+    uint64_t state[8];
+    uint64_t round_key[8];
+    uint8_t const *round_key_block[RIJNDAEL_BS_LANES];
+
+    bs_pack(input, state);
+    for (uint8_t r = 0; r <= 10; r++)
+    {
+        if (r > 0)
+        {
+            bs_byte_sub(state);
+            bs_row_shift(state);
+            if (r <= 9)
+            {
+                bs_column_mix(state);
+            }
+        }
+
+        for (uint8_t b = 0; b < RIJNDAEL_BS_LANES; ++b)
+        {
+            round_key_block[b] = rijndael[b]->round_keys_bytes[r];
+        }
+        bs_pack(round_key_block, round_key);
+        for (uint8_t i = 0; i < 8; ++i)
+        {
+            state[i] ^= round_key[i];
+        }
+    }
+    bs_unpack(state, output);
+}
+
+/**
+ * @brief Portable multi-block encryption using the bitsliced implementation.
+ * @param[in] states State of the rijndael block cipher for each block.
+ * @param[in] in Inputs.
+ * @param[out] out Outputs.
+ * @param[in] n Number of blocks.
+ */
+static void rijndael_encrypt_xN_bs(rijndael_st const *const states[const],
+                                   uint8_t const in[const][16],
+                                   uint8_t out[const][16], uint32_t const n)
+{
+    for (uint32_t i = 0; i < n; i += RIJNDAEL_BS_LANES)
+    {
+        rijndael_st const *lane_state[RIJNDAEL_BS_LANES];
+        uint8_t const *lane_in[RIJNDAEL_BS_LANES];
+        uint8_t *lane_out[RIJNDAEL_BS_LANES];
+        uint8_t pad[16];
+
+        /* Unused lanes repeat the first block and their output is dropped. */
+        for (uint8_t b = 0; b < RIJNDAEL_BS_LANES; ++b)
+        {
+            bool const used = i + b < n;
+            lane_state[b] = states[used ? i + b : i];
+            lane_in[b] = in[used ? i + b : i];
+            lane_out[b] = used ? out[i + b] : pad;
+        }
+        rijndael_encrypt_bs(lane_state, lane_in, lane_out);
+    }
+}
+
+#if RIJNDAEL_AESNI
+/**
+ * @brief Multi-block encryption using AES-NI. Independent blocks are
+ * interleaved so the AESENC latency is hidden. Must only be called when the CPU
+ * supports AES-NI.
+ * @param[in] states State of the rijndael block cipher for each block.
+ * @param[in] in Inputs.
+ * @param[out] out Outputs.
+ * @param[in] n Number of blocks.
+ */
+__attribute__((target("aes,sse2"))) static void rijndael_encrypt_xN_aesni(
+    rijndael_st const *const states[const], uint8_t const in[const][16],
+    uint8_t out[const][16], uint32_t const n)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i const *round_keys[4];
+        __m128i state[4];
+        for (uint8_t b = 0; b < 4; ++b)
+        {
+            round_keys[b] = (__m128i const *)states[i + b]->round_keys_bytes;
+            state[b] = _mm_xor_si128(
+                _mm_loadu_si128((__m128i const *)in[i + b]),
+                _mm_load_si128(&round_keys[b][0]));
+        }
+        for (uint8_t r = 1; r < 10; ++r)
+        {
+            for (uint8_t b = 0; b < 4; ++b)
+            {
+                state[b] = _mm_aesenc_si128(state[b],
+                                            _mm_load_si128(&round_keys[b][r]));
+            }
+        }
+        for (uint8_t b = 0; b < 4; ++b)
+        {
+            state[b] = _mm_aesenclast_si128(
+                state[b], _mm_load_si128(&round_keys[b][10]));
+            _mm_storeu_si128((__m128i *)out[i + b], state[b]);
+        }
+    }
+    for (; i < n; ++i)
+    {
+        rijndael_encrypt_aesni(states[i], in[i], out[i]);
+    }
+}
+
+/**
+ * @brief Multi-block encryption using VAES on 256-bit registers (2 blocks per
+ * register). Must only be called when the CPU supports VAES and AVX2.
+ * @param[in] states State of the rijndael block cipher for each block.
+ * @param[in] in Inputs.
+ * @param[out] out Outputs.
+ * @param[in] n Number of blocks.
+ */
+__attribute__((target("vaes,avx2,aes"))) static void rijndael_encrypt_xN_vaes(
+    rijndael_st const *const states[const], uint8_t const in[const][16],
+    uint8_t out[const][16], uint32_t const n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i const *round_keys[8];
+        __m256i state[4];
+        for (uint8_t b = 0; b < 8; ++b)
+        {
+            round_keys[b] = (__m128i const *)states[i + b]->round_keys_bytes;
+        }
+        for (uint8_t p = 0; p < 4; ++p)
+        {
+            state[p] = _mm256_xor_si256(
+                _mm256_loadu_si256((__m256i const *)in[i + (2U * p)]),
+                _mm256_set_m128i(_mm_load_si128(&round_keys[(2 * p) + 1][0]),
+                                 _mm_load_si128(&round_keys[2 * p][0])));
+        }
+        for (uint8_t r = 1; r < 10; ++r)
+        {
+            for (uint8_t p = 0; p < 4; ++p)
+            {
+                state[p] = _mm256_aesenc_epi128(
+                    state[p],
+                    _mm256_set_m128i(
+                        _mm_load_si128(&round_keys[(2 * p) + 1][r]),
+                        _mm_load_si128(&round_keys[2 * p][r])));
+            }
+        }
+        for (uint8_t p = 0; p < 4; ++p)
+        {
+            state[p] = _mm256_aesenclast_epi128(
+                state[p],
+                _mm256_set_m128i(_mm_load_si128(&round_keys[(2 * p) + 1][10]),
+                                 _mm_load_si128(&round_keys[2 * p][10])));
+            _mm256_storeu_si256((__m256i *)out[i + (2U * p)], state[p]);
+        }
+    }
+    rijndael_encrypt_xN_aesni(&states[i], &in[i], &out[i], n - i);
+}
+#endif
+
+/**
+ * Encryption backend. The reference implementation is used unless the CPU has
+ * a faster alternative, which is checked once at startup.
+ */
+static void (*rijndael_encrypt_backend)(rijndael_st const *const rijndael,
+                                        uint8_t const input[const 16],
+                                        uint8_t output[const 16]) =
+    rijndael_encrypt_ref;
+
+/* Multi-block encryption backend, selected the same way. */
+static void (*rijndael_encrypt_xN_backend)(
+    rijndael_st const *const states[const], uint8_t const in[const][16],
+    uint8_t out[const][16], uint32_t const n) = rijndael_encrypt_xN_bs;
+
+/**
+ * @brief Select the fastest encryption backend supported by the CPU (using
+ * CPUID). Runs once before main.
+ */
+__attribute__((constructor)) static void rijndael_backend_select(void)
+{
+#if RIJNDAEL_AESNI
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("sse2"))
+    {
+        rijndael_encrypt_backend = rijndael_encrypt_aesni;
+        rijndael_encrypt_xN_backend = rijndael_encrypt_xN_aesni;
+        if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx2"))
+        {
+            rijndael_encrypt_xN_backend = rijndael_encrypt_xN_vaes;
+        }
+    }
+#endif
+}
+
+void rijndael_encrypt(rijndael_st const *const rijndael,
+                      uint8_t const input[const 16], uint8_t output[const 16])
+{
+    rijndael_encrypt_backend(rijndael, input, output);
+}
+
+void rijndael_encrypt_xN(rijndael_st const *const states[const],
+                         uint8_t const in[const][16], uint8_t out[const][16],
+                         uint32_t const n)
+{
+    rijndael_encrypt_xN_backend(states, in, out, n);
+}
+
 void rijndael_init(rijndael_st *const rijndael, uint8_t const key[const 16])
 {
     rijndael_key_schedule(rijndael, key);
+
+    /* Keep a copy of the round keys in input byte order for AES-NI. */
+    for (uint8_t r = 0; r < 11; ++r)
+    {
+        for (uint8_t i = 0; i < 16; ++i)
+        {
+            rijndael->round_keys_bytes[r][i] =
+                rijndael->round_keys[r][i & 0x03][i >> 2];
+        }
+    }
 }
@@ -10,6 +10,9 @@ int32_t swsim_init(swsim_st *const swsim_state, swicc_st *const swicc_state,
     memset(swsim_state, 0U, sizeof(*swsim_state));
     memset(swicc_state, 0U, sizeof(*swicc_state));
     swicc_state->userdata = swsim_state;
+    swsim_state->swicc_state = swicc_state;
+    log_init(&swsim_state->log, LOG_LVL_INF, false);
+    swsim_state->gsm_algo = GSM_ALGO_COMP128_1;
 
     {
         milenage_st milenage_init = {
@@ -41,6 +44,28 @@ int32_t swsim_init(swsim_st *const swsim_state, swicc_st *const swicc_state,
                   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07},
         };
         memcpy(&swsim_state->milenage, &milenage_init, sizeof(milenage_init));
+        swsim_state->milenage.log = &swsim_state->log;
+        milenage_k_set(&swsim_state->milenage, milenage_init.k);
+        if (milenage_config_validate(&swsim_state->milenage) !=
+            SWICC_RET_SUCCESS)
+        {
+            fprintf(stderr, "Milenage parameters are invalid.\n");
+            return -1;
+        }
+    }
+
+    {
+        /**
+         * TUAK shares K with Milenage and uses a zero TOP until a manifest
+         * provisions its own K, TOP, or TOPc. It only gets used once selected
+         * with milenage.algo.
+         */
+        uint8_t const top[32] = {0};
+        swsim_state->tuak.iter = 1U;
+        tuak_k_set(&swsim_state->tuak, swsim_state->milenage.k,
+                   sizeof(swsim_state->milenage.k));
+        tuak_top_set(&swsim_state->tuak, top);
+        swsim_state->milenage.tuak = &swsim_state->tuak;
     }
 
     swicc_disk_st disk = {0};
@@ -56,7 +81,12 @@ int32_t swsim_init(swsim_st *const swsim_state, swicc_st *const swicc_state,
 
     if (ret_disk == SWICC_RET_SUCCESS)
     {
-        if (path_swicc == NULL ||
+        /**
+         * A loaded disk is already in the file so it is only saved when it
+         * was generated, which keeps instances loading the same file in
+         * parallel from writing it.
+         */
+        if (path_json == NULL || path_swicc == NULL ||
             swicc_disk_save(&disk, path_swicc) == SWICC_RET_SUCCESS)
         {
             if (swicc_fs_disk_mount(swicc_state, &disk) == SWICC_RET_SUCCESS)
@@ -64,7 +94,8 @@ int32_t swsim_init(swsim_st *const swsim_state, swicc_st *const swicc_state,
                 if (swicc_apduh_pro_register(swicc_state, sim_apduh_demux) ==
                     SWICC_RET_SUCCESS)
                 {
-                    proactive_init(swicc_state->userdata);
+                    proactive_init(&swsim_state->proactive);
+                    swsim_state->proactive.log = &swsim_state->log;
                     return 0;
                 }
                 else
@@ -91,3 +122,141 @@ int32_t swsim_init(swsim_st *const swsim_state, swicc_st *const swicc_state,
     }
     return -1;
 }
+
+/**
+ * @brief Exchange one command TPDU with the card through the APDU dispatch of
+ * swICC, the same one its network client uses, which tries sim_apduh_demux
+ * first and the interindustry handlers of swICC after it. When a handler asks
+ * for the command data with ACK ALL, it gets the data in a second call like it
+ * would from a T=0 transport.
+ * @param[in, out] swsim_state
+ * @param[in, out] hdr Header of the command.
+ * @param[in] p3
+ * @param[in] data Command data, sent only if the handler asks for it.
+ * @param[in] data_len Length of the command data.
+ * @param[out] res Response of the card.
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t swsim_tpdu_transact(swsim_st *const swsim_state,
+                                   swicc_apdu_cmd_hdr_st *const hdr,
+                                   uint8_t const p3, uint8_t const *const data,
+                                   uint8_t const data_len,
+                                   swicc_apdu_res_st *const res)
+{
+    uint8_t p3_cmd = p3;
+    swicc_apdu_data_st data_cmd = {.len = 0U};
+    swicc_apdu_cmd_st cmd = {
+        .hdr = hdr,
+        .p3 = &p3_cmd,
+        .data = &data_cmd,
+    };
+    for (uint32_t procedure_count = 0U; procedure_count < 2U;
+         ++procedure_count)
+    {
+        res->data.len = 0U;
+        swicc_ret_et const ret = swicc_apdu_demux(
+            swsim_state->swicc_state, &cmd, res, procedure_count);
+        if (ret != SWICC_RET_SUCCESS)
+        {
+            return -1;
+        }
+        if (res->sw1 != SWICC_APDU_SW1_PROC_ACK_ALL)
+        {
+            return 0;
+        }
+        if (data_len > 0U)
+        {
+            memcpy(data_cmd.b, data, data_len);
+        }
+        data_cmd.len = data_len;
+    }
+    /* Asking for the data again after getting it is a handler error. */
+    return -1;
+}
+
+int32_t swsim_apdu_transact(swsim_st *const swsim_state,
+                            uint8_t const *const cmd, uint32_t const cmd_len,
+                            uint8_t *const rsp, uint32_t *const rsp_len)
+{
+    /* Cases of a short command per ISO/IEC 7816-3:2006 clause.12.1.3. */
+    uint8_t p3 = 0U;
+    uint8_t const *data = NULL;
+    uint8_t data_len = 0U;
+    if (cmd_len < 4U || *rsp_len < 2U)
+    {
+        return -1;
+    }
+    else if (cmd_len == 5U)
+    {
+        p3 = cmd[4U]; /* Le */
+    }
+    else if (cmd_len > 5U)
+    {
+        data_len = cmd[4U]; /* Lc */
+        if (data_len == 0U ||
+            (cmd_len != 5U + data_len && cmd_len != 6U + data_len))
+        {
+            return -1;
+        }
+        p3 = data_len;
+        data = &cmd[5U];
+    }
+
+    swicc_apdu_cmd_hdr_st hdr = {
+        .cla = sim_apdu_cmd_cla_parse(cmd[0U]),
+        .ins = cmd[1U],
+        .p1 = cmd[2U],
+        .p2 = cmd[3U],
+    };
+    swicc_apdu_res_st res;
+    if (swsim_tpdu_transact(swsim_state, &hdr, p3, data, data_len, &res) != 0)
+    {
+        return -1;
+    }
+    if (res.sw1 == SWICC_APDU_SW1_CHER_LE && data_len == 0U)
+    {
+        /* Wrong Le so resend the command with the one of SW2. */
+        hdr.cla = sim_apdu_cmd_cla_parse(cmd[0U]);
+        if (swsim_tpdu_transact(swsim_state, &hdr, res.sw2, NULL, 0U, &res) !=
+            0)
+        {
+            return -1;
+        }
+    }
+
+    uint32_t len = 0U;
+    for (bool res_get = false;; res_get = true)
+    {
+        if (res.data.len > *rsp_len - 2U - len)
+        {
+            return -1;
+        }
+        memcpy(&rsp[len], res.data.b, res.data.len);
+        len += res.data.len;
+        if (res.sw1 != SWICC_APDU_SW1_NORM_BYTES_AVAILABLE && res.sw1 != 0x9F)
+        {
+            break;
+        }
+        if (res_get && res.data.len == 0U)
+        {
+            /* More data was announced but none was given. */
+            return -1;
+        }
+
+        /* Get all that is available, SW2 of 00 stands for 256 bytes. */
+        swicc_apdu_cmd_hdr_st hdr_res_get = {
+            .cla = sim_apdu_cmd_cla_parse(cmd[0U]),
+            .ins = 0xC0, /* GET RESPONSE */
+        };
+        if (swsim_tpdu_transact(swsim_state, &hdr_res_get, res.sw2, NULL, 0U,
+                                &res) != 0)
+        {
+            return -1;
+        }
+    }
+    /* Safe cast since status SW1 values are the SW1 bytes. */
+    rsp[len++] = (uint8_t)res.sw1;
+    rsp[len++] = res.sw2;
+    *rsp_len = len;
+    return 0;
+}
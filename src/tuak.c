@@ -0,0 +1,328 @@
+#include "tuak.h"
+#include <endian.h>
+#include <string.h>
+
+/**
+ * Values of INSTANCE per ETSI TS 135 231 V17.0.0 clause.6. The top 2 bits
+ * select the function, the middle bits encode the output lengths used here
+ * (64-bit MAC, 64-bit RES, 128-bit CK and IK), and the lowest bit is set for
+ * 256-bit keys.
+ */
+#define TUAK_INSTANCE_TOPC 0x00
+#define TUAK_INSTANCE_F1 0x08
+#define TUAK_INSTANCE_F1STAR 0x88
+#define TUAK_INSTANCE_F2345 0x48
+#define TUAK_INSTANCE_F5STAR 0xC0
+#define TUAK_INSTANCE_K256 0x01
+
+/* Byte offsets of the fields in INcore and OUTcore. */
+#define TUAK_POS_TOP 0U
+#define TUAK_POS_INSTANCE 32U
+#define TUAK_POS_ALGONAME 33U
+#define TUAK_POS_RAND 40U
+#define TUAK_POS_AMF 56U
+#define TUAK_POS_SQN 58U
+#define TUAK_POS_KEY 64U
+#define TUAK_POS_PAD_FIRST 96U
+#define TUAK_POS_PAD_LAST 135U
+#define TUAK_POS_MAC 0U
+#define TUAK_POS_RES 0U
+#define TUAK_POS_CK 32U
+#define TUAK_POS_IK 64U
+#define TUAK_POS_AK 96U
+
+/**
+ * @brief Write a field into INcore. TS 135 231 numbers the bits of INcore from
+ * the start of the Keccak state while the fields are numbered from their MSB,
+ * so each field is stored with its bytes in reverse order.
+ * @param[out] incore Input of the permutation as a byte string.
+ * @param[in] pos Byte offset of the field.
+ * @param[in] data Field (big-endian).
+ * @param[in] len Length of the field in bytes.
+ */
+static void incore_push(uint8_t incore[const KECCAK_STATE_LANES * 8U],
+                        uint32_t const pos, uint8_t const *const data,
+                        uint32_t const len)
+{
+    for (uint32_t i = 0U; i < len; ++i)
+    {
+        incore[pos + i] = data[len - 1U - i];
+    }
+}
+
+/**
+ * @brief Read a field from OUTcore, the inverse of incore_push.
+ * @param[in] outcore Output of the permutation as a byte string.
+ * @param[in] pos Byte offset of the field.
+ * @param[out] data Field (big-endian).
+ * @param[in] len Length of the field in bytes.
+ */
+static void outcore_pull(uint8_t const outcore[const KECCAK_STATE_LANES * 8U],
+                         uint32_t const pos, uint8_t *const data,
+                         uint32_t const len)
+{
+    for (uint32_t i = 0U; i < len; ++i)
+    {
+        data[len - 1U - i] = outcore[pos + i];
+    }
+}
+
+/**
+ * @brief Create the parts of INcore which all TUAK functions share: TOP or
+ * TOPc, INSTANCE, ALGONAME, KEY, and the padding.
+ * @param[in] tuak TUAK parameters.
+ * @param[in] top TOP (when computing TOPc) or TOPc.
+ * @param[in] instance INSTANCE of the function (without the key length bit).
+ * @param[out] incore Input of the permutation as a byte string.
+ */
+static void incore_init(tuak_st const *const tuak, uint8_t const top[const 32],
+                        uint8_t const instance,
+                        uint8_t incore[const KECCAK_STATE_LANES * 8U])
+{
+    memset(incore, 0U, KECCAK_STATE_LANES * 8U);
+    incore_push(incore, TUAK_POS_TOP, top, 32U);
+    /* Safe cast since both values fit in a byte. */
+    incore[TUAK_POS_INSTANCE] =
+        (uint8_t)(instance | (tuak->k_len == 32U ? TUAK_INSTANCE_K256 : 0U));
+    incore_push(incore, TUAK_POS_ALGONAME, (uint8_t const *)TUAK_ALGONAME,
+                sizeof(TUAK_ALGONAME) - 1U);
+    /* A 128-bit key is zero-extended to 256 bits. */
+    incore_push(incore, TUAK_POS_KEY, tuak->k, tuak->k_len);
+    incore[TUAK_POS_PAD_FIRST] = 0x1F;
+    incore[TUAK_POS_PAD_LAST] = 0x80;
+}
+
+/**
+ * @brief Load a byte string into the lanes of a Keccak state.
+ * @param[in] bytes
+ * @param[out] state
+ */
+static void state_load(uint8_t const bytes[const KECCAK_STATE_LANES * 8U],
+                       uint64_t state[const KECCAK_STATE_LANES])
+{
+    for (uint32_t i = 0U; i < KECCAK_STATE_LANES; ++i)
+    {
+        uint64_t lane;
+        memcpy(&lane, &bytes[i * 8U], sizeof(lane));
+        state[i] = le64toh(lane);
+    }
+}
+
+/**
+ * @brief Store the lanes of a Keccak state as a byte string.
+ * @param[in] state
+ * @param[out] bytes
+ */
+static void state_store(uint64_t const state[const KECCAK_STATE_LANES],
+                        uint8_t bytes[const KECCAK_STATE_LANES * 8U])
+{
+    for (uint32_t i = 0U; i < KECCAK_STATE_LANES; ++i)
+    {
+        uint64_t const lane = htole64(state[i]);
+        memcpy(&bytes[i * 8U], &lane, sizeof(lane));
+    }
+}
+
+/**
+ * @brief Apply the TUAK core permutation (Keccak-f[1600] repeated iter times)
+ * to many states. The repetitions all states have in common are done together.
+ * @param[in, out] state States to permute.
+ * @param[in] iter Number of repetitions for each state.
+ * @param[in] n Number of states.
+ */
+static void core_xN(uint64_t state[const][KECCAK_STATE_LANES],
+                    uint8_t const iter[const], uint32_t const n)
+{
+    uint8_t iter_min = UINT8_MAX;
+    for (uint32_t i = 0U; i < n; ++i)
+    {
+        iter_min = iter[i] < iter_min ? iter[i] : iter_min;
+    }
+    for (uint8_t r = 0U; r < iter_min; ++r)
+    {
+        keccak_f1600_xN(state, n);
+    }
+    for (uint32_t i = 0U; i < n; ++i)
+    {
+        for (uint8_t r = iter_min; r < iter[i]; ++r)
+        {
+            keccak_f1600(state[i]);
+        }
+    }
+}
+
+/**
+ * @brief Create the input of f1 or f1* per ETSI TS 135 231 V17.0.0
+ * clause.6.3 and clause.6.4.
+ * @param[in] tuak TUAK parameters.
+ * @param[in] instance INSTANCE of f1 or f1*.
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number.
+ * @param[in] amf Authentication management field.
+ * @param[out] state Input of the permutation.
+ */
+static void f11star_in(tuak_st const *const tuak, uint8_t const instance,
+                       uint8_t const rand[const 16], uint8_t const sqn[const 6],
+                       uint8_t const amf[const 2],
+                       uint64_t state[const KECCAK_STATE_LANES])
+{
+    uint8_t incore[KECCAK_STATE_LANES * 8U];
+    incore_init(tuak, tuak->top_c, instance, incore);
+    incore_push(incore, TUAK_POS_RAND, rand, 16U);
+    incore_push(incore, TUAK_POS_AMF, amf, 2U);
+    incore_push(incore, TUAK_POS_SQN, sqn, 6U);
+    state_load(incore, state);
+}
+
+/**
+ * @brief Create the input of f2-f5 or f5* per ETSI TS 135 231 V17.0.0
+ * clause.6.5 and clause.6.6.
+ * @param[in] tuak TUAK parameters.
+ * @param[in] instance INSTANCE of f2-f5 or f5*.
+ * @param[in] rand Random challenge.
+ * @param[out] state Input of the permutation.
+ */
+static void f2345_in(tuak_st const *const tuak, uint8_t const instance,
+                     uint8_t const rand[const 16],
+                     uint64_t state[const KECCAK_STATE_LANES])
+{
+    uint8_t incore[KECCAK_STATE_LANES * 8U];
+    incore_init(tuak, tuak->top_c, instance, incore);
+    incore_push(incore, TUAK_POS_RAND, rand, 16U);
+    state_load(incore, state);
+}
+
+/**
+ * @brief Extract RES, CK, IK, and AK from the output of f2-f5, and unconceal
+ * the SQN with AK.
+ * @param[in] state Output of the permutation.
+ * @param[in] sqn Sequence number (concealed or not).
+ * @param[in] sqn_concealed If the SQN is concealed with AK.
+ * @param[out] vec
+ */
+static void f2345_out(uint64_t const state[const KECCAK_STATE_LANES],
+                      uint8_t const sqn[const 6], bool const sqn_concealed,
+                      milenage_vec_st *const vec)
+{
+    uint8_t outcore[KECCAK_STATE_LANES * 8U];
+    state_store(state, outcore);
+    outcore_pull(outcore, TUAK_POS_RES, vec->res, sizeof(vec->res));
+    outcore_pull(outcore, TUAK_POS_CK, vec->ck, sizeof(vec->ck));
+    outcore_pull(outcore, TUAK_POS_IK, vec->ik, sizeof(vec->ik));
+    outcore_pull(outcore, TUAK_POS_AK, vec->ak, sizeof(vec->ak));
+    for (uint32_t i = 0U; i < sizeof(vec->sqn); ++i)
+    {
+        /* Safe cast since XOR of 2 bytes is a byte. */
+        vec->sqn[i] = (uint8_t)(sqn_concealed ? sqn[i] ^ vec->ak[i] : sqn[i]);
+    }
+}
+
+/**
+ * @brief Extract MAC-A, MAC-S, and AK* from the outputs of f1, f1*, and f5*,
+ * and compute Kc with the C3 conversion.
+ * @param[in] state Outputs of f1, f1*, and f5* (in this order).
+ * @param[out] vec
+ */
+static void f11star5star_out(uint64_t const state[const 3U][KECCAK_STATE_LANES],
+                             milenage_vec_st *const vec)
+{
+    uint8_t outcore[KECCAK_STATE_LANES * 8U];
+    state_store(state[0U], outcore);
+    outcore_pull(outcore, TUAK_POS_MAC, vec->mac_a, sizeof(vec->mac_a));
+    state_store(state[1U], outcore);
+    outcore_pull(outcore, TUAK_POS_MAC, vec->mac_s, sizeof(vec->mac_s));
+    state_store(state[2U], outcore);
+    outcore_pull(outcore, TUAK_POS_AK, vec->ak_star, sizeof(vec->ak_star));
+
+    /* Kc = CK1 ^ CK2 ^ IK1 ^ IK2 per 3GPP TS 33.102 V17.0.0 clause.6.8.1.2. */
+    for (uint32_t i = 0U; i < sizeof(vec->kc); ++i)
+    {
+        /* Safe cast since XOR of bytes is a byte. */
+        vec->kc[i] = (uint8_t)(vec->ck[i] ^ vec->ck[i + 8U] ^ vec->ik[i] ^
+                               vec->ik[i + 8U]);
+    }
+}
+
+int32_t tuak_k_set(tuak_st *const tuak, uint8_t const *const k,
+                   uint8_t const k_len)
+{
+    if (k_len != 16U && k_len != 32U)
+    {
+        return -1;
+    }
+    memset(tuak->k, 0U, sizeof(tuak->k));
+    memcpy(tuak->k, k, k_len);
+    tuak->k_len = k_len;
+    return 0;
+}
+
+void tuak_top_set(tuak_st *const tuak, uint8_t const top[const 32])
+{
+    uint8_t incore[KECCAK_STATE_LANES * 8U];
+    uint64_t state[1U][KECCAK_STATE_LANES];
+    incore_init(tuak, top, TUAK_INSTANCE_TOPC, incore);
+    state_load(incore, state[0U]);
+    core_xN(state, &tuak->iter, 1U);
+    state_store(state[0U], incore);
+    outcore_pull(incore, TUAK_POS_TOP, tuak->top_c, sizeof(tuak->top_c));
+}
+
+void tuak_all(tuak_st const *const tuak, uint8_t const rand[const 16],
+              uint8_t const sqn[const 6], bool const sqn_concealed,
+              uint8_t const amf[const 2], milenage_vec_st *const vec)
+{
+    tuak_st const *const tuak_arr[1U] = {tuak};
+    /* Safe casts since each buffer is exactly one array of the batch. */
+    tuak_all_xN(tuak_arr, (uint8_t const(*)[16])rand,
+                (uint8_t const(*)[6])sqn, sqn_concealed,
+                (uint8_t const(*)[2])amf, vec, 1U);
+}
+
+void tuak_all_xN(tuak_st const *const tuak[const],
+                 uint8_t const rand[const][16], uint8_t const sqn[const][6],
+                 bool const sqn_concealed, uint8_t const amf[const][2],
+                 milenage_vec_st vec[const], uint32_t const n)
+{
+    /**
+     * f2-f5 come first since AK unconceals the SQN needed by f1 and f1*. Then
+     * f1, f1*, and f5* of the whole chunk are permuted together.
+     */
+    for (uint32_t base = 0U; base < n; base += TUAK_XN_CHUNK)
+    {
+        uint32_t const count =
+            n - base < TUAK_XN_CHUNK ? n - base : TUAK_XN_CHUNK;
+        tuak_st const *const *const t = &tuak[base];
+        milenage_vec_st *const v = &vec[base];
+
+        uint64_t state[TUAK_XN_CHUNK * 3U][KECCAK_STATE_LANES];
+        uint8_t iter[TUAK_XN_CHUNK * 3U];
+
+        for (uint32_t i = 0U; i < count; ++i)
+        {
+            f2345_in(t[i], TUAK_INSTANCE_F2345, rand[base + i], state[i]);
+            iter[i] = t[i]->iter;
+        }
+        core_xN(state, iter, count);
+        for (uint32_t i = 0U; i < count; ++i)
+        {
+            f2345_out(state[i], sqn[base + i], sqn_concealed, &v[i]);
+        }
+
+        for (uint32_t i = 0U; i < count; ++i)
+        {
+            uint64_t(*const s)[KECCAK_STATE_LANES] = &state[i * 3U];
+            f11star_in(t[i], TUAK_INSTANCE_F1, rand[base + i], v[i].sqn,
+                       amf[base + i], s[0U]);
+            f11star_in(t[i], TUAK_INSTANCE_F1STAR, rand[base + i], v[i].sqn,
+                       amf[base + i], s[1U]);
+            f2345_in(t[i], TUAK_INSTANCE_F5STAR, rand[base + i], s[2U]);
+            memset(&iter[i * 3U], t[i]->iter, 3U);
+        }
+        core_xN(state, iter, count * 3U);
+        for (uint32_t i = 0U; i < count; ++i)
+        {
+            f11star5star_out(
+                (uint64_t const(*)[KECCAK_STATE_LANES]) & state[i * 3U], &v[i]);
+        }
+    }
+}
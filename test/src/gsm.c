@@ -0,0 +1,164 @@
+#include <string.h>
+#include <tau/tau.h>
+
+#include "gsm.h"
+#include "src/fs.c"
+#include "src/gsm.c"
+
+/**
+ * The bit-by-bit COMP128-1 implementation that gsm_algo replaced. It is kept as
+ * the reference for the word-parallel one.
+ */
+static void gsm_algo_ref(uint8_t const ki[const 16],
+                         uint8_t const rand[const 16], uint8_t res[const 12])
+{
+    uint8_t x[32U] = {0U};
+    uint8_t bit[128U] = {0U};
+    uint32_t m, n, y, z, bit_next;
+
+    for (uint8_t i = 16U; i < 32U; i++)
+    {
+        x[i] = rand[i - 16U];
+    }
+
+    for (uint32_t i = 1U; i < 9U; i++)
+    {
+        /* Load key into first 16 bytes of input. */
+        for (uint8_t j = 0; j < 16; j++)
+        {
+            x[j] = ki[j];
+        }
+
+        /* Perform substitutions. */
+        for (uint8_t j = 0U; j < 5U; j++)
+        {
+            for (uint8_t k = 0U; k < (1U << j); k++)
+            {
+                for (uint8_t l = 0U; l < (1U << (4U - j)); l++)
+                {
+                    m = l + k * (1U << (5U - j));
+                    n = m + (1U << (4U - j));
+                    y = (x[m] + 2U * x[n]) % (1U << (9U - j));
+                    z = (2U * x[m] + x[n]) % (1U << (9U - j));
+                    x[m] = comp128_table[j][y];
+                    x[n] = comp128_table[j][z];
+                }
+            }
+        }
+        /* Form bits from bytes. */
+        for (uint8_t j = 0U; j < 32U; j++)
+        {
+            for (uint8_t k = 0U; k < 4U; k++)
+            {
+                bit[4 * j + k] = (uint8_t)(x[j] >> (3U - k)) & 1U;
+            }
+        }
+        /* Permutation but not on the last loop. */
+        if (i < 8)
+        {
+            for (uint8_t j = 0U; j < 16U; j++)
+            {
+                x[j + 16U] = 0U;
+                for (uint8_t k = 0U; k < 8U; k++)
+                {
+                    bit_next = ((8U * j + k) * 17U) % 128U;
+                    x[j + 16U] |= (uint8_t)(bit[bit_next] << (7 - k));
+                }
+            }
+        }
+    }
+
+    for (uint8_t i = 0U; i < 4U; i++)
+    {
+        res[i] = (uint8_t)((x[2U * i] << 4U) | x[2U * i + 1U]);
+    }
+    for (uint8_t i = 0U; i < 6U; i++)
+    {
+        res[4 + i] =
+            (uint8_t)((x[2U * i + 18U] << 6U) | (x[2U * i + 18U + 1U] << 2U) |
+                      (x[2U * i + 18U + 2U] >> 2U));
+    }
+    res[4U + 6U] =
+        (uint8_t)((x[2 * 6U + 18U] << 6U) | (x[2U * 6U + 18U + 1U] << 2U));
+    res[4U + 7U] = 0U;
+}
+
+/**
+ * @brief Fill a buffer with pseudo-random bytes.
+ * @param[in, out] seed State of the generator.
+ * @param[out] buf
+ * @param[in] len Length of the buffer.
+ */
+static void gsm_test_random(uint32_t *const seed, uint8_t *const buf,
+                            uint32_t const len)
+{
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        *seed = (*seed * 1103515245U) + 12345U;
+        buf[i] = (uint8_t)(*seed >> 16U);
+    }
+}
+
+TEST(gsm, algo_random)
+{
+    uint32_t seed = 0xC0128;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        uint8_t ki[16];
+        uint8_t rand[16];
+        gsm_test_random(&seed, ki, sizeof(ki));
+        gsm_test_random(&seed, rand, sizeof(rand));
+
+        uint8_t res_exp[12];
+        uint8_t res[12];
+        gsm_algo_ref(ki, rand, res_exp);
+        gsm_algo(ki, rand, res);
+        CHECK_BUF_EQ(res, res_exp, sizeof(res));
+    }
+}
+
+TEST(gsm, algo_batch_random)
+{
+    enum
+    {
+        count = (GSM_ALGO_LANES * 8) + 3,
+    };
+    uint8_t ki[count][16];
+    uint8_t rand[count][16];
+    uint8_t res_exp[count][12];
+    uint8_t res[count][12];
+
+    uint32_t seed = 0xBA7C;
+    gsm_test_random(&seed, &ki[0][0], sizeof(ki));
+    gsm_test_random(&seed, &rand[0][0], sizeof(rand));
+    /* Edge values of the key and challenge. */
+    memset(ki[0], 0x00, sizeof(ki[0]));
+    memset(rand[0], 0x00, sizeof(rand[0]));
+    memset(ki[1], 0xFF, sizeof(ki[1]));
+    memset(rand[1], 0xFF, sizeof(rand[1]));
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        gsm_algo_ref(ki[i], rand[i], res_exp[i]);
+    }
+    gsm_algo_batch(ki, rand, res, count);
+    CHECK_BUF_EQ(res, res_exp, sizeof(res));
+}
+
+TEST(gsm, algo_run_variant)
+{
+    uint8_t ki[16U];
+    uint8_t rand[16U];
+    uint8_t res_exp[12U];
+    uint8_t res[12U];
+
+    uint32_t seed = 0x5E1;
+    gsm_test_random(&seed, ki, sizeof(ki));
+    gsm_test_random(&seed, rand, sizeof(rand));
+    gsm_algo_ref(ki, rand, res_exp);
+
+    CHECK_EQ(gsm_algo_run(GSM_ALGO_COMP128_1, ki, rand, res), 0);
+    CHECK_BUF_EQ(res, res_exp, sizeof(res));
+    CHECK_EQ(gsm_algo_run(GSM_ALGO_COMP128_2, ki, rand, res), -1);
+    CHECK_EQ(gsm_algo_run(GSM_ALGO_COMP128_3, ki, rand, res), -1);
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+#include <tau/tau.h>
+
+#include "kdf.h"
+#include "src/kdf.c"
+
+/* Test cases 1, 2, and 6 of RFC 4231 clause.4. */
+TEST(kdf, hmac_sha256_rfc4231)
+{
+    uint8_t const exp_1[KDF_OUT_LEN] = {
+        0xB0, 0x34, 0x4C, 0x61, 0xD8, 0xDB, 0x38, 0x53, 0x5C, 0xA8, 0xAF,
+        0xCE, 0xAF, 0x0B, 0xF1, 0x2B, 0x88, 0x1D, 0xC2, 0x00, 0xC9, 0x83,
+        0x3D, 0xA7, 0x26, 0xE9, 0x37, 0x6C, 0x2E, 0x32, 0xCF, 0xF7,
+    };
+    uint8_t const exp_2[KDF_OUT_LEN] = {
+        0x5B, 0xDC, 0xC1, 0x46, 0xBF, 0x60, 0x75, 0x4E, 0x6A, 0x04, 0x24,
+        0x26, 0x08, 0x95, 0x75, 0xC7, 0x5A, 0x00, 0x3F, 0x08, 0x9D, 0x27,
+        0x39, 0x83, 0x9D, 0xEC, 0x58, 0xB9, 0x64, 0xEC, 0x38, 0x43,
+    };
+    /* The key is longer than a block so it gets hashed first. */
+    uint8_t const exp_6[KDF_OUT_LEN] = {
+        0x60, 0xE4, 0x31, 0x59, 0x1E, 0xE0, 0xB6, 0x7F, 0x0D, 0x8A, 0x26,
+        0xAA, 0xCB, 0xF5, 0xB7, 0x7F, 0x8E, 0x0B, 0xC6, 0x21, 0x37, 0x28,
+        0xC5, 0x14, 0x05, 0x46, 0x04, 0x0F, 0x0E, 0xE3, 0x7F, 0x54,
+    };
+    char const msg_1[] = "Hi There";
+    char const msg_2[] = "what do ya want for nothing?";
+    char const msg_6[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+    uint8_t k[131U];
+    kdf_key_st key;
+    uint8_t mac[KDF_OUT_LEN];
+
+    memset(k, 0x0B, 20U);
+    kdf_key_set(&key, k, 20U);
+    kdf_hmac_sha256(&key, (uint8_t const *)msg_1, sizeof(msg_1) - 1U, mac);
+    CHECK_BUF_EQ(mac, exp_1, sizeof(exp_1));
+
+    kdf_key_set(&key, (uint8_t const *)"Jefe", 4U);
+    kdf_hmac_sha256(&key, (uint8_t const *)msg_2, sizeof(msg_2) - 1U, mac);
+    CHECK_BUF_EQ(mac, exp_2, sizeof(exp_2));
+
+    memset(k, 0xAA, sizeof(k));
+    kdf_key_set(&key, k, sizeof(k));
+    kdf_hmac_sha256(&key, (uint8_t const *)msg_6, sizeof(msg_6) - 1U, mac);
+    CHECK_BUF_EQ(mac, exp_6, sizeof(exp_6));
+}
+
+/* Every split of a long message gives the same result with every backend. */
+TEST(kdf, hmac_sha256_long)
+{
+    uint8_t const exp[KDF_OUT_LEN] = {
+        0x92, 0x99, 0x5D, 0x18, 0x70, 0x72, 0x7E, 0x0D, 0x7A, 0x25, 0xDA,
+        0x41, 0x8D, 0xE8, 0x8F, 0x3C, 0x6D, 0x8A, 0xD8, 0x2F, 0x52, 0xB6,
+        0xD4, 0x86, 0x78, 0xC6, 0x6C, 0xD0, 0xF5, 0xEE, 0x03, 0x4E,
+    };
+    uint8_t k[100U];
+    uint8_t msg[1000U];
+    for (uint32_t i = 0U; i < sizeof(k); ++i)
+    {
+        /* Safe cast since the index is less than 256. */
+        k[i] = (uint8_t)i;
+    }
+    for (uint32_t i = 0U; i < sizeof(msg); ++i)
+    {
+        /* Safe cast since only the lowest byte is kept. */
+        msg[i] = (uint8_t)((i * 7U) + 3U);
+    }
+
+    void (*const backend)(uint32_t[const 8U], uint8_t const *const,
+                          uint32_t const) = sha256_compress_backend;
+    for (uint32_t b = 0U; b < 2U; ++b)
+    {
+        sha256_compress_backend = b == 0U ? backend : sha256_compress_ref;
+        kdf_key_st key;
+        kdf_key_set(&key, k, sizeof(k));
+        for (uint32_t split = 0U; split <= 130U; split += 13U)
+        {
+            sha256_st inner;
+            uint8_t mac[KDF_OUT_LEN];
+            sha256_start(&inner, key.inner, SHA256_BLOCK_LEN);
+            sha256_update(&inner, msg, split);
+            sha256_update(&inner, &msg[split], sizeof(msg) - split);
+            hmac_final(&key, &inner, mac);
+            CHECK_BUF_EQ(mac, exp, sizeof(exp));
+        }
+    }
+    sha256_compress_backend = backend;
+}
+
+TEST(kdf, derive_5g_aka)
+{
+    uint8_t const exp_res_star[16U] = {
+        0x16, 0x58, 0xDE, 0xC1, 0x87, 0xF3, 0x3C, 0x1A,
+        0x2C, 0x65, 0xB0, 0x36, 0xE7, 0xA7, 0xEA, 0x17,
+    };
+    uint8_t const exp_kausf[32U] = {
+        0x86, 0x3B, 0xE5, 0x91, 0xF7, 0x18, 0x53, 0xB3, 0xB9, 0xD2, 0x0D,
+        0x5C, 0x6A, 0xB7, 0xB6, 0x0C, 0x1A, 0xE5, 0xBF, 0x0D, 0x7F, 0x22,
+        0x17, 0x5F, 0x1F, 0xBC, 0xC2, 0xFC, 0xD1, 0x95, 0xB1, 0xD9,
+    };
+    uint8_t const exp_ck_prime[16U] = {
+        0xE1, 0x81, 0xDA, 0x29, 0xE5, 0xE9, 0x2D, 0x7C,
+        0xA2, 0x7A, 0x31, 0x7B, 0x3A, 0xB3, 0x56, 0xF6,
+    };
+    uint8_t const exp_ik_prime[16U] = {
+        0xBF, 0x89, 0x49, 0xB2, 0xB3, 0x7D, 0x86, 0xAF,
+        0xBC, 0x9E, 0x7D, 0x1B, 0xFA, 0xD8, 0xAB, 0x4F,
+    };
+    uint8_t ck[16U];
+    uint8_t ik[16U];
+    for (uint8_t i = 0U; i < 16U; ++i)
+    {
+        /* Safe casts since the values are less than 256. */
+        ck[i] = (uint8_t)(0x10 + i);
+        ik[i] = (uint8_t)(0x20 + i);
+    }
+    uint8_t const res[8U] = {0xA5, 0x42, 0x11, 0xD5, 0xE3, 0xBA, 0x50, 0xBF};
+    uint8_t const rand[16U] = {0x23, 0x55, 0x3C, 0xBE, 0x96, 0x37, 0xA8, 0x9D,
+                               0x21, 0x8A, 0xE6, 0x4D, 0xAE, 0x47, 0xBF, 0x35};
+    uint8_t const sqn_ak[6U] = {0xAA, 0x68, 0x9C, 0x64, 0x83, 0x70};
+    char const snn[] = "5G:mnc001.mcc001.3gppnetwork.org";
+
+    kdf_5g_st out;
+    kdf_5g_aka(ck, ik, res, sizeof(res), rand, sqn_ak, (uint8_t const *)snn,
+               sizeof(snn) - 1U, &out);
+    CHECK_BUF_EQ(out.res_star, exp_res_star, sizeof(exp_res_star));
+    CHECK_BUF_EQ(out.kausf, exp_kausf, sizeof(exp_kausf));
+    CHECK_BUF_EQ(out.ck_prime, exp_ck_prime, sizeof(exp_ck_prime));
+    CHECK_BUF_EQ(out.ik_prime, exp_ik_prime, sizeof(exp_ik_prime));
+}
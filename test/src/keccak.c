@@ -0,0 +1,124 @@
+#include <stdbool.h>
+#include <string.h>
+#include <tau/tau.h>
+
+#include "keccak.h"
+#include "src/keccak.c"
+
+/**
+ * @brief SHA3-256 per FIPS 202 clause.6.1, only used to check the permutation
+ * against the published digests.
+ * @param[in] msg Message to hash.
+ * @param[in] msg_len Length of the message.
+ * @param[out] digest
+ */
+static void keccak_test_sha3_256(uint8_t const *const msg,
+                                 uint32_t const msg_len, uint8_t digest[32U])
+{
+    uint32_t const rate = 136U;
+    uint8_t state_bytes[KECCAK_STATE_LANES * 8U] = {0U};
+    uint64_t state[KECCAK_STATE_LANES];
+    uint32_t pos = 0U;
+    bool last = false;
+    while (!last)
+    {
+        uint8_t block[136U] = {0U};
+        uint32_t const len = msg_len - pos < rate ? msg_len - pos : rate;
+        memcpy(block, &msg[pos], len);
+        pos += len;
+        if (len < rate)
+        {
+            /* SHA-3 domain bits and the pad10*1 padding. */
+            block[len] ^= 0x06;
+            block[rate - 1U] ^= 0x80;
+            last = true;
+        }
+        for (uint32_t i = 0U; i < rate; ++i)
+        {
+            state_bytes[i] ^= block[i];
+        }
+        /* Lanes are little-endian, same as the host this runs on. */
+        memcpy(state, state_bytes, sizeof(state));
+        keccak_f1600(state);
+        memcpy(state_bytes, state, sizeof(state));
+    }
+    memcpy(digest, state_bytes, 32U);
+}
+
+TEST(keccak, f1600_zero_state)
+{
+    /* Keccak-f[1600] applied once to the all-zero state. */
+    uint64_t const exp[KECCAK_STATE_LANES] = {
+        0xF1258F7940E1DDE7, 0x84D5CCF933C0478A, 0xD598261EA65AA9EE,
+        0xBD1547306F80494D, 0x8B284E056253D057, 0xFF97A42D7F8E6FD4,
+        0x90FEE5A0A44647C4, 0x8C5BDA0CD6192E76, 0xAD30A6F71B19059C,
+        0x30935AB7D08FFC64, 0xEB5AA93F2317D635, 0xA9A6E6260D712103,
+        0x81A57C16DBCF555F, 0x43B831CD0347C826, 0x01F22F1A11A5569F,
+        0x05E5635A21D9AE61, 0x64BEFEF28CC970F2, 0x613670957BC46611,
+        0xB87C5A554FD00ECB, 0x8C3EE88A1CCF32C8, 0x940C7922AE3A2614,
+        0x1841F924A2C509E4, 0x16F53526E70465C2, 0x75F644E97F30A13B,
+        0xEAF1FF7B5CECA249,
+    };
+    uint64_t state[KECCAK_STATE_LANES] = {0U};
+    keccak_f1600(state);
+    CHECK_BUF_EQ(state, exp, sizeof(exp));
+}
+
+TEST(keccak, sha3_256)
+{
+    uint8_t const exp_abc[32U] = {
+        0x3A, 0x98, 0x5D, 0xA7, 0x4F, 0xE2, 0x25, 0xB2, 0x04, 0x5C, 0x17,
+        0x2D, 0x6B, 0xD3, 0x90, 0xBD, 0x85, 0x5F, 0x08, 0x6E, 0x3E, 0x9D,
+        0x52, 0x5B, 0x46, 0xBF, 0xE2, 0x45, 0x11, 0x43, 0x15, 0x32,
+    };
+    /* 200 bytes of 'a' which take 2 blocks. */
+    uint8_t const exp_a200[32U] = {
+        0xCC, 0xE3, 0x44, 0x85, 0xBA, 0xF2, 0xBF, 0x2A, 0xCA, 0x99, 0xB9,
+        0x48, 0x33, 0x89, 0x2A, 0x4F, 0x52, 0x89, 0x6D, 0x3D, 0x15, 0x3F,
+        0x7B, 0x84, 0x0C, 0xC4, 0xF9, 0xFE, 0x69, 0x5F, 0x13, 0x87,
+    };
+    uint8_t msg[200U];
+    uint8_t digest[32U];
+
+    memcpy(msg, "abc", 3U);
+    keccak_test_sha3_256(msg, 3U, digest);
+    CHECK_BUF_EQ(digest, exp_abc, sizeof(exp_abc));
+
+    memset(msg, 'a', sizeof(msg));
+    keccak_test_sha3_256(msg, sizeof(msg), digest);
+    CHECK_BUF_EQ(digest, exp_a200, sizeof(exp_a200));
+}
+
+TEST(keccak, f1600_batch)
+{
+    enum
+    {
+        count = 11,
+    };
+    uint64_t state[count][KECCAK_STATE_LANES];
+    uint64_t exp[count][KECCAK_STATE_LANES];
+    uint64_t seed = 0x243F6A8885A308D3;
+    for (uint32_t i = 0U; i < count; ++i)
+    {
+        for (uint32_t j = 0U; j < KECCAK_STATE_LANES; ++j)
+        {
+            seed = (seed * 6364136223846793005U) + 1442695040888963407U;
+            state[i][j] = seed;
+        }
+    }
+    memcpy(exp, state, sizeof(exp));
+    for (uint32_t i = 0U; i < count; ++i)
+    {
+        keccak_f1600(exp[i]);
+    }
+
+    /* Every group size goes through the same backend as the batch. */
+    for (uint32_t n = 1U; n <= count; ++n)
+    {
+        uint64_t batch[count][KECCAK_STATE_LANES];
+        memcpy(batch, state, sizeof(batch));
+        keccak_f1600_xN(batch, n);
+        CHECK_BUF_EQ(batch, exp, n * sizeof(exp[0U]));
+        CHECK_BUF_EQ(&batch[n], &state[n], (count - n) * sizeof(state[0U]));
+    }
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+#include <tau/tau.h>
+
+#include "log.h"
+#include "src/log.c"
+
+/**
+ * @brief Drain a log into a string.
+ * @param[in, out] log Log to drain.
+ * @param[out] buf Where the formatted records will be written.
+ * @param[in] buf_size Size of the buffer.
+ * @return Number of records drained.
+ */
+static uint32_t log_test_drain(log_st *const log, char *const buf,
+                               uint32_t const buf_size)
+{
+    FILE *const out = tmpfile();
+    if (out == NULL)
+    {
+        buf[0U] = '\0';
+        return 0U;
+    }
+    uint32_t const count = log_drain(log, out);
+    rewind(out);
+    size_t const len = fread(buf, 1U, buf_size - 1U, out);
+    buf[len] = '\0';
+    fclose(out);
+    return count;
+}
+
+TEST(log, level_gating)
+{
+    static log_st log_test;
+    char buf[256U];
+    log_init(&log_test, LOG_LVL_WRN, false);
+
+    LOG_ERR(&log_test, "Error %" PRIu64 ".", 1U);
+    LOG_WRN(&log_test, "Warning %" PRIu64 ".", 2U);
+    LOG_INF(&log_test, "Info %" PRIu64 ".", 3U);
+    LOG_DBG(&log_test, "Debug %" PRIu64 ".", 4U);
+    LOG_ERR((log_st *)NULL, "Nowhere.");
+
+    CHECK_EQ(log_test_drain(&log_test, buf, sizeof(buf)), 2U);
+    CHECK_STREQ(buf, "Error 1.\nWarning 2.\n");
+}
+
+TEST(log, hex_dump)
+{
+    static log_st log_test;
+    char buf[256U];
+    uint8_t const rand[4U] = {0x01, 0x23, 0xAB, 0xEF};
+    uint8_t const ck[4U] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+    log_init(&log_test, LOG_LVL_INF, false);
+    LOG_HEX(&log_test, LOG_LVL_INF, false, rand, sizeof(rand),
+            "RAND(%" PRIu64 ")=", sizeof(rand));
+    LOG_HEX(&log_test, LOG_LVL_INF, true, ck, sizeof(ck), "CK=");
+    CHECK_EQ(log_test_drain(&log_test, buf, sizeof(buf)), 2U);
+    CHECK_STREQ(buf, "RAND(4)=0123ABEF\nCK=<redacted>\n");
+
+    log_init(&log_test, LOG_LVL_INF, true);
+    LOG_HEX(&log_test, LOG_LVL_INF, true, ck, sizeof(ck), "CK=");
+    CHECK_EQ(log_test_drain(&log_test, buf, sizeof(buf)), 1U);
+    CHECK_STREQ(buf, "CK=DEADBEEF\n");
+}
+
+TEST(log, ring_overflow)
+{
+    static log_st log_test;
+    char buf[LOG_RING_LEN * 8U];
+    log_init(&log_test, LOG_LVL_INF, false);
+
+    for (uint32_t i = 0U; i < LOG_RING_LEN + 3U; ++i)
+    {
+        LOG_INF(&log_test, "%" PRIu64, i);
+    }
+    CHECK_EQ(log_test_drain(&log_test, buf, sizeof(buf)), LOG_RING_LEN);
+    CHECK_NOT_NULL(strstr(buf, "Log: dropped 3 records.\n"));
+
+    /* Drained records make room for new ones. */
+    LOG_INF(&log_test, "again");
+    CHECK_EQ(log_test_drain(&log_test, buf, sizeof(buf)), 1U);
+    CHECK_STREQ(buf, "again\n");
+}
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include <tau/tau.h>
+
+#include "manifest.h"
+#include "src/manifest.c"
+
+TEST(manifest, ef_imsi)
+{
+    /* The EF.IMSI of data/usim.json. */
+    uint8_t const exp_odd[MANIFEST_EF_IMSI_LEN] = {0x08, 0x99, 0x99, 0x99, 0x00,
+                                                   0x00, 0x00, 0x00, 0x10};
+    uint8_t const exp_even[MANIFEST_EF_IMSI_LEN] = {
+        0x08, 0x01, 0x10, 0x10, 0x32, 0x54, 0x76, 0x98, 0xF0};
+    uint8_t ef_imsi[MANIFEST_EF_IMSI_LEN];
+
+    CHECK_EQ(manifest_imsi_encode("999990000000001", ef_imsi), 0);
+    CHECK_BUF_EQ(ef_imsi, exp_odd, sizeof(exp_odd));
+    CHECK_EQ(manifest_imsi_encode("00101234567890", ef_imsi), 0);
+    CHECK_BUF_EQ(ef_imsi, exp_even, sizeof(exp_even));
+
+    CHECK_EQ(manifest_imsi_encode("12345", ef_imsi), -1);
+    CHECK_EQ(manifest_imsi_encode("1234567890123456", ef_imsi), -1);
+    CHECK_EQ(manifest_imsi_encode("00101A000000001", ef_imsi), -1);
+}
+
+TEST(manifest, key_file)
+{
+    /* The key file of auc-gen is a valid manifest. */
+    char text[] = "# IMSI K OPc SQN\n"
+                  "\n"
+                  "001010000000000 CD613E30D8F16ADF91B7584A2265B1F5 "
+                  "1E2FEB89414C343C1027C4D1C386BBC4 000000000020\n"
+                  "001010000000001 78e510617311d8a3c2ce6f447ed4d57b\n";
+    FILE *f = fmemopen(text, strlen(text), "r");
+    manifest_sub_st *sub = NULL;
+    uint32_t sub_count = 0U;
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), 0);
+    fclose(f);
+    CHECK_EQ(sub_count, 2U);
+    if (sub_count == 2U)
+    {
+        CHECK_STREQ(sub[0U].imsi, "001010000000000");
+        CHECK_EQ(sub[0U].k[0U], 0xCD);
+        CHECK_TRUE(sub[0U].op_c_present);
+        CHECK_EQ(sub[0U].op_c[15U], 0xC4);
+        CHECK_STREQ(sub[1U].imsi, "001010000000001");
+        CHECK_EQ(sub[1U].k[15U], 0x7B);
+        CHECK_FALSE(sub[1U].op_c_present);
+    }
+    free(sub);
+
+    /* TUAK fields follow the columns, K can have 256 bits. */
+    char text_tuak[] =
+        "001010000000002 "
+        "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F "
+        "top=5555555555555555555555555555555555555555555555555555555555555555\n"
+        "001010000000003 78e510617311d8a3c2ce6f447ed4d57b "
+        "topc=BD04D9530E87513C5D837AC2AD954623A8E2330C115305A73EB45D1F40CCCBFF"
+        "\n";
+    f = fmemopen(text_tuak, strlen(text_tuak), "r");
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), 0);
+    fclose(f);
+    CHECK_EQ(sub_count, 2U);
+    if (sub_count == 2U)
+    {
+        CHECK_EQ(sub[0U].k_len, 32U);
+        CHECK_EQ(sub[0U].k[31U], 0x1F);
+        CHECK_FALSE(sub[0U].op_c_present);
+        CHECK_EQ(sub[0U].top[31U], 0x55);
+        CHECK_FALSE(sub[0U].top_c_present);
+        CHECK_EQ(sub[1U].k_len, 16U);
+        CHECK_TRUE(sub[1U].top_c_present);
+        CHECK_EQ(sub[1U].top_c[0U], 0xBD);
+    }
+    free(sub);
+
+    /* Unknown fields and columns after fields are rejected. */
+    char text_bad_field[] =
+        "001010000000000 CD613E30D8F16ADF91B7584A2265B1F5 op=00\n";
+    f = fmemopen(text_bad_field, strlen(text_bad_field), "r");
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), -1);
+    fclose(f);
+    char text_bad_order[] =
+        "001010000000000 CD613E30D8F16ADF91B7584A2265B1F5 "
+        "topc=0000000000000000000000000000000000000000000000000000000000000000 "
+        "000000000020\n";
+    f = fmemopen(text_bad_order, strlen(text_bad_order), "r");
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), -1);
+    fclose(f);
+
+    char text_bad_k[] = "001010000000000 CD613E30D8F16ADF91B7584A2265B1\n";
+    f = fmemopen(text_bad_k, strlen(text_bad_k), "r");
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), -1);
+    fclose(f);
+
+    char text_empty[] = "# Nothing.\n";
+    f = fmemopen(text_empty, strlen(text_empty), "r");
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), -1);
+    fclose(f);
+}
+
+/* TOPc follows the K of the manifest so TUAK authentication still succeeds. */
+TEST(manifest, tuak)
+{
+    char text[] = "001010000000000 CD613E30D8F16ADF91B7584A2265B1F5\n";
+    FILE *f = fmemopen(text, strlen(text), "r");
+    manifest_sub_st *sub = NULL;
+    uint32_t sub_count = 0U;
+    CHECK_EQ(manifest_read(f, &sub, &sub_count), 0);
+    fclose(f);
+    CHECK_EQ(sub_count, 1U);
+
+    /* The keys of the instance before the manifest is applied. */
+    swsim_st *const swsim_state = calloc(1U, sizeof(*swsim_state));
+    uint8_t const top[32U] = {0U};
+    uint8_t k_init[16U];
+    memset(k_init, 0xFF, sizeof(k_init));
+    swsim_state->tuak.iter = 1U;
+    tuak_k_set(&swsim_state->tuak, k_init, sizeof(k_init));
+    tuak_top_set(&swsim_state->tuak, top);
+    swsim_state->milenage.algo = MILENAGE_ALGO_TUAK;
+    swsim_state->milenage.tuak = &swsim_state->tuak;
+    milenage_sqn_array_set(&swsim_state->milenage, NULL);
+    if (sub_count == 1U)
+    {
+        CHECK_EQ(manifest_key_apply(&sub[0U], swsim_state), 0);
+
+        /* The AuC only knows the K from the manifest. */
+        tuak_st tuak_auc = {.iter = 1U};
+        tuak_k_set(&tuak_auc, sub[0U].k, sub[0U].k_len);
+        tuak_top_set(&tuak_auc, top);
+        CHECK_BUF_EQ(swsim_state->tuak.top_c, tuak_auc.top_c,
+                     sizeof(tuak_auc.top_c));
+
+        uint8_t const rand[16U] = {0x42, 0x42};
+        uint8_t const sqn[6U] = {0x00, 0x00, 0x00, 0x00, 0x01, 0x20};
+        uint8_t const amf[2U] = {0x80, 0x00};
+        milenage_vec_st vec;
+        tuak_all(&tuak_auc, rand, sqn, false, amf, &vec);
+        uint8_t autn[16U];
+        for (uint32_t i = 0U; i < 6U; ++i)
+        {
+            autn[i] = sqn[i] ^ vec.ak[i];
+        }
+        memcpy(&autn[6U], amf, sizeof(amf));
+        memcpy(&autn[8U], vec.mac_a, sizeof(vec.mac_a));
+
+        uint8_t output[SWICC_DATA_MAX];
+        uint16_t output_len = 0U;
+        CHECK_EQ(milenage(&swsim_state->milenage, rand, autn, output,
+                          &output_len),
+                 SWICC_RET_SUCCESS);
+        CHECK_EQ(output[0U], 0xDB);
+        CHECK_BUF_EQ(&output[2U], vec.res, sizeof(vec.res));
+
+        /* A provisioned TOPc is used as is. */
+        memset(sub[0U].top_c, 0x5A, sizeof(sub[0U].top_c));
+        sub[0U].top_c_present = true;
+        CHECK_EQ(manifest_key_apply(&sub[0U], swsim_state), 0);
+        CHECK_BUF_EQ(swsim_state->tuak.top_c, sub[0U].top_c,
+                     sizeof(sub[0U].top_c));
+    }
+    free(swsim_state);
+    free(sub);
+}
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <string.h>
 #include <tau/tau.h>
 
@@ -28,13 +29,14 @@ milenage_st const milenage_param_default = {
         milenage_st milenage_param;                                            \
         memcpy(&milenage_param, &milenage_param_default,                       \
                sizeof(milenage_param));                                        \
-        memcpy(milenage_param.op, op, sizeof(milenage_param.op));              \
-        milenage_param.op_present = true;                                      \
+        milenage_k_set(&milenage_param, k);                                    \
+        milenage_op_set(&milenage_param, op);                                  \
+        milenage_param_std_check(&milenage_param);                             \
         uint8_t mac_a[8];                                                      \
-        f1(&milenage_param, k, rand, sqn, amf, mac_a);                         \
+        f1(&milenage_param, rand, sqn, amf, mac_a);                            \
         CHECK_BUF_EQ(mac_a, exp_mac_a, sizeof(mac_a));                         \
         uint8_t mac_s[8];                                                      \
-        f1star(&milenage_param, k, rand, sqn, amf, mac_s);                     \
+        f1star(&milenage_param, rand, sqn, amf, mac_s);                        \
         CHECK_BUF_EQ(mac_s, exp_mac_s, sizeof(mac_s));                         \
     } while (0)
 
@@ -44,16 +46,17 @@ milenage_st const milenage_param_default = {
         milenage_st milenage_param;                                            \
         memcpy(&milenage_param, &milenage_param_default,                       \
                sizeof(milenage_param));                                        \
-        memcpy(milenage_param.op, op, sizeof(milenage_param.op));              \
-        milenage_param.op_present = true;                                      \
+        milenage_k_set(&milenage_param, k);                                    \
+        milenage_op_set(&milenage_param, op);                                  \
+        milenage_param_std_check(&milenage_param);                             \
         uint8_t output_f2[8];                                                  \
-        f2(&milenage_param, k, rand, output_f2);                               \
+        f2(&milenage_param, rand, output_f2);                                  \
         CHECK_BUF_EQ(output_f2, exp_f2, sizeof(output_f2));                    \
         uint8_t output_f3[16];                                                 \
-        f3(&milenage_param, k, rand, output_f3);                               \
+        f3(&milenage_param, rand, output_f3);                                  \
         CHECK_BUF_EQ(output_f3, exp_f3, sizeof(output_f3));                    \
         uint8_t output_f5[6];                                                  \
-        f5(&milenage_param, k, rand, output_f5);                               \
+        f5(&milenage_param, rand, output_f5);                                  \
         CHECK_BUF_EQ(output_f5, exp_f5, sizeof(output_f5));                    \
     } while (0)
 
@@ -63,13 +66,14 @@ milenage_st const milenage_param_default = {
         milenage_st milenage_param;                                            \
         memcpy(&milenage_param, &milenage_param_default,                       \
                sizeof(milenage_param));                                        \
-        memcpy(milenage_param.op, op, sizeof(milenage_param.op));              \
-        milenage_param.op_present = true;                                      \
+        milenage_k_set(&milenage_param, k);                                    \
+        milenage_op_set(&milenage_param, op);                                  \
+        milenage_param_std_check(&milenage_param);                             \
         uint8_t output_f4[16];                                                 \
-        f4(&milenage_param, k, rand, output_f4);                               \
+        f4(&milenage_param, rand, output_f4);                                  \
         CHECK_BUF_EQ(output_f4, exp_f4, sizeof(output_f4));                    \
         uint8_t output_f5star[6];                                              \
-        f5star(&milenage_param, k, rand, output_f5star);                       \
+        f5star(&milenage_param, rand, output_f5star);                          \
         CHECK_BUF_EQ(output_f5star, exp_f5star, sizeof(output_f5star));        \
     } while (0)
 
@@ -82,21 +86,48 @@ milenage_st const milenage_param_default = {
                sizeof(milenage_param));                                        \
         memcpy(milenage_param.op_c, op_c, sizeof(milenage_param.op));          \
         milenage_param.op_present = false;                                     \
+        milenage_k_set(&milenage_param, k);                                    \
+        milenage_param_std_check(&milenage_param);                             \
         uint8_t output[16];                                                    \
-        f1(&milenage_param, k, rand, sqn, amf, output);                        \
+        f1(&milenage_param, rand, sqn, amf, output);                           \
         CHECK_BUF_EQ(output, exp_f1, sizeof(exp_f1));                          \
-        f1star(&milenage_param, k, rand, sqn, amf, output);                    \
+        f1star(&milenage_param, rand, sqn, amf, output);                       \
         CHECK_BUF_EQ(output, exp_f1star, sizeof(exp_f1star));                  \
-        f2(&milenage_param, k, rand, output);                                  \
+        f2(&milenage_param, rand, output);                                     \
         CHECK_BUF_EQ(output, exp_f2, sizeof(exp_f2));                          \
-        f3(&milenage_param, k, rand, output);                                  \
+        f3(&milenage_param, rand, output);                                     \
         CHECK_BUF_EQ(output, exp_f3, sizeof(exp_f3));                          \
-        f4(&milenage_param, k, rand, output);                                  \
+        f4(&milenage_param, rand, output);                                     \
         CHECK_BUF_EQ(output, exp_f4, sizeof(exp_f4));                          \
-        f5(&milenage_param, k, rand, output);                                  \
+        f5(&milenage_param, rand, output);                                     \
         CHECK_BUF_EQ(output, exp_f5, sizeof(exp_f5));                          \
-        f5star(&milenage_param, k, rand, output);                              \
+        f5star(&milenage_param, rand, output);                                 \
         CHECK_BUF_EQ(output, exp_f5star, sizeof(exp_f5star));                  \
+        milenage_vec_st vec;                                                   \
+        milenage_all(&milenage_param, rand, sqn, false, amf, &vec);            \
+        CHECK_BUF_EQ(vec.sqn, sqn, sizeof(vec.sqn));                           \
+        CHECK_BUF_EQ(vec.mac_a, exp_f1, sizeof(exp_f1));                       \
+        CHECK_BUF_EQ(vec.mac_s, exp_f1star, sizeof(exp_f1star));               \
+        CHECK_BUF_EQ(vec.res, exp_f2, sizeof(exp_f2));                         \
+        CHECK_BUF_EQ(vec.ck, exp_f3, sizeof(exp_f3));                          \
+        CHECK_BUF_EQ(vec.ik, exp_f4, sizeof(exp_f4));                          \
+        CHECK_BUF_EQ(vec.ak, exp_f5, sizeof(exp_f5));                          \
+        CHECK_BUF_EQ(vec.ak_star, exp_f5star, sizeof(exp_f5star));             \
+        uint8_t sqn_xor_ak[6];                                                 \
+        xorv(sqn, exp_f5, sizeof(sqn_xor_ak), sqn_xor_ak);                     \
+        milenage_all(&milenage_param, rand, sqn_xor_ak, true, amf, &vec);      \
+        CHECK_BUF_EQ(vec.sqn, sqn, sizeof(vec.sqn));                           \
+        CHECK_BUF_EQ(vec.mac_a, exp_f1, sizeof(exp_f1));                       \
+        /* The generic path must agree with the standard constants one. */     \
+        milenage_param.param_std = false;                                      \
+        milenage_all(&milenage_param, rand, sqn, false, amf, &vec);            \
+        CHECK_BUF_EQ(vec.mac_a, exp_f1, sizeof(exp_f1));                       \
+        CHECK_BUF_EQ(vec.mac_s, exp_f1star, sizeof(exp_f1star));               \
+        CHECK_BUF_EQ(vec.res, exp_f2, sizeof(exp_f2));                         \
+        CHECK_BUF_EQ(vec.ck, exp_f3, sizeof(exp_f3));                          \
+        CHECK_BUF_EQ(vec.ik, exp_f4, sizeof(exp_f4));                          \
+        CHECK_BUF_EQ(vec.ak, exp_f5, sizeof(exp_f5));                          \
+        CHECK_BUF_EQ(vec.ak_star, exp_f5star, sizeof(exp_f5star));             \
     } while (0)
 
 TEST(milenage, xorv_16byte)
@@ -204,6 +235,77 @@ TEST(milenage, rotl128_full_byte)
     }
 }
 
+TEST(milenage, rotl128_word)
+{
+    uint8_t n[16];
+    uint8_t n_exp[16];
+    for (uint8_t i = 0; i < 16; ++i)
+    {
+        n[i] = i;
+    }
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        memcpy(n_exp, n, sizeof(n_exp));
+        rotl128(n_exp, 32 * i);
+        rotl128_word(n, i);
+        CHECK_BUF_EQ(n, n_exp, sizeof(n));
+    }
+}
+
+TEST(milenage, param_std_detection)
+{
+    milenage_st milenage_param;
+    memcpy(&milenage_param, &milenage_param_default, sizeof(milenage_param));
+    milenage_param_std_check(&milenage_param);
+    CHECK_TRUE(milenage_param.param_std);
+
+    milenage_param.c3[0] = 0x80;
+    milenage_param_std_check(&milenage_param);
+    CHECK_FALSE(milenage_param.param_std);
+
+    milenage_param.c3[0] = 0x00;
+    milenage_param.r5 = 97;
+    milenage_param_std_check(&milenage_param);
+    CHECK_FALSE(milenage_param.param_std);
+}
+
+TEST(milenage, param_validation)
+{
+    milenage_st milenage_param;
+    memcpy(&milenage_param, &milenage_param_default, sizeof(milenage_param));
+    CHECK_EQ(milenage_config_validate(&milenage_param), SWICC_RET_SUCCESS);
+    CHECK_TRUE(milenage_param.config_valid);
+    CHECK_TRUE(milenage_param.param_std);
+
+    /* Bad parity is only a recommendation. */
+    milenage_param.c2[0] = 0x01;
+    CHECK_EQ(milenage_config_validate(&milenage_param), SWICC_RET_SUCCESS);
+    CHECK_TRUE(milenage_param.config_valid);
+    CHECK_FALSE(milenage_param.param_std);
+
+    /* Pairs (ci, ri) must be unique. */
+    memcpy(milenage_param.c4, milenage_param.c3, sizeof(milenage_param.c4));
+    milenage_param.r4 = milenage_param.r3;
+    CHECK_EQ(milenage_config_validate(&milenage_param), SWICC_RET_ERROR);
+    CHECK_FALSE(milenage_param.config_valid);
+}
+
+TEST(milenage, auth_refused_unvalidated)
+{
+    milenage_st milenage_param;
+    memcpy(&milenage_param, &milenage_param_default, sizeof(milenage_param));
+    uint8_t const k[16] = {0};
+    milenage_k_set(&milenage_param, k);
+
+    uint8_t const rand[16] = {0};
+    uint8_t const autn[16] = {0};
+    uint8_t output[SWICC_DATA_MAX];
+    uint16_t output_len = sizeof(output);
+    CHECK_EQ(milenage(&milenage_param, rand, autn, output, &output_len),
+             SWICC_RET_ERROR);
+    CHECK_EQ(output_len, 0);
+}
+
 TEST(milenage, rotl128_partial_byte)
 {
     uint8_t const n_const[16] = {
@@ -850,3 +952,399 @@ TEST(milenage, milenage__3gpp_ts_35_208_v17_0_0__test_set_3)
     MILENAGE_TEST_SET(op_c, k, rand, sqn, amf, exp_f1, exp_f1star, exp_f2,
                       exp_f3, exp_f4, exp_f5, exp_f5star);
 }
+
+/**
+ * The batch form must give the same results as computing each tuple on its
+ * own. More tuples than fit in one chunk are used so chunking is covered too.
+ */
+TEST(milenage, all_multi_tuple)
+{
+    enum
+    {
+        count = MILENAGE_XN_CHUNK + 5,
+    };
+    milenage_st param[count];
+    milenage_st const *param_ptr[count];
+    uint8_t rand[count][16];
+    uint8_t sqn[count][6];
+    uint8_t amf[count][2];
+    milenage_vec_st vec_exp[count];
+    milenage_vec_st vec[count];
+
+    uint32_t seed = 0x5EED;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint8_t k[16];
+        memcpy(&param[i], &milenage_param_default, sizeof(param[i]));
+        for (uint8_t j = 0; j < 16; ++j)
+        {
+            seed = (seed * 1103515245U) + 12345U;
+            k[j] = (uint8_t)(seed >> 16U);
+            seed = (seed * 1103515245U) + 12345U;
+            param[i].op[j] = (uint8_t)(seed >> 16U);
+            param[i].op_c[j] = (uint8_t)(seed >> 8U);
+            seed = (seed * 1103515245U) + 12345U;
+            rand[i][j] = (uint8_t)(seed >> 16U);
+        }
+        memcpy(sqn[i], rand[i], sizeof(sqn[i]));
+        memcpy(amf[i], &rand[i][6], sizeof(amf[i]));
+        param[i].op_present = i % 2 == 0;
+        milenage_param_std_check(&param[i]);
+        milenage_k_set(&param[i], k);
+        param_ptr[i] = &param[i];
+
+        milenage_all(&param[i], rand[i], sqn[i], true, amf[i], &vec_exp[i]);
+    }
+
+    milenage_all_xN(param_ptr, rand, sqn, true, amf, vec, count);
+    CHECK_BUF_EQ(vec, vec_exp, sizeof(vec));
+}
+
+/**
+ * @brief Authenticate with AUTN built the way the network would for some SQN.
+ * @param[in, out] param Milenage parameters.
+ * @param[in] rand Random challenge.
+ * @param[in] sqn Sequence number to put in AUTN.
+ * @param[out] output Response data.
+ * @param[out] output_len Length of the response data.
+ * @return Result of the authentication.
+ */
+static swicc_ret_et milenage_test_auth(milenage_st *const param,
+                                       uint8_t const rand[const 16],
+                                       uint64_t const sqn,
+                                       uint8_t output[const SWICC_DATA_MAX],
+                                       uint16_t *const output_len)
+{
+    uint8_t const amf[2] = {0x80, 0x00};
+    uint8_t sqn_buf[6];
+    sqn_store(sqn, sqn_buf);
+    milenage_vec_st vec;
+    milenage_all(param, rand, sqn_buf, false, amf, &vec);
+
+    uint8_t autn[16];
+    xorv(sqn_buf, vec.ak, 6, autn);
+    memcpy(&autn[6], amf, sizeof(amf));
+    memcpy(&autn[8], vec.mac_a, sizeof(vec.mac_a));
+    return milenage(param, rand, autn, output, output_len);
+}
+
+/**
+ * SQN array per 3GPP TS 33.102 V17.0.0 Annex C: each IND slot only accepts a
+ * higher SEQ, SEQ can't jump more than delta ahead, and a rejected SQN results
+ * in AUTS that conceals SQN_MS and carries MAC-S over the dummy AMF.
+ */
+TEST(milenage, sqn_array_resync)
+{
+    milenage_st milenage_param;
+    memcpy(&milenage_param, &milenage_param_default, sizeof(milenage_param));
+    uint8_t const k[16] = {
+        0x46, 0x5B, 0x5C, 0xE8, 0xB1, 0x99, 0xB4, 0x9F,
+        0xAA, 0x5F, 0x0A, 0x2E, 0xE2, 0x38, 0xA6, 0xBC,
+    };
+    uint8_t const op[16] = {
+        0xCD, 0xC2, 0x02, 0xD5, 0x12, 0x3E, 0x20, 0xF6,
+        0x2B, 0x6D, 0x67, 0x6A, 0xC7, 0x2C, 0xB3, 0x18,
+    };
+    milenage_k_set(&milenage_param, k);
+    milenage_op_set(&milenage_param, op);
+    REQUIRE_EQ(milenage_config_validate(&milenage_param), SWICC_RET_SUCCESS);
+
+    uint8_t sqn_array[MILENAGE_SQN_ARRAY_SIZE] = {0};
+    milenage_sqn_array_set(&milenage_param, sqn_array);
+
+    uint8_t const rand[16] = {
+        0x23, 0x55, 0x3C, 0xBE, 0x96, 0x37, 0xA8, 0x9D,
+        0x21, 0x8A, 0xE6, 0x4D, 0xAE, 0x47, 0xBF, 0x35,
+    };
+    uint8_t output[SWICC_DATA_MAX];
+    uint16_t output_len;
+
+    /* SEQ=5 IND=3 is fresh. */
+    uint64_t const sqn_first = (5U << MILENAGE_SQN_IND_LEN) | 3U;
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand, sqn_first, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0], 0xDB);
+    CHECK_EQ(sqn_load(&sqn_array[3 * 6]), sqn_first);
+    CHECK_EQ(milenage_param.sqn_ms_ind, 3);
+
+    /* A lower SEQ is still fresh in a different IND slot. */
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand,
+                                (2U << MILENAGE_SQN_IND_LEN) | 7U, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0], 0xDB);
+    CHECK_EQ(milenage_param.sqn_ms_ind, 3);
+
+    /**
+     * Replay of an old SQN in a new challenge, and a SEQ too far ahead, both
+     * need a resynchronization.
+     */
+    uint8_t rand_replay[16];
+    memcpy(rand_replay, rand, sizeof(rand_replay));
+    rand_replay[0] ^= 0x01;
+    uint64_t const sqn_far =
+        ((5U + MILENAGE_SQN_DELTA + 1U) << MILENAGE_SQN_IND_LEN) | 4U;
+    uint64_t const sqn_rejected[2] = {sqn_first, sqn_far};
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        CHECK_EQ(milenage_test_auth(&milenage_param, rand_replay,
+                                    sqn_rejected[i], output, &output_len),
+                 SWICC_RET_SUCCESS);
+        CHECK_EQ(output_len, 16);
+        CHECK_EQ(output[0], 0xDC);
+        CHECK_EQ(output[1], 14);
+
+        uint8_t const amf_resync[2] = {0x00, 0x00};
+        uint8_t sqn_ms[6];
+        sqn_store(sqn_first, sqn_ms);
+        milenage_vec_st vec;
+        milenage_all(&milenage_param, rand_replay, sqn_ms, false, amf_resync,
+                     &vec);
+        uint8_t sqn_ms_concealed[6];
+        xorv(sqn_ms, vec.ak_star, 6, sqn_ms_concealed);
+        CHECK_BUF_EQ(&output[2], sqn_ms_concealed, 6);
+        CHECK_BUF_EQ(&output[8], vec.mac_s, 8);
+    }
+
+    /* Nothing was accepted so the array is unchanged. */
+    CHECK_EQ(sqn_load(&sqn_array[4 * 6]), 0);
+    CHECK_EQ(milenage_param.sqn_ms_ind, 3);
+
+    /* Picking the same array up again finds SQN_MS. */
+    milenage_sqn_array_set(&milenage_param, NULL);
+    CHECK_EQ(milenage_param.sqn_ms_ind, 0);
+    milenage_sqn_array_set(&milenage_param, sqn_array);
+    CHECK_EQ(milenage_param.sqn_ms_ind, 3);
+}
+
+TEST(milenage, cache_retransmit)
+{
+    milenage_st milenage_param;
+    memcpy(&milenage_param, &milenage_param_default, sizeof(milenage_param));
+    uint8_t const k[16] = {
+        0x46, 0x5B, 0x5C, 0xE8, 0xB1, 0x99, 0xB4, 0x9F,
+        0xAA, 0x5F, 0x0A, 0x2E, 0xE2, 0x38, 0xA6, 0xBC,
+    };
+    milenage_k_set(&milenage_param, k);
+    REQUIRE_EQ(milenage_config_validate(&milenage_param), SWICC_RET_SUCCESS);
+    milenage_sqn_array_set(&milenage_param, NULL);
+
+    uint8_t const rand[16] = {0x23, 0x55, 0x3C, 0xBE};
+    uint64_t const sqn = (5U << MILENAGE_SQN_IND_LEN) | 3U;
+    uint8_t output[SWICC_DATA_MAX];
+    uint16_t output_len;
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand, sqn, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output_len, MILENAGE_RSP_LEN);
+    CHECK_EQ(milenage_param.cache.miss, 1);
+    uint8_t output_first[MILENAGE_RSP_LEN];
+    memcpy(output_first, output, sizeof(output_first));
+
+    /* The same challenge again gets the same response. */
+    memset(output, 0, MILENAGE_RSP_LEN);
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand, sqn, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output_len, MILENAGE_RSP_LEN);
+    CHECK_BUF_EQ(output, output_first, sizeof(output_first));
+    CHECK_EQ(milenage_param.cache.hit, 1);
+    CHECK_EQ(milenage_param.cache.miss, 1);
+
+    /* Once a newer SQN was accepted for the same IND, it is a replay. */
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand,
+                                sqn + (1U << MILENAGE_SQN_IND_LEN), output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0], 0xDB);
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand, sqn, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0], 0xDC);
+    CHECK_EQ(milenage_param.cache.hit, 1);
+    CHECK_EQ(milenage_param.cache.miss, 3);
+
+    /* A new key forgets all responses. */
+    uint64_t const sqn_last = sqn + (1U << MILENAGE_SQN_IND_LEN);
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand, sqn_last, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(milenage_param.cache.hit, 2);
+    milenage_k_set(&milenage_param, k);
+    CHECK_EQ(milenage_test_auth(&milenage_param, rand, sqn_last, output,
+                                &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0], 0xDC);
+    CHECK_EQ(milenage_param.cache.hit, 2);
+}
+
+/**
+ * XOR algorithm of the test USIM per ETSI TS 134 108 V17.0.0 clause.8.1.2.2
+ * with XDOUT = K ^ RAND = FF FE FD ... F0.
+ */
+TEST(milenage, algo_xor)
+{
+    milenage_st milenage_param = {0};
+    milenage_param.algo = MILENAGE_ALGO_XOR;
+    for (uint8_t i = 0; i < 16; ++i)
+    {
+        milenage_param.k[i] = i;
+    }
+    milenage_sqn_array_set(&milenage_param, NULL);
+
+    uint8_t rand[16];
+    memset(rand, 0xFF, sizeof(rand));
+    uint8_t const sqn[6] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x21};
+    uint8_t const amf[2] = {0x80, 0x00};
+    uint8_t const ak_exp[6] = {0xFC, 0xFB, 0xFA, 0xF9, 0xF8, 0xF7};
+    uint8_t const mac_exp[8] = {0xFF, 0xFE, 0xFD, 0xFC, 0xFB, 0xDB, 0x79, 0xF8};
+    uint8_t const res_exp[8] = {0xFF, 0xFE, 0xFD, 0xFC, 0xFB, 0xFA, 0xF9, 0xF8};
+    uint8_t const ck_exp[16] = {0xFE, 0xFD, 0xFC, 0xFB, 0xFA, 0xF9, 0xF8, 0xF7,
+                                0xF6, 0xF5, 0xF4, 0xF3, 0xF2, 0xF1, 0xF0, 0xFF};
+    uint8_t const ik_exp[16] = {0xFD, 0xFC, 0xFB, 0xFA, 0xF9, 0xF8, 0xF7, 0xF6,
+                                0xF5, 0xF4, 0xF3, 0xF2, 0xF1, 0xF0, 0xFF, 0xFE};
+
+    uint8_t autn[16];
+    xorv(sqn, ak_exp, 6, autn);
+    memcpy(&autn[6], amf, sizeof(amf));
+    memcpy(&autn[8], mac_exp, sizeof(mac_exp));
+
+    /* Same response layout as Milenage. */
+    uint8_t output[SWICC_DATA_MAX];
+    uint16_t output_len = 0;
+    CHECK_EQ(milenage(&milenage_param, rand, autn, output, &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output_len, 2 + 8 + 1 + 16 + 1 + 16 + 1 + 8);
+    CHECK_EQ(output[0], 0xDB);
+    CHECK_EQ(output[1], 8);
+    CHECK_BUF_EQ(&output[2], res_exp, sizeof(res_exp));
+    CHECK_EQ(output[10], 16);
+    CHECK_BUF_EQ(&output[11], ck_exp, sizeof(ck_exp));
+    CHECK_EQ(output[27], 16);
+    CHECK_BUF_EQ(&output[28], ik_exp, sizeof(ik_exp));
+
+    /* The MAC is still checked. */
+    autn[8] ^= 0x01;
+    CHECK_EQ(milenage(&milenage_param, rand, autn, output, &output_len),
+             SWICC_RET_ERROR);
+}
+
+#define MILENAGE_TEST_CARD_COUNT 8U
+#define MILENAGE_TEST_CARD_AUTH_COUNT 64U
+
+/* A card with all its state, like the Milenage part of one swSIM instance. */
+typedef struct milenage_test_card_s
+{
+    milenage_st param;
+    log_st log;
+    uint8_t sqn_array[MILENAGE_SQN_ARRAY_SIZE];
+    uint8_t output_last[MILENAGE_RSP_LEN];
+    uint32_t success_count;
+    atomic_bool done;
+} milenage_test_card_st;
+
+/**
+ * @brief Initialize a card for the stress test. All cards get the same key so
+ * their responses can be compared.
+ * @param[out] card
+ */
+static void milenage_test_card_init(milenage_test_card_st *const card)
+{
+    uint8_t const k[16] = {
+        0x46, 0x5B, 0x5C, 0xE8, 0xB1, 0x99, 0xB4, 0x9F,
+        0xAA, 0x5F, 0x0A, 0x2E, 0xE2, 0x38, 0xA6, 0xBC,
+    };
+    char const snn[] = "5G:mnc001.mcc001.3gppnetwork.org";
+    memset(card, 0, sizeof(*card));
+    memcpy(&card->param, &milenage_param_default, sizeof(card->param));
+    milenage_k_set(&card->param, k);
+    milenage_config_validate(&card->param);
+    milenage_sqn_array_set(&card->param, card->sqn_array);
+    /* The SNN makes every authentication derive the 5G keys too. */
+    memcpy(card->param.snn, snn, sizeof(snn) - 1U);
+    card->param.snn_len = sizeof(snn) - 1U;
+    log_init(&card->log, LOG_LVL_DBG, false);
+    card->param.log = &card->log;
+    atomic_init(&card->done, false);
+}
+
+/**
+ * @brief Authenticate a card many times with a fresh challenge each time.
+ * @param[in, out] arg The card.
+ * @return NULL.
+ */
+static void *milenage_test_card_run(void *const arg)
+{
+    milenage_test_card_st *const card = arg;
+    uint8_t output[SWICC_DATA_MAX];
+    uint16_t output_len = 0U;
+    for (uint32_t i = 0U; i < MILENAGE_TEST_CARD_AUTH_COUNT; ++i)
+    {
+        uint8_t rand[16] = {0x23, 0x55};
+        /* Safe cast since only the lowest byte is kept. */
+        rand[15] = (uint8_t)i;
+        uint64_t const sqn = (uint64_t)(i + 1U) << MILENAGE_SQN_IND_LEN;
+        if (milenage_test_auth(&card->param, rand, sqn, output, &output_len) ==
+                SWICC_RET_SUCCESS &&
+            output[0] == 0xDB)
+        {
+            ++card->success_count;
+        }
+    }
+    memcpy(card->output_last, output, sizeof(card->output_last));
+    atomic_store(&card->done, true);
+    return NULL;
+}
+
+/**
+ * Cards share no mutable state so each can be driven by its own thread without
+ * locks while another thread drains their logs. Build with 'make test-tsan' to
+ * have ThreadSanitizer check this.
+ */
+TEST(milenage, threads)
+{
+    static milenage_test_card_st card_ref;
+    static milenage_test_card_st card[MILENAGE_TEST_CARD_COUNT];
+    FILE *const out = fopen("/dev/null", "w");
+    REQUIRE_TRUE(out != NULL);
+
+    milenage_test_card_init(&card_ref);
+    milenage_test_card_run(&card_ref);
+    log_drain(&card_ref.log, out);
+    CHECK_EQ(card_ref.success_count, MILENAGE_TEST_CARD_AUTH_COUNT);
+
+    pthread_t thread[MILENAGE_TEST_CARD_COUNT];
+    uint32_t thread_count = 0U;
+    for (; thread_count < MILENAGE_TEST_CARD_COUNT; ++thread_count)
+    {
+        milenage_test_card_init(&card[thread_count]);
+        if (pthread_create(&thread[thread_count], NULL, milenage_test_card_run,
+                           &card[thread_count]) != 0)
+        {
+            break;
+        }
+    }
+    CHECK_EQ(thread_count, MILENAGE_TEST_CARD_COUNT);
+
+    /* Consume the logs concurrently like the log thread would. */
+    bool done_all = false;
+    while (!done_all)
+    {
+        done_all = true;
+        for (uint32_t i = 0U; i < thread_count; ++i)
+        {
+            bool const done = atomic_load(&card[i].done);
+            log_drain(&card[i].log, out);
+            done_all = done_all && done;
+        }
+    }
+    for (uint32_t i = 0U; i < thread_count; ++i)
+    {
+        pthread_join(thread[i], NULL);
+        CHECK_EQ(card[i].success_count, MILENAGE_TEST_CARD_AUTH_COUNT);
+        CHECK_BUF_EQ(card[i].output_last, card_ref.output_last,
+                     sizeof(card_ref.output_last));
+    }
+    fclose(out);
+}
@@ -1,11 +1,53 @@
+#include <string.h>
 #include <tau/tau.h>
 
 #include "rijndael.h"
 #include "src/rijndael.c"
 
+#if RIJNDAEL_AESNI
+#define RIJNDAEL_AESNI_SUPPORTED() __builtin_cpu_supports("aes")
+#define RIJNDAEL_VAES_SUPPORTED()                                              \
+    (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx2"))
+#else
+#define RIJNDAEL_AESNI_SUPPORTED() false
+#define RIJNDAEL_VAES_SUPPORTED() false
+#define rijndael_encrypt_aesni rijndael_encrypt_ref
+#define rijndael_encrypt_xN_aesni rijndael_encrypt_xN_bs
+#define rijndael_encrypt_xN_vaes rijndael_encrypt_xN_bs
+#endif
+
+/**
+ * Check that every encryption backend supported by the CPU (and the one picked
+ * at startup) produces the expected ciphertext.
+ */
+#define RIJNDAEL_BACKEND_TEST_SET(key, state, ciphertext)                      \
+    do                                                                         \
+    {                                                                          \
+        rijndael_st rijndael_backend;                                          \
+        rijndael_init(&rijndael_backend, key);                                 \
+        uint8_t input[16];                                                     \
+        uint8_t output_exp[16];                                                \
+        for (uint8_t i = 0; i < 16; ++i)                                       \
+        {                                                                      \
+            input[i] = state[i & 0x03][i >> 2];                                \
+            output_exp[i] = ciphertext[i & 0x03][i >> 2];                      \
+        }                                                                      \
+        uint8_t output[16];                                                    \
+        rijndael_encrypt_ref(&rijndael_backend, input, output);                \
+        CHECK_BUF_EQ(output, output_exp, sizeof(output));                      \
+        if (RIJNDAEL_AESNI_SUPPORTED())                                        \
+        {                                                                      \
+            rijndael_encrypt_aesni(&rijndael_backend, input, output);          \
+            CHECK_BUF_EQ(output, output_exp, sizeof(output));                  \
+        }                                                                      \
+        rijndael_encrypt(&rijndael_backend, input, output);                    \
+        CHECK_BUF_EQ(output, output_exp, sizeof(output));                      \
+    } while (0)
+
 #define RIJNDAEL_TEST_SET(key, round_keys, state, round_result, ciphertext)    \
     do                                                                         \
     {                                                                          \
+        RIJNDAEL_BACKEND_TEST_SET(key, state, ciphertext);                     \
         rijndael_st rijndael_state;                                            \
         rijndael_init(&rijndael_state, key);                                   \
         CHECK_BUF_EQ(round_keys, rijndael_state.round_keys,                    \
@@ -414,6 +456,8 @@ TEST(rijndael, o3gpp_ts_35_207_v17_0_0__test_set_1)
         },
     };
 
+    RIJNDAEL_BACKEND_TEST_SET(key, state, ciphertext);
+
     for (uint8_t round = 0; round < 11; ++round)
     {
         key_add(state, rijndael_state.round_keys, round);
@@ -1201,3 +1245,61 @@ TEST(rijndael, o3gpp_ts_35_207_v17_0_0__test_set_6)
     };
     RIJNDAEL_TEST_SET(key, round_keys, state, round_result, ciphertext);
 }
+
+/**
+ * Encrypt blocks under different keys with every multi-block backend supported
+ * by the CPU and compare with the reference implementation. The block count is
+ * not a multiple of any backend's width so the tail handling is covered too.
+ */
+TEST(rijndael, encrypt_multi_block)
+{
+    enum
+    {
+        count = 19,
+    };
+    rijndael_st state[count];
+    rijndael_st const *state_ptr[count];
+    uint8_t input[count][16];
+    uint8_t output_exp[count][16];
+    uint8_t output[count][16];
+
+    uint32_t seed = 0x5EED;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint8_t key[16];
+        for (uint8_t j = 0; j < 16; ++j)
+        {
+            seed = (seed * 1103515245U) + 12345U;
+            key[j] = (uint8_t)(seed >> 16U);
+            seed = (seed * 1103515245U) + 12345U;
+            input[i][j] = (uint8_t)(seed >> 16U);
+        }
+        rijndael_init(&state[i], key);
+        state_ptr[i] = &state[i];
+        rijndael_encrypt_ref(&state[i], input[i], output_exp[i]);
+    }
+
+    for (uint32_t n = 0; n <= count; n += count / 2U)
+    {
+        memset(output, 0, sizeof(output));
+        rijndael_encrypt_xN_bs(state_ptr, input, output, n);
+        CHECK_BUF_EQ(output, output_exp, n * 16U);
+
+        if (RIJNDAEL_AESNI_SUPPORTED())
+        {
+            memset(output, 0, sizeof(output));
+            rijndael_encrypt_xN_aesni(state_ptr, input, output, n);
+            CHECK_BUF_EQ(output, output_exp, n * 16U);
+        }
+        if (RIJNDAEL_VAES_SUPPORTED())
+        {
+            memset(output, 0, sizeof(output));
+            rijndael_encrypt_xN_vaes(state_ptr, input, output, n);
+            CHECK_BUF_EQ(output, output_exp, n * 16U);
+        }
+
+        memset(output, 0, sizeof(output));
+        rijndael_encrypt_xN(state_ptr, input, output, n);
+        CHECK_BUF_EQ(output, output_exp, n * 16U);
+    }
+}
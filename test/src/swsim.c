@@ -0,0 +1,402 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tau/tau.h>
+
+#include "swsim.h"
+#include "src/3gpp.c"
+#include "src/apdu.c"
+#include "src/apduh.c"
+#include "src/proactive.c"
+#include "src/swsim.c"
+
+/* The card image all tests run on, relative to the root of the repository. */
+#define CARD_PATH_JSON "data/usim.json"
+
+/* A whole card, kept on the heap since the states are large. */
+typedef struct card_s
+{
+    swsim_st swsim_state;
+    swicc_st swicc_state;
+} card_st;
+
+static card_st *card_create(void)
+{
+    card_st *const card = calloc(1U, sizeof(*card));
+    if (card != NULL &&
+        swsim_init(&card->swsim_state, &card->swicc_state, CARD_PATH_JSON,
+                   NULL) != 0)
+    {
+        free(card);
+        return NULL;
+    }
+    return card;
+}
+
+static void card_destroy(card_st *const card)
+{
+    swicc_terminate(&card->swicc_state);
+    free(card);
+}
+
+/* AID of ADF.USIM in data/usim.json. */
+static uint8_t const aid_usim[] = {0xA0, 0x00, 0x00, 0x00, 0x87, 0x10,
+                                   0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0x89,
+                                   0x17, 0x05, 0x00, 0x00};
+
+static int32_t card_usim_select(card_st *const card)
+{
+    uint8_t cmd[5U + sizeof(aid_usim)] = {0x00, 0xA4, 0x04, 0x04,
+                                          sizeof(aid_usim)};
+    memcpy(&cmd[5U], aid_usim, sizeof(aid_usim));
+    uint8_t rsp[258U];
+    uint32_t rsp_len = sizeof(rsp);
+    if (swsim_apdu_transact(&card->swsim_state, cmd, sizeof(cmd), rsp,
+                            &rsp_len) != 0 ||
+        rsp_len < 2U || rsp[rsp_len - 2U] != 0x90 || rsp[rsp_len - 1U] != 0x00)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * SELECT ADF.USIM with the FCP returned, which the terminal side collects with
+ * GET RESPONSE, and then READ BINARY by SFI which only swICC handles.
+ */
+TEST(swsim, select_res_get)
+{
+    card_st *const card = card_create();
+    REQUIRE_TRUE(card != NULL);
+
+    uint8_t cmd_select[5U + sizeof(aid_usim)] = {0x00, 0xA4, 0x04, 0x04,
+                                                 sizeof(aid_usim)};
+    memcpy(&cmd_select[5U], aid_usim, sizeof(aid_usim));
+    uint8_t rsp[258U];
+    uint32_t rsp_len = sizeof(rsp);
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_select,
+                                 sizeof(cmd_select), rsp, &rsp_len),
+             0);
+    REQUIRE_TRUE(rsp_len > 2U);
+    /* FCP template. */
+    CHECK_EQ(rsp[0U], 0x62);
+    CHECK_EQ(rsp[rsp_len - 2U], 0x90);
+    CHECK_EQ(rsp[rsp_len - 1U], 0x00);
+
+    /* EF.IMSI has SFI 07. */
+    uint8_t const cmd_read[] = {0x00, 0xB0, 0x87, 0x00, 0x09};
+    uint8_t const rsp_read_exp[] = {0x08, 0x99, 0x99, 0x99, 0x00, 0x00,
+                                    0x00, 0x00, 0x10, 0x90, 0x00};
+    rsp_len = sizeof(rsp);
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_read,
+                                 sizeof(cmd_read), rsp, &rsp_len),
+             0);
+    REQUIRE_EQ(rsp_len, sizeof(rsp_read_exp));
+    CHECK_BUF_EQ(rsp, rsp_read_exp, sizeof(rsp_read_exp));
+
+    card_destroy(card);
+}
+
+/**
+ * UPDATE BINARY is a case 3 command so its data is only sent after the card
+ * asks for it with ACK ALL.
+ */
+TEST(swsim, bin_update)
+{
+    card_st *const card = card_create();
+    REQUIRE_TRUE(card != NULL);
+    REQUIRE_EQ(card_usim_select(card), 0);
+
+    uint8_t rsp[258U];
+    uint32_t rsp_len = sizeof(rsp);
+    uint8_t const cmd_select[] = {0x00, 0xA4, 0x00, 0x0C, 0x02, 0x6F, 0x07};
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_select,
+                                 sizeof(cmd_select), rsp, &rsp_len),
+             0);
+    REQUIRE_EQ(rsp_len, 2U);
+    CHECK_EQ(rsp[0U], 0x90);
+    CHECK_EQ(rsp[1U], 0x00);
+
+    uint8_t const imsi[] = {0x08, 0x09, 0x10, 0x10, 0x32,
+                            0x54, 0x76, 0x98, 0x10};
+    uint8_t cmd_update[5U + sizeof(imsi)] = {0x00, 0xD6, 0x00, 0x00,
+                                             sizeof(imsi)};
+    memcpy(&cmd_update[5U], imsi, sizeof(imsi));
+    rsp_len = sizeof(rsp);
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_update,
+                                 sizeof(cmd_update), rsp, &rsp_len),
+             0);
+    REQUIRE_EQ(rsp_len, 2U);
+    CHECK_EQ(rsp[0U], 0x90);
+    CHECK_EQ(rsp[1U], 0x00);
+
+    uint8_t const cmd_read[] = {0x00, 0xB0, 0x00, 0x00, sizeof(imsi)};
+    rsp_len = sizeof(rsp);
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_read,
+                                 sizeof(cmd_read), rsp, &rsp_len),
+             0);
+    REQUIRE_EQ(rsp_len, sizeof(imsi) + 2U);
+    CHECK_BUF_EQ(rsp, imsi, sizeof(imsi));
+    CHECK_EQ(rsp[sizeof(imsi)], 0x90);
+    CHECK_EQ(rsp[sizeof(imsi) + 1U], 0x00);
+
+    card_destroy(card);
+}
+
+/**
+ * STATUS with a wrong Le gets 6CXX and is sent again with the right one, which
+ * must give the same response as the 61XX path of Le 0.
+ */
+TEST(swsim, le_resend)
+{
+    card_st *const card = card_create();
+    REQUIRE_TRUE(card != NULL);
+    REQUIRE_EQ(card_usim_select(card), 0);
+
+    uint8_t rsp_61xx[258U];
+    uint32_t rsp_61xx_len = sizeof(rsp_61xx);
+    uint8_t const cmd_le_0[] = {0x80, 0xF2, 0x00, 0x00, 0x00};
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_le_0,
+                                 sizeof(cmd_le_0), rsp_61xx, &rsp_61xx_len),
+             0);
+    REQUIRE_TRUE(rsp_61xx_len > 2U);
+    CHECK_EQ(rsp_61xx[rsp_61xx_len - 2U], 0x90);
+    CHECK_EQ(rsp_61xx[rsp_61xx_len - 1U], 0x00);
+
+    uint8_t rsp_6cxx[258U];
+    uint32_t rsp_6cxx_len = sizeof(rsp_6cxx);
+    uint8_t const cmd_le_1[] = {0x80, 0xF2, 0x00, 0x00, 0x01};
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_le_1,
+                                 sizeof(cmd_le_1), rsp_6cxx, &rsp_6cxx_len),
+             0);
+    REQUIRE_EQ(rsp_6cxx_len, rsp_61xx_len);
+    CHECK_BUF_EQ(rsp_6cxx, rsp_61xx, rsp_61xx_len);
+
+    card_destroy(card);
+}
+
+/* A GSM SELECT announces its response with 9FXX instead of 61XX. */
+TEST(swsim, gsm_9fxx)
+{
+    card_st *const card = card_create();
+    REQUIRE_TRUE(card != NULL);
+
+    uint8_t rsp[258U];
+    uint32_t rsp_len = sizeof(rsp);
+    uint8_t const cmd_select[] = {0xA0, 0xA4, 0x00, 0x00, 0x02, 0x3F, 0x00};
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd_select,
+                                 sizeof(cmd_select), rsp, &rsp_len),
+             0);
+    REQUIRE_TRUE(rsp_len > 2U);
+    CHECK_EQ(rsp[rsp_len - 2U], 0x90);
+    CHECK_EQ(rsp[rsp_len - 1U], 0x00);
+
+    card_destroy(card);
+}
+
+/**
+ * AUTHENTICATE in the USIM context with an AUTN made by the network side of
+ * Milenage using the same K and OPc as the card.
+ */
+TEST(swsim, authenticate)
+{
+    card_st *const card = card_create();
+    REQUIRE_TRUE(card != NULL);
+    REQUIRE_EQ(card_usim_select(card), 0);
+
+    uint8_t const rand[16U] = {0x23, 0x55, 0x3C, 0xBE, 0x96, 0x37,
+                               0xA8, 0x9D, 0x21, 0x8A, 0xE6, 0x4D,
+                               0xAE, 0x47, 0xBF, 0x35};
+    /* SEQ 1 with IND 0, fresh for a card that never authenticated. */
+    uint8_t const sqn[6U] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x20};
+    uint8_t const amf[2U] = {0x80, 0x00};
+    milenage_vec_st vec;
+    milenage_all(&card->swsim_state.milenage, rand, sqn, false, amf, &vec);
+
+    uint8_t cmd[5U + 1U + 16U + 1U + 16U + 1U] = {0x00, 0x88, 0x00, 0x81,
+                                                  0x22, 0x10};
+    memcpy(&cmd[6U], rand, sizeof(rand));
+    cmd[22U] = 0x10;
+    for (uint8_t i = 0U; i < sizeof(sqn); ++i)
+    {
+        cmd[23U + i] = (uint8_t)(sqn[i] ^ vec.ak[i]); /* Safe cast. */
+    }
+    memcpy(&cmd[29U], amf, sizeof(amf));
+    memcpy(&cmd[31U], vec.mac_a, sizeof(vec.mac_a));
+    cmd[39U] = 0x00;
+
+    uint8_t rsp[258U];
+    uint32_t rsp_len = sizeof(rsp);
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd, sizeof(cmd), rsp,
+                                 &rsp_len),
+             0);
+    REQUIRE_TRUE(rsp_len > 2U + 1U + sizeof(vec.res) + 1U + sizeof(vec.ck));
+    /* Successful 3G authentication. */
+    CHECK_EQ(rsp[0U], 0xDB);
+    CHECK_EQ(rsp[1U], sizeof(vec.res));
+    CHECK_BUF_EQ(&rsp[2U], vec.res, sizeof(vec.res));
+    CHECK_EQ(rsp[2U + sizeof(vec.res)], sizeof(vec.ck));
+    CHECK_BUF_EQ(&rsp[3U + sizeof(vec.res)], vec.ck, sizeof(vec.ck));
+    CHECK_EQ(rsp[rsp_len - 2U], 0x90);
+    CHECK_EQ(rsp[rsp_len - 1U], 0x00);
+
+    /* The same AUTN again is a replay so it gets a synchronisation failure. */
+    rsp_len = sizeof(rsp);
+    CHECK_EQ(swsim_apdu_transact(&card->swsim_state, cmd, sizeof(cmd), rsp,
+                                 &rsp_len),
+             0);
+    REQUIRE_TRUE(rsp_len > 2U);
+    CHECK_EQ(rsp[0U], 0xDC);
+
+    card_destroy(card);
+}
+
+#define SWSIM_TEST_CARD_COUNT 8U
+#define SWSIM_TEST_CARD_AUTH_COUNT 16U
+
+/* One card of the stress test and what it answered. */
+typedef struct swsim_test_card_s
+{
+    card_st *card;
+    uint32_t success_count;
+    /* Responses to STATUS, and to TERMINAL PROFILE or the FETCH after it. */
+    uint8_t rsp_status[258U];
+    uint32_t rsp_status_len;
+    uint8_t rsp_fetch[258U];
+    uint32_t rsp_fetch_len;
+} swsim_test_card_st;
+
+/**
+ * @brief Make a card and drive it through the APDU path like a terminal would:
+ * select ADF.USIM, authenticate many times with a fresh challenge each time,
+ * ask for the status, and then start the proactive session and fetch the first
+ * proactive command if there is one.
+ * @param[in, out] arg The card.
+ * @return NULL.
+ */
+static void *swsim_test_card_run(void *const arg)
+{
+    swsim_test_card_st *const test_card = arg;
+    card_st *const card = card_create();
+    test_card->card = card;
+    if (card == NULL || card_usim_select(card) != 0)
+    {
+        return NULL;
+    }
+
+    uint8_t rsp[258U];
+    uint32_t rsp_len;
+    for (uint32_t i = 0U; i < SWSIM_TEST_CARD_AUTH_COUNT; ++i)
+    {
+        uint8_t rand[16U] = {0x23, 0x55};
+        /* Safe cast since only the lowest byte is kept. */
+        rand[15U] = (uint8_t)i;
+        /* SEQ i + 1 with IND 0. */
+        uint32_t const seq = (i + 1U) << MILENAGE_SQN_IND_LEN;
+        /* Safe casts since only the lowest 2 bytes are kept. */
+        uint8_t const sqn[6U] = {0x00, 0x00, 0x00, 0x00, (uint8_t)(seq >> 8U),
+                                 (uint8_t)seq};
+        uint8_t const amf[2U] = {0x80, 0x00};
+        milenage_vec_st vec;
+        milenage_all(&card->swsim_state.milenage, rand, sqn, false, amf, &vec);
+
+        uint8_t cmd[5U + 1U + 16U + 1U + 16U + 1U] = {0x00, 0x88, 0x00, 0x81,
+                                                      0x22, 0x10};
+        memcpy(&cmd[6U], rand, sizeof(rand));
+        cmd[22U] = 0x10;
+        for (uint8_t j = 0U; j < sizeof(sqn); ++j)
+        {
+            cmd[23U + j] = (uint8_t)(sqn[j] ^ vec.ak[j]); /* Safe cast. */
+        }
+        memcpy(&cmd[29U], amf, sizeof(amf));
+        memcpy(&cmd[31U], vec.mac_a, sizeof(vec.mac_a));
+        cmd[39U] = 0x00;
+
+        rsp_len = sizeof(rsp);
+        if (swsim_apdu_transact(&card->swsim_state, cmd, sizeof(cmd), rsp,
+                                &rsp_len) == 0 &&
+            rsp_len > 2U + 1U + sizeof(vec.res) && rsp[0U] == 0xDB &&
+            memcmp(&rsp[2U], vec.res, sizeof(vec.res)) == 0)
+        {
+            ++test_card->success_count;
+        }
+    }
+
+    uint8_t const cmd_status[] = {0x80, 0xF2, 0x00, 0x00, 0x00};
+    test_card->rsp_status_len = sizeof(test_card->rsp_status);
+    if (swsim_apdu_transact(&card->swsim_state, cmd_status, sizeof(cmd_status),
+                            test_card->rsp_status,
+                            &test_card->rsp_status_len) != 0)
+    {
+        test_card->rsp_status_len = 0U;
+    }
+
+    uint8_t const cmd_profile[] = {0x80, 0x10, 0x00, 0x00, 0x04,
+                                   0xFF, 0xFF, 0xFF, 0xFF};
+    test_card->rsp_fetch_len = sizeof(test_card->rsp_fetch);
+    if (swsim_apdu_transact(&card->swsim_state, cmd_profile,
+                            sizeof(cmd_profile), test_card->rsp_fetch,
+                            &test_card->rsp_fetch_len) != 0)
+    {
+        test_card->rsp_fetch_len = 0U;
+    }
+    else if (test_card->rsp_fetch_len == 2U && test_card->rsp_fetch[0U] == 0x91)
+    {
+        /* A proactive command is pending, SW2 is its length. */
+        uint8_t const cmd_fetch[] = {0x80, 0x12, 0x00, 0x00,
+                                     test_card->rsp_fetch[1U]};
+        test_card->rsp_fetch_len = sizeof(test_card->rsp_fetch);
+        if (swsim_apdu_transact(&card->swsim_state, cmd_fetch,
+                                sizeof(cmd_fetch), test_card->rsp_fetch,
+                                &test_card->rsp_fetch_len) != 0)
+        {
+            test_card->rsp_fetch_len = 0U;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Whole cards share no mutable state so each can be made and driven by its own
+ * thread without locks. Build with 'make test-tsan' to have ThreadSanitizer
+ * check this.
+ */
+TEST(swsim, threads)
+{
+    static swsim_test_card_st card_ref;
+    static swsim_test_card_st card[SWSIM_TEST_CARD_COUNT];
+
+    swsim_test_card_run(&card_ref);
+    REQUIRE_TRUE(card_ref.card != NULL);
+    CHECK_EQ(card_ref.success_count, SWSIM_TEST_CARD_AUTH_COUNT);
+    REQUIRE_TRUE(card_ref.rsp_status_len > 2U);
+    CHECK_EQ(card_ref.rsp_status[card_ref.rsp_status_len - 2U], 0x90);
+    REQUIRE_TRUE(card_ref.rsp_fetch_len >= 2U);
+    card_destroy(card_ref.card);
+
+    pthread_t thread[SWSIM_TEST_CARD_COUNT];
+    uint32_t thread_count = 0U;
+    for (; thread_count < SWSIM_TEST_CARD_COUNT; ++thread_count)
+    {
+        if (pthread_create(&thread[thread_count], NULL, swsim_test_card_run,
+                           &card[thread_count]) != 0)
+        {
+            break;
+        }
+    }
+    CHECK_EQ(thread_count, SWSIM_TEST_CARD_COUNT);
+
+    for (uint32_t i = 0U; i < thread_count; ++i)
+    {
+        pthread_join(thread[i], NULL);
+        REQUIRE_TRUE(card[i].card != NULL);
+        CHECK_EQ(card[i].success_count, SWSIM_TEST_CARD_AUTH_COUNT);
+        REQUIRE_EQ(card[i].rsp_status_len, card_ref.rsp_status_len);
+        CHECK_BUF_EQ(card[i].rsp_status, card_ref.rsp_status,
+                     card_ref.rsp_status_len);
+        REQUIRE_EQ(card[i].rsp_fetch_len, card_ref.rsp_fetch_len);
+        CHECK_BUF_EQ(card[i].rsp_fetch, card_ref.rsp_fetch,
+                     card_ref.rsp_fetch_len);
+        card_destroy(card[i].card);
+    }
+}
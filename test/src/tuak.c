@@ -0,0 +1,205 @@
+#include <string.h>
+#include <tau/tau.h>
+
+#include "tuak.h"
+#include "src/tuak.c"
+
+/**
+ * @brief Fill a buffer with pseudo-random bytes.
+ * @param[in, out] seed State of the generator.
+ * @param[out] buf
+ * @param[in] len Length of the buffer.
+ */
+static void tuak_test_random(uint32_t *const seed, uint8_t *const buf,
+                             uint32_t const len)
+{
+    for (uint32_t i = 0U; i < len; ++i)
+    {
+        *seed = (*seed * 1103515245U) + 12345U;
+        /* Safe cast since only the top byte is kept. */
+        buf[i] = (uint8_t)(*seed >> 24U);
+    }
+}
+
+/* Test set 1 of ETSI TS 135 232 V17.0.0 clause.6.3 (128-bit K, 1 iteration). */
+TEST(tuak, test_set_1)
+{
+    tuak_st tuak = {.iter = 1U};
+    uint8_t k[16U];
+    uint8_t top[32U];
+    uint8_t rand[16U];
+    uint8_t sqn[6U];
+    uint8_t const amf[2U] = {0xFF, 0xFF};
+    memset(k, 0xAB, sizeof(k));
+    memset(top, 0x55, sizeof(top));
+    memset(rand, 0x42, sizeof(rand));
+    memset(sqn, 0x11, sizeof(sqn));
+
+    uint8_t const top_c_exp[32U] = {
+        0xBD, 0x04, 0xD9, 0x53, 0x0E, 0x87, 0x51, 0x3C,
+        0x5D, 0x83, 0x7A, 0xC2, 0xAD, 0x95, 0x46, 0x23,
+        0xA8, 0xE2, 0x33, 0x0C, 0x11, 0x53, 0x05, 0xA7,
+        0x3E, 0xB4, 0x5D, 0x1F, 0x40, 0xCC, 0xCB, 0xFF,
+    };
+    uint8_t const mac_a_exp[8U] = {0xF9, 0xA5, 0x4E, 0x6A,
+                                   0xEA, 0xA8, 0x61, 0x8D};
+    uint8_t const mac_s_exp[8U] = {0xE9, 0x4B, 0x4D, 0xC6,
+                                   0xC7, 0x29, 0x7D, 0xF3};
+    uint8_t const res_exp[4U] = {0x65, 0x7A, 0xCD, 0x64};
+    uint8_t const ck_exp[16U] = {
+        0xD7, 0x1A, 0x1E, 0x5C, 0x6C, 0xAF, 0xFE, 0x98,
+        0x6A, 0x26, 0xF7, 0x83, 0xE5, 0xC7, 0x8B, 0xE1,
+    };
+    uint8_t const ik_exp[16U] = {
+        0xBE, 0x84, 0x9F, 0xA2, 0x56, 0x4F, 0x86, 0x9A,
+        0xEC, 0xEE, 0x6F, 0x62, 0xD4, 0x33, 0x7E, 0x72,
+    };
+    uint8_t const ak_exp[6U] = {0x71, 0x9F, 0x1E, 0x9B, 0x90, 0x54};
+
+    CHECK_EQ(tuak_k_set(&tuak, k, sizeof(k)), 0);
+    tuak_top_set(&tuak, top);
+    CHECK_BUF_EQ(tuak.top_c, top_c_exp, sizeof(top_c_exp));
+
+    milenage_vec_st vec;
+    tuak_all(&tuak, rand, sqn, false, amf, &vec);
+    CHECK_BUF_EQ(vec.mac_a, mac_a_exp, sizeof(mac_a_exp));
+    CHECK_BUF_EQ(vec.mac_s, mac_s_exp, sizeof(mac_s_exp));
+
+    /**
+     * The test set uses a 32-bit RES, so f2-f5 are run with the INSTANCE of
+     * that length instead of the 64-bit one tuak_all uses.
+     */
+    uint64_t state[1U][KECCAK_STATE_LANES];
+    uint8_t outcore[KECCAK_STATE_LANES * 8U];
+    uint8_t res[4U];
+    uint8_t ck[16U];
+    uint8_t ik[16U];
+    uint8_t ak[6U];
+    f2345_in(&tuak, 0x40, rand, state[0U]);
+    core_xN(state, &tuak.iter, 1U);
+    state_store(state[0U], outcore);
+    outcore_pull(outcore, TUAK_POS_RES, res, sizeof(res));
+    outcore_pull(outcore, TUAK_POS_CK, ck, sizeof(ck));
+    outcore_pull(outcore, TUAK_POS_IK, ik, sizeof(ik));
+    outcore_pull(outcore, TUAK_POS_AK, ak, sizeof(ak));
+    CHECK_BUF_EQ(res, res_exp, sizeof(res_exp));
+    CHECK_BUF_EQ(ck, ck_exp, sizeof(ck_exp));
+    CHECK_BUF_EQ(ik, ik_exp, sizeof(ik_exp));
+    CHECK_BUF_EQ(ak, ak_exp, sizeof(ak_exp));
+}
+
+TEST(tuak, k_len)
+{
+    tuak_st tuak = {.iter = 1U};
+    uint8_t k[TUAK_K_LEN_MAX] = {0U};
+    CHECK_EQ(tuak_k_set(&tuak, k, 20U), -1);
+    CHECK_EQ(tuak_k_set(&tuak, k, 16U), 0);
+    CHECK_EQ(tuak_k_set(&tuak, k, 32U), 0);
+
+    /**
+     * A 128-bit key is zero-extended but INSTANCE still tells it apart from
+     * the same key given as 256 bits.
+     */
+    uint8_t const top[32U] = {0x55};
+    uint8_t top_c_k128[32U];
+    memset(k, 0xAB, 16U);
+    tuak_k_set(&tuak, k, 16U);
+    tuak_top_set(&tuak, top);
+    memcpy(top_c_k128, tuak.top_c, sizeof(top_c_k128));
+    tuak_k_set(&tuak, k, 32U);
+    tuak_top_set(&tuak, top);
+    CHECK_BUF_NE(top_c_k128, tuak.top_c, sizeof(top_c_k128));
+}
+
+TEST(tuak, all_batch)
+{
+    enum
+    {
+        count = TUAK_XN_CHUNK + 5,
+    };
+    tuak_st tuak[count];
+    tuak_st const *tuak_ptr[count];
+    uint8_t rand[count][16];
+    uint8_t sqn[count][6];
+    uint8_t amf[count][2];
+    milenage_vec_st vec[count];
+    milenage_vec_st vec_exp[count];
+
+    uint32_t seed = 0x7A3C;
+    for (uint32_t i = 0U; i < count; ++i)
+    {
+        uint8_t k[TUAK_K_LEN_MAX];
+        uint8_t top[32U];
+        tuak_test_random(&seed, k, sizeof(k));
+        tuak_test_random(&seed, top, sizeof(top));
+        tuak_k_set(&tuak[i], k, i % 3U == 0U ? 32U : 16U);
+        /* Mixed iteration counts are handled per tuple. */
+        tuak[i].iter = i % 4U == 1U ? 2U : 1U;
+        tuak_top_set(&tuak[i], top);
+        tuak_ptr[i] = &tuak[i];
+    }
+    tuak_test_random(&seed, &rand[0][0], sizeof(rand));
+    tuak_test_random(&seed, &sqn[0][0], sizeof(sqn));
+    tuak_test_random(&seed, &amf[0][0], sizeof(amf));
+
+    for (uint32_t i = 0U; i < count; ++i)
+    {
+        tuak_all(&tuak[i], rand[i], sqn[i], true, amf[i], &vec_exp[i]);
+    }
+    tuak_all_xN(tuak_ptr, rand, sqn, true, amf, vec, count);
+    CHECK_BUF_EQ(vec, vec_exp, sizeof(vec));
+
+    /* SQN was unconcealed with AK. */
+    for (uint32_t i = 0U; i < 6U; ++i)
+    {
+        CHECK_EQ(vec[0].sqn[i], sqn[0][i] ^ vec[0].ak[i]);
+    }
+}
+
+/* TUAK takes over AUTHENTICATE and shares the SQN handling with Milenage. */
+TEST(tuak, authenticate)
+{
+    tuak_st tuak = {.iter = 1U};
+    uint8_t const k[32U] = {0x11, 0x22, 0x33, 0x44};
+    uint8_t const top[32U] = {0x5A};
+    tuak_k_set(&tuak, k, sizeof(k));
+    tuak_top_set(&tuak, top);
+
+    /* Milenage parameters were never validated but are not needed. */
+    milenage_st milenage_param = {0};
+    milenage_param.algo = MILENAGE_ALGO_TUAK;
+    milenage_param.tuak = &tuak;
+    milenage_sqn_array_set(&milenage_param, NULL);
+
+    uint8_t const rand[16U] = {0x42, 0x42};
+    uint8_t const sqn[6U] = {0x00, 0x00, 0x00, 0x00, 0x01, 0x20};
+    uint8_t const amf[2U] = {0x80, 0x00};
+    milenage_vec_st vec;
+    tuak_all(&tuak, rand, sqn, false, amf, &vec);
+
+    uint8_t autn[16U];
+    for (uint32_t i = 0U; i < 6U; ++i)
+    {
+        autn[i] = sqn[i] ^ vec.ak[i];
+    }
+    memcpy(&autn[6U], amf, sizeof(amf));
+    memcpy(&autn[8U], vec.mac_a, sizeof(vec.mac_a));
+
+    uint8_t output[SWICC_DATA_MAX];
+    uint16_t output_len = 0U;
+    CHECK_EQ(milenage(&milenage_param, rand, autn, output, &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0U], 0xDB);
+    CHECK_EQ(output[1U], sizeof(vec.res));
+    CHECK_BUF_EQ(&output[2U], vec.res, sizeof(vec.res));
+    CHECK_BUF_EQ(&output[3U + sizeof(vec.res)], vec.ck, sizeof(vec.ck));
+
+    /* A retransmit gets the same response and a wrong MAC gets rejected. */
+    CHECK_EQ(milenage(&milenage_param, rand, autn, output, &output_len),
+             SWICC_RET_SUCCESS);
+    CHECK_EQ(output[0U], 0xDB);
+    CHECK_EQ(milenage_param.cache.hit, 1U);
+    autn[15U] ^= 0x01;
+    CHECK_EQ(milenage(&milenage_param, rand, autn, output, &output_len),
+             SWICC_RET_ERROR);
+}
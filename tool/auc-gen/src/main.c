@@ -0,0 +1,778 @@
+#include "kdf.h"
+#include "milenage.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Vectors in one unit of work. Multiple of the Milenage batch size. */
+#define AUC_CHUNK (MILENAGE_XN_CHUNK * 4U)
+/* Per-worker output buffer, flushed to the output in one write. */
+#define AUC_OUT_BUF_SIZE (1U << 20U)
+/* Longest record in any format (CSV is the longest). */
+#define AUC_RCRD_LEN_MAX 512U
+/* Per TS 33.102 Annex C.3.2 SQN = SEQ || IND with a 5 bit IND. */
+#define AUC_SQN_IND_LEN 5U
+
+typedef enum auc_fmt_e
+{
+    AUC_FMT_CSV,
+    AUC_FMT_BIN,
+} auc_fmt_et;
+
+typedef struct auc_sub_s
+{
+    char imsi[16]; /* At most 15 digits, NUL-terminated. */
+    uint8_t k[16];
+    uint8_t op_c[16];
+    uint8_t sqn[6]; /* SQN of the first vector. */
+} auc_sub_st;
+
+typedef struct auc_worker_s auc_worker_st;
+typedef struct auc_s
+{
+    auc_sub_st *sub;
+    uint64_t sub_count;
+    uint32_t vec_count; /* Vectors per subscriber. */
+    uint64_t vec_total;
+    uint32_t chunk_total;
+    uint8_t amf[2];
+    uint64_t seed;
+    auc_fmt_et fmt;
+    /* When set, 5G AKA keys are derived for every vector (see kdf_5g_aka). */
+    uint8_t snn[KDF_SNN_LEN_MAX];
+    uint8_t snn_len;
+
+    /* Holds the standard Milenage constants, K and OPc are set per vector. */
+    milenage_st param;
+
+    FILE *out;
+    pthread_mutex_t out_mutex;
+
+    auc_worker_st *worker;
+    uint32_t worker_count;
+} auc_st;
+
+/**
+ * Every worker owns a range of chunks [begin, end) which it consumes from the
+ * front. Once it runs out, it steals the back half of the range of another
+ * worker. Both ends are packed into one word (begin in the low half) so taking
+ * and stealing are a single compare-and-swap.
+ */
+struct auc_worker_s
+{
+    _Atomic uint64_t range;
+    auc_st *auc;
+    uint32_t id;
+    pthread_t thread;
+    uint64_t stolen;
+    uint32_t out_len;
+    uint8_t out_buf[AUC_OUT_BUF_SIZE];
+};
+
+static void print_usage(char const *const arg0)
+{
+    fprintf(
+        stderr,
+        "\nUsage: %s --keys <path> [--count <n>] [--format <csv | bin>] [--out <path>] [--threads <n>] [--amf <hex>] [--seed <n>] [--snn <name>]"
+        "\nThis tool generates authentication vectors (what an AuC/HSS would send to the network) for many subscribers using the same Milenage implementation as swSIM."
+        "\n- Keys is a file with one subscriber per line: 'IMSI K OPc SQN' where K and OPc are 32 hex digits and SQN is 12 hex digits. Empty lines and lines starting with '#' are ignored."
+        "\n- Count is the number of vectors per subscriber (default 1). The SQN of each next vector has its SEQ incremented and its IND unchanged (TS 33.102 Annex C)."
+        "\n- Format is 'csv' (default) with columns 'imsi,sqn,rand,autn,xres,ck,ik,kc,ak_star' or 'bin' with fixed 108 byte records of the same fields where the IMSI is 16 NUL-padded ASCII characters. AK* unconceals the SQN of the card in an AUTS. The MAC-S of an AUTS is not included since it covers the SQN of the card and the dummy AMF 0000, not the SQN and AMF of the vector (TS 33.102 clause 6.3.3)."
+        "\n- Out is the output file (default stdout)."
+        "\n- Threads is the number of workers (default is the number of online cores). Every thread count gives the same set of records, but with more than one thread the order of the records is unspecified since each worker writes out its buffer whenever it fills. Use 1 thread to get the records ordered by subscriber and then by SQN."
+        "\n- AMF is 4 hex digits (default 8000)."
+        "\n- SNN is the serving network name (e.g. '5G:mnc001.mcc001.3gppnetwork.org'). When given, every record ends with the 'xres_star' and 'kausf' 5G AKA fields (156 byte binary records)."
+        "\n- Seed selects the RAND values (default is based on the time). RAND is not cryptographically random, this is for load tests only."
+        "\n",
+        arg0);
+}
+
+/**
+ * @brief Decode a hex string of an exact length.
+ * @param[in] hex Hex string.
+ * @param[out] bin Where the decoded bytes are written.
+ * @param[in] bin_len Expected number of bytes.
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t hex_decode(char const *const hex, uint8_t *const bin,
+                          uint32_t const bin_len)
+{
+    if (strlen(hex) != bin_len * 2U)
+    {
+        return -1;
+    }
+    for (uint32_t i = 0; i < bin_len * 2U; ++i)
+    {
+        char const c = hex[i];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9')
+        {
+            nibble = (uint8_t)(c - '0');
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            nibble = (uint8_t)(c - 'A' + 10);
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            nibble = (uint8_t)(c - 'a' + 10);
+        }
+        else
+        {
+            return -1;
+        }
+        if (i % 2U == 0U)
+        {
+            bin[i / 2U] = (uint8_t)(nibble << 4U);
+        }
+        else
+        {
+            bin[i / 2U] |= nibble;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Encode bytes as upper case hex.
+ * @param[in] bin Bytes to encode.
+ * @param[in] bin_len Number of bytes.
+ * @param[out] hex Where bin_len * 2 characters are written (no NUL).
+ * @return Number of characters written.
+ */
+static uint32_t hex_encode(uint8_t const *const bin, uint32_t const bin_len,
+                           uint8_t *const hex)
+{
+    static char const digit[] = "0123456789ABCDEF";
+    for (uint32_t i = 0; i < bin_len; ++i)
+    {
+        hex[i * 2U] = (uint8_t)digit[bin[i] >> 4U];
+        hex[(i * 2U) + 1U] = (uint8_t)digit[bin[i] & 0x0FU];
+    }
+    return bin_len * 2U;
+}
+
+/**
+ * @brief Load all subscribers from a key file.
+ * @param[in, out] auc Subscribers are written here.
+ * @param[in] path Path to the key file.
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t keys_load(auc_st *const auc, char const *const path)
+{
+    FILE *const f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Failed to open key file '%s'.\n", path);
+        return -1;
+    }
+
+    uint64_t sub_max = 0;
+    char line[256];
+    uint64_t line_num = 0;
+    int32_t ret = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        ++line_num;
+        char imsi[32];
+        char k[48];
+        char op_c[48];
+        char sqn[32];
+        if (line[0] == '#' || sscanf(line, "%31s", imsi) != 1)
+        {
+            continue;
+        }
+        if (sscanf(line, "%31s %47s %47s %31s", imsi, k, op_c, sqn) != 4)
+        {
+            fprintf(stderr, "Key file line %" PRIu64 " is incomplete.\n",
+                    line_num);
+            ret = -1;
+            break;
+        }
+
+        if (auc->sub_count == sub_max)
+        {
+            sub_max = sub_max == 0 ? 1024U : sub_max * 2U;
+            auc_sub_st *const sub = realloc(auc->sub, sub_max * sizeof(*sub));
+            if (sub == NULL)
+            {
+                fprintf(stderr, "Failed to allocate subscribers.\n");
+                ret = -1;
+                break;
+            }
+            auc->sub = sub;
+        }
+        auc_sub_st *const sub = &auc->sub[auc->sub_count];
+
+        uint64_t const imsi_len = strlen(imsi);
+        bool imsi_valid = imsi_len >= 6U && imsi_len < sizeof(sub->imsi);
+        for (uint64_t i = 0; imsi_valid && i < imsi_len; ++i)
+        {
+            imsi_valid = imsi[i] >= '0' && imsi[i] <= '9';
+        }
+        if (!imsi_valid || hex_decode(k, sub->k, sizeof(sub->k)) != 0 ||
+            hex_decode(op_c, sub->op_c, sizeof(sub->op_c)) != 0 ||
+            hex_decode(sqn, sub->sqn, sizeof(sub->sqn)) != 0)
+        {
+            fprintf(stderr, "Key file line %" PRIu64 " is invalid.\n",
+                    line_num);
+            ret = -1;
+            break;
+        }
+        memset(sub->imsi, 0, sizeof(sub->imsi));
+        memcpy(sub->imsi, imsi, imsi_len);
+        ++auc->sub_count;
+    }
+    fclose(f);
+
+    if (ret == 0 && auc->sub_count == 0)
+    {
+        fprintf(stderr, "Key file has no subscribers.\n");
+        ret = -1;
+    }
+    return ret;
+}
+
+static uint64_t range_pack(uint32_t const begin, uint32_t const end)
+{
+    return ((uint64_t)end << 32U) | begin;
+}
+
+/**
+ * @brief Take the next chunk from the front of the range of a worker.
+ * @param[in, out] worker Worker whose range to take from.
+ * @param[out] chunk Index of the taken chunk.
+ * @return True if a chunk was taken, false if the range is empty.
+ */
+static bool chunk_take(auc_worker_st *const worker, uint32_t *const chunk)
+{
+    uint64_t range = atomic_load(&worker->range);
+    while (1)
+    {
+        /* Safe casts since the range holds two 32-bit values. */
+        uint32_t const begin = (uint32_t)range;
+        uint32_t const end = (uint32_t)(range >> 32U);
+        if (begin >= end)
+        {
+            return false;
+        }
+        if (atomic_compare_exchange_weak(&worker->range, &range,
+                                         range_pack(begin + 1U, end)))
+        {
+            *chunk = begin;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Steal the back half of the range of some other worker.
+ * @param[in, out] worker Worker that steals, its range must be empty.
+ * @return True if some chunks were stolen, false if all workers ran out.
+ */
+static bool chunk_steal(auc_worker_st *const worker)
+{
+    auc_st const *const auc = worker->auc;
+    for (uint32_t i = 1; i < auc->worker_count; ++i)
+    {
+        auc_worker_st *const victim =
+            &auc->worker[(worker->id + i) % auc->worker_count];
+        uint64_t range = atomic_load(&victim->range);
+        while (1)
+        {
+            /* Safe casts since the range holds two 32-bit values. */
+            uint32_t const begin = (uint32_t)range;
+            uint32_t const end = (uint32_t)(range >> 32U);
+            if (begin >= end)
+            {
+                break;
+            }
+            uint32_t const mid = end - ((end - begin + 1U) / 2U);
+            if (atomic_compare_exchange_weak(&victim->range, &range,
+                                             range_pack(begin, mid)))
+            {
+                atomic_store(&worker->range, range_pack(mid, end));
+                worker->stolen += end - mid;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Deterministic RAND for a vector so that the output only depends on
+ * the seed and not on which worker computed the vector (SplitMix64).
+ * @param[in] seed Seed of the run.
+ * @param[in] vec_idx Global index of the vector.
+ * @param[out] rand Where RAND is written.
+ */
+static void rand_get(uint64_t const seed, uint64_t const vec_idx,
+                     uint8_t rand[const 16])
+{
+    for (uint32_t half = 0; half < 2U; ++half)
+    {
+        uint64_t z =
+            seed + (((vec_idx * 2U) + half + 1U) * 0x9E3779B97F4A7C15U);
+        z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9U;
+        z = (z ^ (z >> 27U)) * 0x94D049BB133111EBU;
+        z ^= z >> 31U;
+        for (uint32_t i = 0; i < 8U; ++i)
+        {
+            /* Safe cast since only the lowest byte is kept. */
+            rand[(half * 8U) + i] = (uint8_t)(z >> (56U - (i * 8U)));
+        }
+    }
+}
+
+/**
+ * @brief SQN of the n-th vector of a subscriber, i.e. SEQ incremented n times.
+ * @param[in] sqn_first SQN of the first vector.
+ * @param[in] n Index of the vector of the subscriber.
+ * @param[out] sqn Where the SQN is written.
+ */
+static void sqn_get(uint8_t const sqn_first[const 6], uint32_t const n,
+                    uint8_t sqn[const 6])
+{
+    uint64_t v = 0;
+    for (uint32_t i = 0; i < 6U; ++i)
+    {
+        v = (v << 8U) | sqn_first[i];
+    }
+    v += (uint64_t)n << AUC_SQN_IND_LEN;
+    for (uint32_t i = 0; i < 6U; ++i)
+    {
+        /* Safe cast since only the lowest byte is kept. */
+        sqn[5U - i] = (uint8_t)(v >> (i * 8U));
+    }
+}
+
+static void out_flush(auc_worker_st *const worker)
+{
+    if (worker->out_len == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&worker->auc->out_mutex);
+    fwrite(worker->out_buf, 1U, worker->out_len, worker->auc->out);
+    pthread_mutex_unlock(&worker->auc->out_mutex);
+    worker->out_len = 0;
+}
+
+static void rcrd_write(auc_worker_st *const worker, auc_sub_st const *const sub,
+                       uint8_t const rand[const 16],
+                       milenage_vec_st const *const vec,
+                       uint8_t const autn[const 16],
+                       kdf_5g_st const *const keys_5g)
+{
+    auc_st const *const auc = worker->auc;
+    if (worker->out_len + AUC_RCRD_LEN_MAX > sizeof(worker->out_buf))
+    {
+        out_flush(worker);
+    }
+
+    struct
+    {
+        uint8_t const *buf;
+        uint32_t len;
+    } const field[] = {
+        {vec->sqn, sizeof(vec->sqn)},   {rand, 16U},
+        {autn, 16U},                    {vec->res, sizeof(vec->res)},
+        {vec->ck, sizeof(vec->ck)},     {vec->ik, sizeof(vec->ik)},
+        {vec->kc, sizeof(vec->kc)},     {vec->ak_star, sizeof(vec->ak_star)},
+        {keys_5g->res_star, sizeof(keys_5g->res_star)},
+        {keys_5g->kausf, sizeof(keys_5g->kausf)},
+    };
+    /* The 5G fields are last and only present with a serving network name. */
+    uint32_t const field_count =
+        (sizeof(field) / sizeof(field[0])) - (auc->snn_len > 0U ? 0U : 2U);
+
+    uint8_t *const out = &worker->out_buf[worker->out_len];
+    uint32_t len = 0;
+    if (auc->fmt == AUC_FMT_CSV)
+    {
+        /* Safe cast since the IMSI is at most 15 characters. */
+        uint32_t const imsi_len = (uint32_t)strlen(sub->imsi);
+        memcpy(out, sub->imsi, imsi_len);
+        len += imsi_len;
+        for (uint32_t i = 0; i < field_count; ++i)
+        {
+            out[len++] = ',';
+            len += hex_encode(field[i].buf, field[i].len, &out[len]);
+        }
+        out[len++] = '\n';
+    }
+    else
+    {
+        memcpy(out, sub->imsi, sizeof(sub->imsi));
+        len += sizeof(sub->imsi);
+        for (uint32_t i = 0; i < field_count; ++i)
+        {
+            memcpy(&out[len], field[i].buf, field[i].len);
+            len += field[i].len;
+        }
+    }
+    worker->out_len += len;
+}
+
+static void chunk_run(auc_worker_st *const worker, uint32_t const chunk)
+{
+    auc_st const *const auc = worker->auc;
+    uint64_t const vec_first = (uint64_t)chunk * AUC_CHUNK;
+    /* Safe cast since a chunk has at most AUC_CHUNK vectors. */
+    uint32_t const count = (uint32_t)(auc->vec_total - vec_first < AUC_CHUNK
+                                          ? auc->vec_total - vec_first
+                                          : AUC_CHUNK);
+
+    milenage_st param[AUC_CHUNK];
+    milenage_st const *param_vec[AUC_CHUNK] = {NULL};
+    auc_sub_st const *sub_vec[AUC_CHUNK];
+    uint8_t rand[AUC_CHUNK][16];
+    uint8_t sqn[AUC_CHUNK][6];
+    uint8_t amf[AUC_CHUNK][2];
+    milenage_vec_st vec[AUC_CHUNK];
+    uint8_t autn[AUC_CHUNK][16];
+    kdf_5g_st keys_5g[AUC_CHUNK];
+
+    /* Consecutive vectors of one subscriber share the key schedule. */
+    uint32_t param_count = 0;
+    uint64_t sub_idx_last = UINT64_MAX;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint64_t const vec_idx = vec_first + i;
+        uint64_t const sub_idx = vec_idx / auc->vec_count;
+        auc_sub_st const *const sub = &auc->sub[sub_idx];
+        if (sub_idx != sub_idx_last)
+        {
+            milenage_st *const p = &param[param_count++];
+            memcpy(p, &auc->param, sizeof(*p));
+            memcpy(p->op_c, sub->op_c, sizeof(p->op_c));
+            milenage_k_set(p, sub->k);
+            sub_idx_last = sub_idx;
+        }
+        param_vec[i] = &param[param_count - 1U];
+        sub_vec[i] = sub;
+        rand_get(auc->seed, vec_idx, rand[i]);
+        /* Safe cast since the remainder is less than vec_count. */
+        sqn_get(sub->sqn, (uint32_t)(vec_idx % auc->vec_count), sqn[i]);
+        memcpy(amf[i], auc->amf, sizeof(amf[i]));
+    }
+
+    milenage_all_xN(param_vec, rand, sqn, false, amf, vec, count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        /* AUTN = SQN ^ AK || AMF || MAC-A per TS 33.102 clause 6.3.2. */
+        for (uint32_t j = 0; j < 6U; ++j)
+        {
+            autn[i][j] = vec[i].sqn[j] ^ vec[i].ak[j];
+        }
+        memcpy(&autn[i][6], amf[i], sizeof(amf[i]));
+        memcpy(&autn[i][8], vec[i].mac_a, sizeof(vec[i].mac_a));
+        if (auc->snn_len > 0U)
+        {
+            kdf_5g_aka(vec[i].ck, vec[i].ik, vec[i].res, sizeof(vec[i].res),
+                       rand[i], autn[i], auc->snn, auc->snn_len,
+                       &keys_5g[i]);
+        }
+        rcrd_write(worker, sub_vec[i], rand[i], &vec[i], autn[i],
+                   &keys_5g[i]);
+    }
+}
+
+static void *worker_main(void *const arg)
+{
+    auc_worker_st *const worker = arg;
+    uint32_t chunk;
+    do
+    {
+        while (chunk_take(worker, &chunk))
+        {
+            chunk_run(worker, chunk);
+        }
+    } while (chunk_steal(worker));
+    out_flush(worker);
+    return NULL;
+}
+
+/**
+ * @brief Generate all vectors using a pool of workers.
+ * @param[in, out] auc Generator state.
+ * @return 0 on success, -1 on failure.
+ */
+static int32_t auc_run(auc_st *const auc)
+{
+    auc->worker = calloc(auc->worker_count, sizeof(*auc->worker));
+    if (auc->worker == NULL)
+    {
+        fprintf(stderr, "Failed to allocate workers.\n");
+        return -1;
+    }
+
+    /* Split all chunks evenly, stealing balances out the rest. */
+    for (uint32_t i = 0; i < auc->worker_count; ++i)
+    {
+        auc_worker_st *const worker = &auc->worker[i];
+        /* Safe casts since the bounds are at most chunk_total. */
+        uint32_t const begin =
+            (uint32_t)(((uint64_t)auc->chunk_total * i) / auc->worker_count);
+        uint32_t const end = (uint32_t)(((uint64_t)auc->chunk_total *
+                                         (i + 1U)) /
+                                        auc->worker_count);
+        atomic_init(&worker->range, range_pack(begin, end));
+        worker->auc = auc;
+        worker->id = i;
+    }
+
+    int32_t ret = 0;
+    uint32_t started = 0;
+    for (; started < auc->worker_count; ++started)
+    {
+        if (pthread_create(&auc->worker[started].thread, NULL, worker_main,
+                           &auc->worker[started]) != 0)
+        {
+            fprintf(stderr, "Failed to start worker %u.\n", started);
+            ret = -1;
+            break;
+        }
+    }
+    /**
+     * If some worker failed to start, the started ones will steal its chunks
+     * so the output is still complete.
+     */
+    if (started == 0)
+    {
+        free(auc->worker);
+        return -1;
+    }
+    uint64_t stolen = 0;
+    for (uint32_t i = 0; i < started; ++i)
+    {
+        pthread_join(auc->worker[i].thread, NULL);
+        stolen += auc->worker[i].stolen;
+    }
+    fprintf(stderr, "Chunks stolen between workers: %" PRIu64 ".\n", stolen);
+    free(auc->worker);
+    return started == auc->worker_count ? ret : 0;
+}
+
+int32_t main(int32_t const argc, char *const argv[argc])
+{
+    static struct option const options_long[] = {
+        {"help", no_argument, 0, 'h'},
+        {"keys", required_argument, 0, 'k'},
+        {"count", required_argument, 0, 'n'},
+        {"format", required_argument, 0, 'f'},
+        {"out", required_argument, 0, 'o'},
+        {"threads", required_argument, 0, 't'},
+        {"amf", required_argument, 0, 'a'},
+        {"seed", required_argument, 0, 's'},
+        {"snn", required_argument, 0, 'N'},
+        {0, 0, 0, 0},
+    };
+
+    auc_st auc = {
+        .vec_count = 1,
+        .amf = {0x80, 0x00},
+        .seed = (uint64_t)time(NULL),
+        .fmt = AUC_FMT_CSV,
+        .out = stdout,
+        .param =
+            {
+                .op_present = false,
+                .c1 = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+                .c2 = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01},
+                .c3 = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02},
+                .c4 = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04},
+                .c5 = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08},
+                .r1 = 64,
+                .r2 = 0,
+                .r3 = 32,
+                .r4 = 64,
+                .r5 = 96,
+            },
+    };
+    char const *path_keys = NULL;
+    char const *path_out = NULL;
+    long const cores = sysconf(_SC_NPROCESSORS_ONLN);
+    /* Safe cast since the core count is checked to be positive. */
+    auc.worker_count = cores > 0 ? (uint32_t)cores : 1U;
+
+    int32_t ch;
+    while (1)
+    {
+        int32_t opt_idx = 0;
+        ch = getopt_long(argc, argv, "hk:n:f:o:t:a:s:N:", options_long,
+                         &opt_idx);
+        if (ch == -1)
+        {
+            break;
+        }
+
+        switch (ch)
+        {
+        case 'h':
+            print_usage(argv[0U]);
+            return EXIT_SUCCESS;
+        case 'k':
+            path_keys = optarg;
+            break;
+        case 'n': {
+            char *end = NULL;
+            unsigned long const count = strtoul(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || count == 0 ||
+                count > UINT32_MAX)
+            {
+                fprintf(stderr, "Invalid vector count: '%s'.\n", optarg);
+                return EXIT_FAILURE;
+            }
+            /* Safe cast since the count was checked to fit. */
+            auc.vec_count = (uint32_t)count;
+            break;
+        }
+        case 'f':
+            if (strcmp(optarg, "csv") == 0)
+            {
+                auc.fmt = AUC_FMT_CSV;
+            }
+            else if (strcmp(optarg, "bin") == 0)
+            {
+                auc.fmt = AUC_FMT_BIN;
+            }
+            else
+            {
+                fprintf(stderr, "Invalid format: '%s'.\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'o':
+            path_out = optarg;
+            break;
+        case 't': {
+            char *end = NULL;
+            unsigned long const threads = strtoul(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || threads == 0 ||
+                threads > 4096)
+            {
+                fprintf(stderr, "Invalid thread count: '%s'.\n", optarg);
+                return EXIT_FAILURE;
+            }
+            /* Safe cast since the count was checked to fit. */
+            auc.worker_count = (uint32_t)threads;
+            break;
+        }
+        case 'a':
+            if (hex_decode(optarg, auc.amf, sizeof(auc.amf)) != 0)
+            {
+                fprintf(stderr, "Invalid AMF: '%s'.\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's': {
+            char *end = NULL;
+            auc.seed = strtoull(optarg, &end, 0);
+            if (end == optarg || *end != '\0')
+            {
+                fprintf(stderr, "Invalid seed: '%s'.\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+        case 'N': {
+            size_t const snn_len = strlen(optarg);
+            if (snn_len == 0 || snn_len > KDF_SNN_LEN_MAX)
+            {
+                fprintf(stderr, "Invalid serving network name: '%s'.\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            /* Safe cast since the length was checked to fit. */
+            auc.snn_len = (uint8_t)snn_len;
+            memcpy(auc.snn, optarg, snn_len);
+            break;
+        }
+        case '?':
+            print_usage(argv[0U]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (path_keys == NULL)
+    {
+        fprintf(stderr, "Key file path is mandatory.\n");
+        print_usage(argv[0U]);
+        return EXIT_FAILURE;
+    }
+
+    if (keys_load(&auc, path_keys) != 0)
+    {
+        free(auc.sub);
+        return EXIT_FAILURE;
+    }
+    auc.vec_total = auc.sub_count * auc.vec_count;
+    uint64_t const chunk_total = (auc.vec_total + AUC_CHUNK - 1U) / AUC_CHUNK;
+    if (auc.vec_total / auc.vec_count != auc.sub_count ||
+        chunk_total > UINT32_MAX)
+    {
+        fprintf(stderr, "Too many vectors requested.\n");
+        free(auc.sub);
+        return EXIT_FAILURE;
+    }
+    /* Safe cast since it was checked to fit. */
+    auc.chunk_total = (uint32_t)chunk_total;
+    milenage_param_std_check(&auc.param);
+
+    if (path_out != NULL)
+    {
+        auc.out = fopen(path_out, auc.fmt == AUC_FMT_CSV ? "w" : "wb");
+        if (auc.out == NULL)
+        {
+            fprintf(stderr, "Failed to open output file '%s'.\n", path_out);
+            free(auc.sub);
+            return EXIT_FAILURE;
+        }
+    }
+    pthread_mutex_init(&auc.out_mutex, NULL);
+
+    fprintf(stderr,
+            "Generating %" PRIu64 " vectors for %" PRIu64
+            " subscribers with %u workers (seed %" PRIu64 ").\n",
+            auc.vec_total, auc.sub_count, auc.worker_count, auc.seed);
+    struct timespec time_start;
+    struct timespec time_end;
+    clock_gettime(CLOCK_MONOTONIC, &time_start);
+    int32_t const ret = auc_run(&auc);
+    clock_gettime(CLOCK_MONOTONIC, &time_end);
+
+    double const duration =
+        (double)(time_end.tv_sec - time_start.tv_sec) +
+        ((double)(time_end.tv_nsec - time_start.tv_nsec) / 1e9);
+    fprintf(stderr, "Done in %.3fs (%.2f million vectors per minute).\n",
+            duration,
+            duration > 0 ? ((double)auc.vec_total * 60.0) / duration / 1e6
+                         : 0.0);
+
+    pthread_mutex_destroy(&auc.out_mutex);
+    if (path_out != NULL)
+    {
+        fclose(auc.out);
+    }
+    else
+    {
+        fflush(stdout);
+    }
+    free(auc.sub);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}